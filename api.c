@@ -0,0 +1,517 @@
+//***************************************************************************
+// p4d / Linux - Heizungs Manager
+// File api.c
+// This code is distributed under the terms and conditions of the
+// GNU GENERAL PUBLIC LICENSE. See the file LICENSE for details.
+// Date 19.10.2026  Jörg Wendel
+//***************************************************************************
+
+#include "p4d.h"
+#include "downsample.h"
+
+//***************************************************************************
+// On HTTP Request
+//   GET /api/values                      latest value of all active sensors
+//   GET /api/facts                       all value facts
+//   GET /api/errors                      last 100 errors of the heating
+//   GET /api/w1                          one wire sensors with their read statistics
+//   GET /api/series?type=VA&address=1    samples of one sensor,
+//       [&from=<epoch>][&to=<epoch>][&points=500]   reduced to 'points'
+//       [&mode=lttb|minmax|avg|none]                 (see cDownsample)
+//   GET /api/events                      Server-Sent Events, 'values' with the
+//                                        changed values after each cycle and
+//                                        'state' on each state change
+//   GET /metrics                         Prometheus metrics
+//***************************************************************************
+
+int P4d::onHttpRequest(cHttpServer::Request* request, std::string& body, std::string& contentType)
+{
+   contentType = "application/json";
+
+   if (request->path == "/api/values")
+      return apiValues(request, body);
+
+   if (request->path == "/api/w1")
+      return apiW1(request, body);
+
+   if (request->path == "/metrics")
+   {
+      contentType = "text/plain; version=0.0.4";
+      body = metrics();
+
+      return 200;
+   }
+
+   if (request->path == "/api/events")
+   {
+      std::vector<cValueCache::Value> values;
+      time_t time;
+
+      // start with the complete values and the current state
+
+      valueCache.snapshot(values, time);
+
+      contentType = "text/event-stream";
+      body = "retry: 5000\n\n"
+         "event: values\ndata: " + jsonOfValues(values, time) + "\n\n"
+         "event: state\ndata: " + jsonOfState() + "\n\n";
+
+      return 200;
+   }
+
+   // the others need the database
+
+   if (request->path == "/api/facts" || request->path == "/api/errors" || request->path == "/api/series")
+   {
+      if (!connection || !connection->isConnected())
+      {
+         body = "{\"error\": \"database not available\"}";
+         return 503;
+      }
+
+      if (request->path == "/api/facts")
+         return apiFacts(request, body);
+
+      if (request->path == "/api/errors")
+         return apiErrors(request, body);
+
+      return apiSeries(request, body);
+   }
+
+   body = "{\"error\": \"unknown resource\"}";
+
+   return 404;
+}
+
+//***************************************************************************
+// Json Of Row
+//   - all data fields of the current row, named like the database columns
+//***************************************************************************
+
+std::string P4d::jsonOfRow(cDbTable* table)
+{
+   std::string json = "{";
+
+   for (int i = 0; i < table->fieldCount(); i++)
+   {
+      cDbFieldDef* def = table->getField(i);
+      cDbValue* value = table->getValue(def);
+      char num[50];
+
+      if (def->getType() & cDBS::ftMeta)
+         continue;
+
+      json += std::string(json.length() > 1 ? ", " : "") + "\"" + def->getDbName() + "\": ";
+
+      if (value->isNull())
+      {
+         json += "null";
+         continue;
+      }
+
+      switch (def->getFormat())
+      {
+         case cDBS::ffInt:
+         case cDBS::ffUInt:     sprintf(num, "%ld", value->getIntValue());                  break;
+         case cDBS::ffBigInt:
+         case cDBS::ffUBigInt:  sprintf(num, "%lld", (long long)value->getBigintValue());   break;
+         case cDBS::ffFloat:    sprintf(num, "%g", value->getFloatValue());                 break;
+         case cDBS::ffDateTime: sprintf(num, "%ld", (long)value->getTimeValue());            break;
+
+         default:
+         {
+            json += cHttpServer::jsonEscape(value->getStrValue());
+            continue;
+         }
+      }
+
+      json += num;
+   }
+
+   return json + "}";
+}
+
+//***************************************************************************
+// Json Of Values / State
+//***************************************************************************
+
+std::string P4d::jsonOfValues(std::vector<cValueCache::Value>& values, time_t time)
+{
+   std::string body;
+   char* buf;
+
+   asprintf(&buf, "{\"time\": %ld, \"values\": [", (long)time);
+   body = buf;
+   free(buf);
+
+   for (uint i = 0; i < values.size(); i++)
+   {
+      cValueCache::Value* v = &values[i];
+
+      asprintf(&buf, "%s{\"type\": \"%s\", \"address\": %d, \"value\": %g, ",
+               i ? ", " : "", v->type, v->address, v->value);
+      body += buf;
+      free(buf);
+
+      body += "\"text\": " + cHttpServer::jsonEscape(v->text)
+         + ", \"unit\": " + cHttpServer::jsonEscape(v->unit)
+         + ", \"title\": " + cHttpServer::jsonEscape(*v->usrtitle ? v->usrtitle : v->title) + "}";
+   }
+
+   body += "]}";
+
+   return body;
+}
+
+std::string P4d::jsonOfState()
+{
+   std::string body;
+   char* buf;
+
+   asprintf(&buf, "{\"time\": %ld, \"state\": %d, \"mode\": %d, ",
+            (long)time(0), currentState.state, currentState.mode);
+   body = buf;
+   free(buf);
+
+   body += "\"stateinfo\": " + cHttpServer::jsonEscape(currentState.stateinfo)
+      + ", \"modeinfo\": " + cHttpServer::jsonEscape(currentState.modeinfo) + "}";
+
+   return body;
+}
+
+//***************************************************************************
+// API Values
+//***************************************************************************
+
+int P4d::apiValues(cHttpServer::Request* request, std::string& body)
+{
+   std::vector<cValueCache::Value> values;
+   time_t time;
+
+   valueCache.snapshot(values, time);
+   body = jsonOfValues(values, time);
+
+   return 200;
+}
+
+//***************************************************************************
+// API W1
+//***************************************************************************
+
+int P4d::apiW1(cHttpServer::Request* request, std::string& body)
+{
+   std::vector<W1::Sensor> sensors;
+   char* buf;
+
+   w1.getSensors(sensors);
+
+   body = "[";
+
+   for (uint i = 0; i < sensors.size(); i++)
+   {
+      W1::Sensor* s = &sensors[i];
+
+      asprintf(&buf, "%s{\"id\": %s, \"address\": %u, \"present\": %s, \"value\": %g, \"time\": %ld, "
+               "\"reads\": %u, \"failures\": %u, \"crcErrors\": %u}", i ? ", " : "",
+               cHttpServer::jsonEscape(s->id).c_str(), s->address, s->present ? "true" : "false",
+               s->value, (long)s->time, s->reads, s->failures, s->crcErrors);
+      body += buf;
+      free(buf);
+   }
+
+   body += "]";
+
+   return 200;
+}
+
+//***************************************************************************
+// API Facts
+//***************************************************************************
+
+int P4d::apiFacts(cHttpServer::Request* request, std::string& body)
+{
+   int count = 0;
+
+   body = "[";
+
+   tableValueFacts->clear();
+
+   for (int f = selectAllValueFacts->find(); f; f = selectAllValueFacts->fetch())
+      body += std::string(count++ ? ", " : "") + jsonOfRow(tableValueFacts);
+
+   selectAllValueFacts->freeResult();
+   body += "]";
+
+   return 200;
+}
+
+//***************************************************************************
+// API Errors
+//***************************************************************************
+
+int P4d::apiErrors(cHttpServer::Request* request, std::string& body)
+{
+   int count = 0;
+
+   body = "[";
+
+   tableErrors->clear();
+
+   for (int f = selectRecentErrors->find(); f; f = selectRecentErrors->fetch())
+      body += std::string(count++ ? ", " : "") + jsonOfRow(tableErrors);
+
+   selectRecentErrors->freeResult();
+   body += "]";
+
+   return 200;
+}
+
+//***************************************************************************
+// API Series
+//   - reduced to 'points' points, the width of the chart in pixel,
+//     'mode' is one of lttb (default), minmax, avg or none
+//***************************************************************************
+
+int P4d::apiSeries(cHttpServer::Request* request, std::string& body)
+{
+   const char* type = request->param("type", "VA");
+   int address = strtol(request->param("address", "-1"), 0, 0);
+   time_t to = atol(request->param("to", "0"));
+   time_t from = atol(request->param("from", "0"));
+   int points = atoi(request->param("points", "500"));
+   cDownsample::Mode mode = cDownsample::toMode(request->param("mode"), cDownsample::dmLttb);
+   std::vector<cDownsample::Point> samples;
+   std::vector<cDownsample::Point> reduced;
+   char* buf;
+
+   if (address < 0 || strlen(type) != 2)
+   {
+      body = "{\"error\": \"missing or invalid parameter 'type' or 'address'\"}";
+      return 400;
+   }
+
+   if (!to)    to = time(0);
+   if (!from)  from = to - tmeSecondsPerDay;
+
+   points = max(1, min(points, 5000));
+
+   if (to <= from)
+   {
+      body = "{\"error\": \"empty range\"}";
+      return 400;
+   }
+
+   tableSamples->clear();
+   tableSamples->setValue("ADDRESS", address);
+   tableSamples->setValue("TYPE", type);
+   tableSamples->setValue("TIME", from);
+   rangeEnd.setValue(to);
+
+   for (int f = selectSampleInRange->find(); f; f = selectSampleInRange->fetch())
+   {
+      cDownsample::Point p = { tableSamples->getTimeValue("TIME"), tableSamples->getFloatValue("VALUE") };
+      samples.push_back(p);
+   }
+
+   selectSampleInRange->freeResult();
+
+   cDownsample::reduce(mode, samples, reduced, points);
+
+   asprintf(&buf, "{\"type\": %s, \"address\": %d, \"from\": %ld, \"to\": %ld, \"mode\": \"%s\", \"samples\": %d, \"points\": [",
+            cHttpServer::jsonEscape(type).c_str(), address, (long)from, (long)to,
+            cDownsample::toName(mode), (int)samples.size());
+   body = buf;
+   free(buf);
+
+   for (uint i = 0; i < reduced.size(); i++)
+   {
+      asprintf(&buf, "%s[%ld, %g]", i ? ", " : "", (long)reduced[i].time, reduced[i].value);
+      body += buf;
+      free(buf);
+   }
+
+   body += "]}";
+
+   return 200;
+}
+
+//***************************************************************************
+// Metrics
+//   - Prometheus text exposition format, for /metrics and the textfile
+//     collector (metricsFile)
+//***************************************************************************
+
+static void addMetric(std::string& out, const char* name, const char* type, const char* help)
+{
+   char* buf;
+
+   asprintf(&buf, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+   out += buf;
+   free(buf);
+}
+
+static void addSample(std::string& out, const char* name, const char* labels, double value)
+{
+   char* buf;
+
+   asprintf(&buf, "%s%s%s%s %.15g\n", name, *labels ? "{" : "", labels, *labels ? "}" : "", value);
+   out += buf;
+   free(buf);
+}
+
+template <class T> static void addQueue(std::string& out, cSpscQueue<T>* queue)
+{
+   char labels[100+TB];
+
+   sprintf(labels, "queue=\"%s\"", queue->getName());
+
+   addSample(out, "p4d_queue_depth", labels, queue->size());
+   addSample(out, "p4d_queue_items_total", labels, queue->popped.get());
+   addSample(out, "p4d_queue_dropped_total", labels, queue->dropped.get());
+   addSample(out, "p4d_queue_latency_seconds_total", labels, queue->latencyUs.get() / 1000000.0);
+}
+
+std::string P4d::metrics()
+{
+   std::string out;
+   char labels[100+TB];
+
+   addMetric(out, "p4d_start_time_seconds", "gauge", "Start time of p4d since epoch");
+   addSample(out, "p4d_start_time_seconds", "", startedAt);
+
+   // boiler
+
+   addMetric(out, "p4d_state", "gauge", "State of the boiler");
+   addSample(out, "p4d_state", "", currentState.state);
+   addMetric(out, "p4d_mode", "gauge", "Mode of the boiler");
+   addSample(out, "p4d_mode", "", currentState.mode);
+   addMetric(out, "p4d_error", "gauge", "1 if the boiler reports an error state");
+   addSample(out, "p4d_error", "", isError(currentState.state) ? 1 : 0);
+
+   // cycle
+
+   addMetric(out, "p4d_cycle_seconds", "summary", "Wall time of the phases of the cycle");
+
+   for (int p = 0; p <= cpCount; p++)
+   {
+      const char* phase = p < cpCount ? cyclePhaseNames[p] : "total";
+      static const int quantiles[] = { 50, 90, 99 };
+
+      for (int q = 0; q < 3; q++)
+      {
+         sprintf(labels, "phase=\"%s\",quantile=\"0.%d\"", phase, quantiles[q]);
+         addSample(out, "p4d_cycle_seconds", labels, profiler.percentile(p, quantiles[q]) / 1000000.0);
+      }
+
+      sprintf(labels, "phase=\"%s\"", phase);
+      addSample(out, "p4d_cycle_seconds_sum", labels, profiler.getTotalWall(p) / 1000000.0);
+      addSample(out, "p4d_cycle_seconds_count", labels, profiler.getTotalCycles());
+   }
+
+   // serial line
+
+   addMetric(out, "p4d_serial_bytes_total", "counter", "Bytes on the serial line");
+   addSample(out, "p4d_serial_bytes_total", "direction=\"in\"", serial->getReceived());
+   addSample(out, "p4d_serial_bytes_total", "direction=\"out\"", serial->getSent());
+
+   addMetric(out, "p4d_serial_requests_total", "counter", "Requests per command");
+   addMetric(out, "p4d_serial_timeouts_total", "counter", "Timeouts reading the reply per command");
+   addMetric(out, "p4d_serial_crc_errors_total", "counter", "Replies with wrong CRC per command");
+
+   for (int c = 0; c < 256; c++)
+   {
+      P4Request::CommandStats* stats = request->getStats(c);
+
+      if (!stats->requests.get())
+         continue;
+
+      sprintf(labels, "command=\"0x%2.2x\"", c);
+      addSample(out, "p4d_serial_requests_total", labels, stats->requests.get());
+      addSample(out, "p4d_serial_timeouts_total", labels, stats->timeouts.get());
+      addSample(out, "p4d_serial_crc_errors_total", labels, stats->crcErrors.get());
+   }
+
+   // database
+
+   addMetric(out, "p4d_db_statements_total", "counter", "Executed SQL statements");
+   addSample(out, "p4d_db_statements_total", "", cDbStatement::executions.get());
+   addMetric(out, "p4d_db_statement_seconds_total", "counter", "Time spent executing SQL statements");
+   addSample(out, "p4d_db_statement_seconds_total", "", cDbStatement::executeUs.get() / 1000000.0);
+
+   // queues
+
+   addMetric(out, "p4d_log_queue_depth", "gauge", "Messages waiting for the log thread");
+   addSample(out, "p4d_log_queue_depth", "", asyncLog.getQueued());
+   addMetric(out, "p4d_log_dropped_total", "counter", "Log messages dropped as the queue was full");
+   addSample(out, "p4d_log_dropped_total", "", asyncLog.getDropped());
+   addMetric(out, "p4d_http_streams", "gauge", "Connected clients of /api/events");
+   addSample(out, "p4d_http_streams", "", httpServer->streamCount());
+   addMetric(out, "p4d_loop_wakeups_total", "counter", "Wakeups of the main loop while standing by");
+   addSample(out, "p4d_loop_wakeups_total", "", eventLoop.wakeups.get());
+
+   addMetric(out, "p4d_queue_depth", "gauge", "Items waiting in the queue of a pipeline thread");
+   addMetric(out, "p4d_queue_items_total", "counter", "Items passed through the queue");
+   addMetric(out, "p4d_queue_dropped_total", "counter", "Items dropped as the queue was full");
+   addMetric(out, "p4d_queue_latency_seconds_total", "counter", "Time the items waited in the queue");
+
+   addQueue(out, &persister.queue);
+   addQueue(out, &notifier.queue);
+
+   // alerts and HomeMatic
+
+   addMetric(out, "p4d_alert_checks_total", "counter", "Evaluated sensor alert rules");
+   addSample(out, "p4d_alert_checks_total", "", counters.alertChecks.get());
+   addMetric(out, "p4d_alerts_total", "counter", "Triggered sensor alerts");
+   addSample(out, "p4d_alerts_total", "", counters.alerts.get());
+
+   addMetric(out, "p4d_homematic_push_total", "counter", "Sysvar changes sent to the HomeMatic");
+   addSample(out, "p4d_homematic_push_total", "result=\"ok\"", notifier.urlsOk.get());
+   addSample(out, "p4d_homematic_push_total", "result=\"failed\"", notifier.urlsFailed.get());
+   addSample(out, "p4d_homematic_push_total", "result=\"skipped\"", counters.hmSkipped.get());
+
+   // scripts
+
+   addMetric(out, "p4d_hooks_total", "counter", "Calls of after-update.sh and the WEBIF scripts");
+   addSample(out, "p4d_hooks_total", "result=\"ok\"", hooks.succeeded.get());
+   addSample(out, "p4d_hooks_total", "result=\"failed\"", hooks.failed.get());
+   addSample(out, "p4d_hooks_total", "result=\"timeout\"", hooks.timedOut.get());
+   addSample(out, "p4d_hooks_total", "result=\"coalesced\"", hooks.coalesced.get());
+   addSample(out, "p4d_hooks_total", "result=\"dropped\"", hooks.dropped.get());
+   addMetric(out, "p4d_hooks_pending", "gauge", "Calls waiting for a free hook thread");
+   addSample(out, "p4d_hooks_pending", "", hooks.pending());
+
+   return out;
+}
+
+//***************************************************************************
+// Write Metrics
+//   - write and rename, the collector never sees a partial file
+//***************************************************************************
+
+int P4d::writeMetrics(const char* file)
+{
+   std::string out = metrics();
+   char* tmp;
+   FILE* fp;
+
+   asprintf(&tmp, "%s.tmp", file);
+
+   if (!(fp = fopen(tmp, "w")))
+   {
+      tell(eloAlways, "Error: Can't open file '%s' for writing, %s", tmp, strerror(errno));
+      free(tmp);
+      return fail;
+   }
+
+   if (fwrite(out.c_str(), 1, out.length(), fp) != out.length() || fclose(fp) != 0 || rename(tmp, file) != 0)
+   {
+      tell(eloAlways, "Error: Writing '%s' failed, %s", file, strerror(errno));
+      unlink(tmp);
+      free(tmp);
+      return fail;
+   }
+
+   free(tmp);
+
+   return success;
+}
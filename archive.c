@@ -0,0 +1,552 @@
+//***************************************************************************
+// p4d / Linux - Heizungs Manager
+// File archive.c
+// This code is distributed under the terms and conditions of the
+// GNU GENERAL PUBLIC LICENSE. See the file LICENSE for details.
+// Date 18.10.2026  Jörg Wendel
+//***************************************************************************
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <map>
+
+#include "archive.h"
+
+//***************************************************************************
+// Bit Stream
+//***************************************************************************
+
+void cBitStream::write(uint64_t bits, int count)
+{
+   for (int i = count-1; i >= 0; i--)
+   {
+      if (!(bitPos % 8))
+         buffer.push_back(0);
+
+      if ((bits >> i) & 1)
+         buffer[bitPos / 8] |= 0x80 >> (bitPos % 8);
+
+      bitPos++;
+   }
+}
+
+uint64_t cBitStream::read(int count)
+{
+   uint64_t bits = 0;
+
+   for (int i = 0; i < count && !eof(); i++)
+   {
+      bits = (bits << 1) | ((buffer[bitPos / 8] >> (7 - bitPos % 8)) & 1);
+      bitPos++;
+   }
+
+   return bits;
+}
+
+//***************************************************************************
+// Class Archive
+//***************************************************************************
+
+cArchive::cArchive(const char* aPath)
+{
+   path = strdup(aPath);
+}
+
+cArchive::~cArchive()
+{
+   free(path);
+}
+
+//***************************************************************************
+// Encode
+//   time:  first 64 bit raw, then delta-of-delta in 1, 9, 12, 16 or 36 bits
+//   value: first 64 bit raw, then XOR to previous, '0' if unchanged,
+//          '10' + meaningful bits if they fit in the previous window,
+//          '11' + 5 bit leading zeros + 6 bit length + meaningful bits
+//***************************************************************************
+
+int cArchive::encode(const Point* points, int count, cBitStream* stream)
+{
+   int64_t prevTime, prevDelta = 0;
+   uint64_t prevBits;
+   int prevLeading = na, prevTrailing = 0;
+
+   if (count <= 0)
+      return done;
+
+   memcpy(&prevBits, &points[0].value, sizeof(prevBits));
+   prevTime = points[0].time;
+
+   stream->write(prevTime, 64);
+   stream->write(prevBits, 64);
+
+   for (int i = 1; i < count; i++)
+   {
+      int64_t delta = points[i].time - prevTime;
+      int64_t dod = delta - prevDelta;
+      uint64_t bits;
+
+      if (dod == 0)
+         stream->write(0, 1);
+      else if (dod >= -63 && dod <= 64)
+      {
+         stream->write(0x02, 2);
+         stream->write(dod + 63, 7);
+      }
+      else if (dod >= -255 && dod <= 256)
+      {
+         stream->write(0x06, 3);
+         stream->write(dod + 255, 9);
+      }
+      else if (dod >= -2047 && dod <= 2048)
+      {
+         stream->write(0x0e, 4);
+         stream->write(dod + 2047, 12);
+      }
+      else
+      {
+         stream->write(0x0f, 4);
+         stream->write((uint32_t)dod, 32);
+      }
+
+      prevDelta = delta;
+      prevTime = points[i].time;
+
+      // value
+
+      memcpy(&bits, &points[i].value, sizeof(bits));
+      uint64_t x = bits ^ prevBits;
+      prevBits = bits;
+
+      if (!x)
+      {
+         stream->write(0, 1);
+         continue;
+      }
+
+      int leading = min(__builtin_clzll(x), 31);
+      int trailing = __builtin_ctzll(x);
+
+      stream->write(1, 1);
+
+      if (prevLeading != na && leading >= prevLeading && trailing >= prevTrailing)
+      {
+         stream->write(0, 1);
+         stream->write(x >> prevTrailing, 64 - prevLeading - prevTrailing);
+      }
+      else
+      {
+         int significant = 64 - leading - trailing;
+
+         stream->write(1, 1);
+         stream->write(leading, 5);
+         stream->write(significant - 1, 6);
+         stream->write(x >> trailing, significant);
+
+         prevLeading = leading;
+         prevTrailing = trailing;
+      }
+   }
+
+   return success;
+}
+
+//***************************************************************************
+// Decode
+//***************************************************************************
+
+int cArchive::decode(cBitStream* stream, int count, std::vector<Point>& points)
+{
+   int64_t prevTime, prevDelta = 0;
+   uint64_t prevBits;
+   int prevLeading = 0, prevTrailing = 0;
+   Point p;
+
+   if (count <= 0)
+      return done;
+
+   prevTime = stream->read(64);
+   prevBits = stream->read(64);
+
+   p.time = prevTime;
+   memcpy(&p.value, &prevBits, sizeof(prevBits));
+   points.push_back(p);
+
+   for (int i = 1; i < count; i++)
+   {
+      int64_t dod;
+
+      if (stream->eof())
+      {
+         tell(0, "Error: Archive block truncated after %d of %d points", i, count);
+         return fail;
+      }
+
+      if (!stream->read(1))
+         dod = 0;
+      else if (!stream->read(1))
+         dod = (int64_t)stream->read(7) - 63;
+      else if (!stream->read(1))
+         dod = (int64_t)stream->read(9) - 255;
+      else if (!stream->read(1))
+         dod = (int64_t)stream->read(12) - 2047;
+      else
+         dod = (int32_t)stream->read(32);
+
+      prevDelta += dod;
+      prevTime += prevDelta;
+
+      // value
+
+      if (stream->read(1))
+      {
+         if (stream->read(1))
+         {
+            prevLeading = stream->read(5);
+            int significant = stream->read(6) + 1;
+            prevTrailing = 64 - prevLeading - significant;
+         }
+
+         prevBits ^= stream->read(64 - prevLeading - prevTrailing) << prevTrailing;
+      }
+
+      p.time = prevTime;
+      memcpy(&p.value, &prevBits, sizeof(prevBits));
+      points.push_back(p);
+   }
+
+   return success;
+}
+
+//***************************************************************************
+// File Of
+//***************************************************************************
+
+char* cArchive::fileOf(const char* type, int address, const char* aggregate, int year, int month)
+{
+   char* file;
+
+   // the samples keep the directory of the archives written before the aggregate was part of the key
+
+   if (strcmp(aggregate, "S") == 0)
+      asprintf(&file, "%s/%s-%d/%04d%02d.p4a", path, type, address, year, month);
+   else
+      asprintf(&file, "%s/%s-%d-%s/%04d%02d.p4a", path, type, address, aggregate, year, month);
+
+   return file;
+}
+
+//***************************************************************************
+// Store
+//***************************************************************************
+
+int cArchive::store(const char* type, int address, std::vector<Point>& points, const char* aggregate)
+{
+   std::map<int, std::vector<Point> > months;
+   std::map<int, std::vector<Point> >::iterator it;
+   int status = success;
+
+   // split by month
+
+   for (uint i = 0; i < points.size(); i++)
+   {
+      struct tm tm;
+
+      localtime_r(&points[i].time, &tm);
+      months[(tm.tm_year+1900) * 100 + tm.tm_mon+1].push_back(points[i]);
+   }
+
+   for (it = months.begin(); it != months.end(); ++it)
+   {
+      char* file = fileOf(type, address, aggregate, it->first / 100, it->first % 100);
+      std::map<time_t, double> merged;
+      std::vector<Point> all;
+
+      // merge with the already archived points, new ones win
+
+      if (fileExists(file))
+      {
+         if (readFile(file, 0, 0, all) != success)
+         {
+            tell(0, "Error: Can't merge with corrupt archive '%s', skipping", file);
+            free(file);
+            status = fail;
+            continue;
+         }
+      }
+
+      for (uint i = 0; i < all.size(); i++)
+         merged[all[i].time] = all[i].value;
+
+      for (uint i = 0; i < it->second.size(); i++)
+         merged[it->second[i].time] = it->second[i].value;
+
+      all.clear();
+
+      for (std::map<time_t, double>::iterator m = merged.begin(); m != merged.end(); ++m)
+      {
+         Point p = { m->first, m->second };
+         all.push_back(p);
+      }
+
+      status += writeFile(file, type, address, all);
+      free(file);
+   }
+
+   return status;
+}
+
+//***************************************************************************
+// Write File
+//   - written to a temporary file and renamed, a reader never sees a
+//     partially written archive
+//***************************************************************************
+
+int cArchive::writeFile(const char* file, const char* type, int address, std::vector<Point>& points)
+{
+   Header header;
+   std::vector<BlockIndex> index;
+   std::vector<cBitStream*> blocks;
+   char* tmp;
+   char* dir;
+   FILE* fp;
+   dword offset;
+
+   if (!points.size())
+      return done;
+
+   // create the directories level by level, like 'mkdir -p'
+
+   dir = strdup(file);
+   *strrchr(dir, '/') = 0;
+
+   for (char* p = strchr(dir + 1, '/'); ; p = strchr(p + 1, '/'))
+   {
+      if (p)
+         *p = 0;
+
+      if (mkdir(dir, 0755) != 0 && errno != EEXIST)
+      {
+         tell(0, "Error: Can't create archive directory '%s', %s", dir, strerror(errno));
+         free(dir);
+         return fail;
+      }
+
+      if (!p)
+         break;
+
+      *p = '/';
+   }
+
+   free(dir);
+
+   // header
+
+   memset(&header, 0, sizeof(header));
+   memcpy(header.magic, "P4A", 4);
+   header.version = version;
+   sstrcpy(header.type, type, sizeof(header.type));
+   header.address = address;
+   header.count = points.size();
+   header.first = points.front().time;
+   header.last = points.back().time;
+   header.min = header.max = points[0].value;
+
+   for (uint i = 0; i < points.size(); i++)
+   {
+      if (points[i].value < header.min) header.min = points[i].value;
+      if (points[i].value > header.max) header.max = points[i].value;
+   }
+
+   // encode blocks
+
+   header.blockCount = (points.size() + maxBlockPoints - 1) / maxBlockPoints;
+   offset = sizeof(Header) + header.blockCount * sizeof(BlockIndex);
+
+   for (uint i = 0; i < points.size(); i += maxBlockPoints)
+   {
+      BlockIndex idx;
+      cBitStream* stream = new cBitStream();
+      int count = min(maxBlockPoints, points.size() - i);
+
+      encode(&points[i], count, stream);
+
+      idx.first = points[i].time;
+      idx.last = points[i+count-1].time;
+      idx.count = count;
+      idx.offset = offset;
+      idx.size = stream->size();
+      offset += idx.size;
+
+      index.push_back(idx);
+      blocks.push_back(stream);
+   }
+
+   // write
+
+   asprintf(&tmp, "%s.tmp", file);
+
+   if (!(fp = fopen(tmp, "w")))
+   {
+      tell(0, "Error: Can't open '%s' for writing, %s", tmp, strerror(errno));
+      free(tmp);
+
+      for (uint i = 0; i < blocks.size(); i++)
+         delete blocks[i];
+
+      return fail;
+   }
+
+   int ok = fwrite(&header, sizeof(Header), 1, fp) == 1;
+   ok = ok && fwrite(&index[0], sizeof(BlockIndex), index.size(), fp) == index.size();
+
+   for (uint i = 0; i < blocks.size(); i++)
+   {
+      ok = ok && fwrite(blocks[i]->data(), 1, blocks[i]->size(), fp) == (size_t)blocks[i]->size();
+      delete blocks[i];
+   }
+
+   ok = fclose(fp) == 0 && ok;
+
+   if (!ok || rename(tmp, file) != 0)
+   {
+      tell(0, "Error: Writing archive '%s' failed, %s", file, strerror(errno));
+      unlink(tmp);
+      free(tmp);
+      return fail;
+   }
+
+   free(tmp);
+
+   tell(eloDetail, "Archived %d points to '%s' (%d bytes, %.1f bytes per point)",
+        header.count, file, offset, (double)offset / header.count);
+
+   return success;
+}
+
+//***************************************************************************
+// Read
+//***************************************************************************
+
+int cArchive::read(const char* type, int address, time_t from, time_t to, std::vector<Point>& points, const char* aggregate)
+{
+   struct tm tm;
+   int month, last;
+
+   localtime_r(&from, &tm);
+   month = (tm.tm_year+1900) * 12 + tm.tm_mon;
+
+   localtime_r(&to, &tm);
+   last = (tm.tm_year+1900) * 12 + tm.tm_mon;
+
+   for (; month <= last; month++)
+   {
+      char* file = fileOf(type, address, aggregate, month / 12, month % 12 + 1);
+
+      if (fileExists(file))
+         readFile(file, from, to, points);
+
+      free(file);
+   }
+
+   return success;
+}
+
+//***************************************************************************
+// Info
+//***************************************************************************
+
+int cArchive::info(const char* type, int address, time_t month, Header* header, const char* aggregate)
+{
+   struct tm tm;
+   FILE* fp;
+   int status = fail;
+
+   localtime_r(&month, &tm);
+   char* file = fileOf(type, address, aggregate, tm.tm_year+1900, tm.tm_mon+1);
+
+   if ((fp = fopen(file, "r")))
+   {
+      if (fread(header, sizeof(Header), 1, fp) == 1 && strcmp(header->magic, "P4A") == 0)
+         status = success;
+
+      fclose(fp);
+   }
+
+   free(file);
+
+   return status;
+}
+
+//***************************************************************************
+// Read File
+//   - only blocks overlapping [from, to] are decoded, to 0 means all
+//***************************************************************************
+
+int cArchive::readFile(const char* file, time_t from, time_t to, std::vector<Point>& points)
+{
+   Header header;
+   std::vector<BlockIndex> index;
+   FILE* fp;
+
+   if (!(fp = fopen(file, "r")))
+   {
+      tell(0, "Error: Can't open archive '%s', %s", file, strerror(errno));
+      return fail;
+   }
+
+   if (fread(&header, sizeof(Header), 1, fp) != 1 || strcmp(header.magic, "P4A") != 0 ||
+       header.version != version)
+   {
+      tell(0, "Error: '%s' is not a valid archive file", file);
+      fclose(fp);
+      return fail;
+   }
+
+   index.resize(header.blockCount);
+
+   if (header.blockCount && fread(&index[0], sizeof(BlockIndex), header.blockCount, fp) != header.blockCount)
+   {
+      tell(0, "Error: Can't read index of archive '%s'", file);
+      fclose(fp);
+      return fail;
+   }
+
+   for (uint b = 0; b < index.size(); b++)
+   {
+      std::vector<Point> block;
+
+      if (to && (index[b].first > to || index[b].last < from))
+         continue;
+
+      byte* data = (byte*)malloc(index[b].size);
+
+      if (fseek(fp, index[b].offset, SEEK_SET) != 0 || fread(data, 1, index[b].size, fp) != index[b].size)
+      {
+         tell(0, "Error: Can't read block %d of archive '%s'", b, file);
+         free(data);
+         fclose(fp);
+         return fail;
+      }
+
+      cBitStream stream(data, index[b].size);
+      free(data);
+
+      if (decode(&stream, index[b].count, block) != success)
+      {
+         fclose(fp);
+         return fail;
+      }
+
+      for (uint i = 0; i < block.size(); i++)
+      {
+         if (!to || (block[i].time >= from && block[i].time <= to))
+            points.push_back(block[i]);
+      }
+   }
+
+   fclose(fp);
+
+   return success;
+}
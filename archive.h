@@ -0,0 +1,125 @@
+//***************************************************************************
+// p4d / Linux - Heizungs Manager
+// File archive.h
+// This code is distributed under the terms and conditions of the
+// GNU GENERAL PUBLIC LICENSE. See the file LICENSE for details.
+// Date 18.10.2026  Jörg Wendel
+//***************************************************************************
+
+#ifndef _ARCHIVE_H_
+#define _ARCHIVE_H_
+
+#include <stdio.h>
+#include <time.h>
+
+#include <vector>
+
+#include "lib/common.h"
+
+#define archiveDirDefault "/var/lib/p4d/archive"
+
+//***************************************************************************
+// Bit Stream
+//***************************************************************************
+
+class cBitStream
+{
+   public:
+
+      cBitStream()                        { bitPos = 0; }
+      cBitStream(const byte* data, int size) : buffer(data, data+size) { bitPos = 0; }
+
+      void write(uint64_t bits, int count);
+      uint64_t read(int count);
+      int eof()                           { return bitPos >= buffer.size() * 8; }
+
+      const byte* data()                  { return buffer.size() ? &buffer[0] : 0; }
+      int size()                          { return buffer.size(); }
+
+   private:
+
+      std::vector<byte> buffer;
+      size_t bitPos;                      // write position while writing, read position while reading
+};
+
+//***************************************************************************
+// Class Archive
+//   - samples of one sensor, aggregate and month per file, compressed in blocks of
+//     up to 'maxBlockPoints' points, delta-of-delta encoded times and
+//     XOR encoded values (like Facebook's Gorilla TSDB)
+//***************************************************************************
+
+class cArchive
+{
+   public:
+
+      enum Misc
+      {
+         maxBlockPoints = 1024,
+         version = 1
+      };
+
+      struct Point
+      {
+         time_t time;
+         double value;
+      };
+
+      static bool before(const Point& a, const Point& b) { return a.time < b.time; }
+
+#pragma pack(1)
+      struct Header
+      {
+         char magic[4];                   // "P4A\0"
+         word version;
+         char type[2+TB];
+         dword address;
+         dword count;                     // points in file
+         dword blockCount;
+         int64_t first;
+         int64_t last;
+         double min;
+         double max;
+      };
+
+      struct BlockIndex
+      {
+         int64_t first;
+         int64_t last;
+         dword count;
+         dword offset;                    // from start of file
+         dword size;                      // bytes
+      };
+#pragma pack()
+
+      cArchive(const char* aPath = archiveDirDefault);
+      ~cArchive();
+
+      const char* getPath()               { return path; }
+
+      // write, merges with already archived points of the month,
+      //   the samples ('S') and the aggregation rows ('A') are kept apart
+
+      int store(const char* type, int address, std::vector<Point>& points, const char* aggregate = "S");
+
+      // read all points of the sensor in range [from, to]
+
+      int read(const char* type, int address, time_t from, time_t to, std::vector<Point>& points, const char* aggregate = "S");
+      int info(const char* type, int address, time_t month, Header* header, const char* aggregate = "S");
+
+      // codec
+
+      static int encode(const Point* points, int count, cBitStream* stream);
+      static int decode(cBitStream* stream, int count, std::vector<Point>& points);
+
+   protected:
+
+      char* fileOf(const char* type, int address, const char* aggregate, int year, int month);
+      int readFile(const char* file, time_t from, time_t to, std::vector<Point>& points);
+      int writeFile(const char* file, const char* type, int address, std::vector<Point>& points);
+
+      char* path;
+};
+
+//***************************************************************************
+#endif // _ARCHIVE_H_
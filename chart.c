@@ -6,23 +6,40 @@
  */
 
 #include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
 #include <mgl2/mgl.h>
 
-#include "lib/tabledef.h"
+#include <map>
+#include <algorithm>
+
+#include "lib/db.h"
 #include "lib/common.h"
+#include "lib/httpd.h"
+
+#include "archive.h"
+#include "downsample.h"
 
 //***************************************************************************
 // Globals
 //***************************************************************************
 
 cDbConnection* connection;
-cTableSamples* sDb;
-cTableValueFacts* sfDb;
+cDbTable* sDb;
+cDbTable* sfDb;
+cDbStatement* selSamples = 0;
+cDbStatement* selSensor = 0;
+const char* confDir = "/etc/p4d";
+const char* archiveDir = 0;
+const char* cacheDir = 0;
 const char* dbhost = "localhost";
 const char* dbname = "";
 const char* dbuser = "";
 const char* dbpass = "";
 int dbport = 3306;
+cDownsample::Mode downsampleMode = cDownsample::dmLttb;
 
 //***************************************************************************
 // init / exit
@@ -34,6 +51,19 @@ int initDb()
 
    if (!initialized)
    {
+      char* dictPath = 0;
+
+      asprintf(&dictPath, "%s/p4d.dat", confDir);
+
+      if (dbDict.in(dictPath) != success)
+      {
+         tell(0, "Fatal: Dictionary '%s' not loaded, aborting!", dictPath);
+         free(dictPath);
+         return fail;
+      }
+
+      free(dictPath);
+
       cDbConnection::init();
       cDbConnection::setEncoding("utf8");
       cDbConnection::setHost(dbhost);
@@ -47,7 +77,7 @@ int initDb()
 
    connection = new cDbConnection();
 
-   sDb = new cTableSamples(connection);
+   sDb = new cDbTable(connection, "samples");
    
    if (sDb->open() != success)
    {
@@ -57,7 +87,7 @@ int initDb()
       return fail;
    }
 
-   sfDb = new cTableValueFacts(connection);
+   sfDb = new cDbTable(connection, "valuefacts");
    
    if (sfDb->open() != success)
    {
@@ -67,6 +97,57 @@ int initDb()
       return fail;
    }
 
+   // select s.time, s.value, f.unit, f.title 
+   //   from samples s, valuefacts f 
+   //     where s.address = f.address
+   //     and s.type = f.type 
+   //     and s.time > ?
+   //     and f.name = ?
+   //   order by time;
+
+   selSamples = new cDbStatement(sDb);
+
+   // the range may cover weeks of samples, stream them instead of
+   //   holding the whole result in memory
+
+   selSamples->setStreaming();
+   selSamples->build("select ");
+   selSamples->setBindPrefix("s.");
+   selSamples->bind("TIME", cDBS::bndOut);
+   selSamples->bind("VALUE", cDBS::bndOut, ", ");
+   selSamples->setBindPrefix("f.");
+   selSamples->bind(sfDb->getValue("UNIT"), cDBS::bndOut, ", ");
+   selSamples->bind(sfDb->getValue("TITLE"), cDBS::bndOut, ", ");
+   selSamples->build(" from %s s, %s f where ", sDb->TableName(), sfDb->TableName());
+   selSamples->build("s.address = f.address ");
+   selSamples->build("and s.type = f.type");
+   selSamples->setBindPrefix("s.");
+   selSamples->bindCmp(0, "TIME", 0, ">", " and ");
+   selSamples->setBindPrefix("f.");
+   selSamples->bind(sfDb->getValue("NAME"), cDBS::bndIn | cDBS::bndSet, " and ");
+   selSamples->build(" order by %s;", sDb->getField("TIME")->getDbName());
+
+   if (selSamples->prepare() != success)
+      return fail;
+
+   // select address, type, unit, title from valuefacts where name = ?
+
+   if (archiveDir)
+   {
+      selSensor = new cDbStatement(sfDb);
+
+      selSensor->build("select ");
+      selSensor->bind("ADDRESS", cDBS::bndOut);
+      selSensor->bind("TYPE", cDBS::bndOut, ", ");
+      selSensor->bind("UNIT", cDBS::bndOut, ", ");
+      selSensor->bind("TITLE", cDBS::bndOut, ", ");
+      selSensor->build(" from %s where ", sfDb->TableName());
+      selSensor->bind("NAME", cDBS::bndIn | cDBS::bndSet);
+
+      if (selSensor->prepare() != success)
+         return fail;
+   }
+
    tell(0, "Connection to database established");  
 
    return success;
@@ -74,9 +155,12 @@ int initDb()
 
 int exitDb()
 {
-   sDb->close();
-   sfDb->close();
-   
+   delete selSamples; selSamples = 0;
+   delete selSensor;  selSensor = 0;
+
+   if (sDb)  sDb->close();
+   if (sfDb) sfDb->close();
+
    delete sDb;        sDb = 0;
    delete sfDb;       sfDb = 0;
    delete connection; connection = 0;
@@ -90,17 +174,26 @@ int exitDb()
 
 void showUsage(const char* name)
 {
-   printf("Usage: %s {chart|actual} [options]\n"
+   printf("Usage: %s {chart|batch|actual} [options]\n"
           "  chart        - create sensor chart\n"
-          "  actual       - dump actual data to ascii file (format as needed by VDRs gtft plugin)\n"
+          "  batch        - create the charts listed in file <file>, one per line: <file> <sensors> [<interval>]\n"
+          "  actual       - dump actual data to file (text as needed by VDRs gtft plugin, json or csv)\n"
           "    -f <file>      - output file\n"
+          "    -c <config-dir> - directory of the dictionary p4d.dat (default /etc/p4d)\n"
           "    -h <host>      - database host\n"
           "    -P <port>      - database port\n"
           "    -d <name>      - database name\n"
           "    -u <user>      - database user\n"
           "    -p <pass>      - database password\n"
           "    -l <logvel>    - log level {0-4}\n"
-          "    -i <interval>  - inverval für charts [h] (default 10)\n",
+          "    -i <interval>  - inverval für charts [h] (default 10)\n"
+          "    -r <rows>      - rows fetched per round trip while reading samples (default 100)\n"
+          "    -A <directory> - include samples already moved to the archive\n"
+          "    -m <mode>      - reduce the samples to the chart width {lttb,minmax,avg,none} (default lttb)\n"
+          "    -C <directory> - cache the charts and their samples, unchanged charts are not rendered again\n"
+          "    -j <threads>   - threads rendering the charts of a batch (default number of cores)\n"
+          "    -o <format>    - format of actual {text,json,csv} (default text)\n"
+          "    -w <seconds>   - keep running, check for new samples every <seconds> and rewrite the actual file\n",
           name);
 }
 
@@ -118,6 +211,253 @@ struct Sensor
    mglData ydat;
 };
 
+struct Series
+{
+   string title;
+   string unit;
+   std::vector<cDownsample::Point> samples;
+};
+
+struct Chart
+{
+   Chart() { interval = 10; width = 1360; height = 768; multiAxis = no; st = et = 0;
+             _min = 999999; _max = -999999; newest = 0; cached = no; sameAs = na; samples = 0; loadMs = renderMs = 0; }
+
+   string file;
+   string sensorList;
+   int interval;
+   int width;
+   int height;
+
+   std::vector<Sensor> sensors;
+   string lastUnit;
+   int multiAxis;
+   long st, et;
+   int _min, _max;
+   string cacheKey;
+   time_t newest;                   // newest sample at the time of loading
+   int cached;                      // the cached chart was taken, nothing to render
+   int sameAs;                      // batch: index of the chart of the same key, copied from it
+   int samples;
+   uint64_t loadMs;
+   uint64_t renderMs;
+};
+
+//***************************************************************************
+// Max Sample Time
+//***************************************************************************
+
+time_t maxSampleTime()
+{
+   time_t last = 0;
+
+   // select max(time) from samples;
+
+   cDbStatement* selMaxTime = new cDbStatement(sDb);
+
+   selMaxTime->build("select max(");
+   selMaxTime->bind("TIME", cDBS::bndOut);
+   selMaxTime->build(") from %s;", sDb->TableName());
+   selMaxTime->prepare();
+
+   sDb->clear();
+
+   if (selMaxTime->find() && !sDb->getValue("TIME")->isNull())
+      last = sDb->getTimeValue("TIME");
+
+   selMaxTime->freeResult();
+   delete selMaxTime;
+
+   return last;
+}
+
+//***************************************************************************
+// Render Cache
+//   - files below 'cacheDir' named by the md5 of their key
+//       chart-<md5>.jpg    last chart of a sensor list, range and size
+//       chart-<md5>.last   time of the newest sample at its rendering
+//       series-<md5>.dat   samples of a sensor and range, on the next
+//                          call only the newer samples are selected
+//***************************************************************************
+
+struct SeriesHeader
+{
+   char magic[4];                      // "P4CS"
+   int32_t count;
+   char title[200];
+   char unit[50];
+};
+
+char* cacheFile(const char* prefix, const char* key, const char* suffix)
+{
+   md5Buf hash;
+   char* path;
+
+   createMd5(key, hash);
+   asprintf(&path, "%s/%s-%s%s", cacheDir, prefix, hash, suffix);
+
+   return path;
+}
+
+int copyFile(const char* from, const char* to)
+{
+   char buf[64*1024];
+   char* tmp;
+   FILE* in;
+   FILE* out;
+   int status = success;
+   size_t n;
+
+   if (!(in = fopen(from, "r")))
+      return fail;
+
+   // by thread id, another p4chart may copy to the same file at the same time
+
+   asprintf(&tmp, "%s.%ld.tmp", to, syscall(__NR_gettid));
+
+   if (!(out = fopen(tmp, "w")))
+   {
+      tell(0, "Error: Can't open file '%s' for writing, %s", tmp, strerror(errno));
+      fclose(in);
+      free(tmp);
+      return fail;
+   }
+
+   while ((n = fread(buf, 1, sizeof(buf), in)) > 0)
+   {
+      if (fwrite(buf, 1, n, out) != n)
+      {
+         status = fail;
+         break;
+      }
+   }
+
+   fclose(in);
+
+   if (fclose(out) != 0 || status != success || rename(tmp, to) != 0)
+   {
+      tell(0, "Error: Writing file '%s' failed, %s", to, strerror(errno));
+      unlink(tmp);
+      status = fail;
+   }
+
+   free(tmp);
+
+   return status;
+}
+
+int cachedChart(const char* key, time_t newest, const char* file)
+{
+   char* lastFile = cacheFile("chart", key, ".last");
+   char* chartFile = cacheFile("chart", key, ".jpg");
+   int status = fail;
+   long last = 0;
+   FILE* fp;
+
+   if ((fp = fopen(lastFile, "r")))
+   {
+      if (fscanf(fp, "%ld", &last) == 1 && last == newest && fileExists(chartFile))
+         status = copyFile(chartFile, file);
+
+      fclose(fp);
+   }
+
+   free(lastFile);
+   free(chartFile);
+
+   return status;
+}
+
+int storeChart(const char* key, time_t newest, const char* file)
+{
+   char* lastFile = cacheFile("chart", key, ".last");
+   char* chartFile = cacheFile("chart", key, ".jpg");
+   FILE* fp;
+
+   // the time last, a crash in between leaves a chart which isn't taken
+
+   unlink(lastFile);
+
+   if (copyFile(file, chartFile) == success && (fp = fopen(lastFile, "w")))
+   {
+      fprintf(fp, "%ld\n", (long)newest);
+      fclose(fp);
+   }
+
+   free(lastFile);
+   free(chartFile);
+
+   return done;
+}
+
+int readSeriesFile(const char* path, Series* series, time_t since)
+{
+   SeriesHeader header;
+   cDownsample::Point p;
+   FILE* fp;
+
+   if (!(fp = fopen(path, "r")))
+      return fail;
+
+   if (fread(&header, sizeof(header), 1, fp) != 1 || memcmp(header.magic, "P4CS", 4) != 0)
+   {
+      fclose(fp);
+      return fail;
+   }
+
+   series->title = header.title;
+   series->unit = header.unit;
+
+   for (int i = 0; i < header.count && fread(&p, sizeof(p), 1, fp) == 1; i++)
+   {
+      if (p.time > since)
+         series->samples.push_back(p);
+   }
+
+   fclose(fp);
+
+   return success;
+}
+
+int writeSeriesFile(const char* path, Series* series)
+{
+   std::vector<cDownsample::Point>& samples = series->samples;
+   SeriesHeader header;
+   char* tmp;
+   FILE* fp;
+   int status = success;
+
+   memset(&header, 0, sizeof(header));
+   memcpy(header.magic, "P4CS", 4);
+   header.count = samples.size();
+   sstrcpy(header.title, series->title.c_str(), sizeof(header.title));
+   sstrcpy(header.unit, series->unit.c_str(), sizeof(header.unit));
+
+   asprintf(&tmp, "%s.tmp", path);
+
+   if (!(fp = fopen(tmp, "w")))
+   {
+      tell(0, "Error: Can't open file '%s' for writing, %s", tmp, strerror(errno));
+      free(tmp);
+      return fail;
+   }
+
+   if (fwrite(&header, sizeof(header), 1, fp) != 1
+       || (samples.size() && fwrite(&samples[0], sizeof(cDownsample::Point), samples.size(), fp) != samples.size()))
+      status = fail;
+
+   if (fclose(fp) != 0 || status != success || rename(tmp, path) != 0)
+   {
+      tell(0, "Error: Writing file '%s' failed, %s", path, strerror(errno));
+      unlink(tmp);
+      status = fail;
+   }
+
+   free(tmp);
+
+   return status;
+}
+
 //***************************************************************************
 // Dirty code but mathgl don't support 'normal' UFT-8 or ISO Codes :(
 //***************************************************************************
@@ -187,59 +527,145 @@ const char* toMglCode(const char* from)
 }
 
 //***************************************************************************
-// Chart
+// Load Series
+//   - samples of a sensor in the range, from the series cache, the archive
+//     and the database, each series is selected only once per call
 //***************************************************************************
 
-int chart(const char* sensorList, const char* file, int interval)
+std::map<std::string, Series> seriesLoaded;
+
+Series* loadSeries(const char* name, int interval)
 {
-   std::vector<Sensor> sensors;
-   std::vector<Sensor>::iterator it;
+   char* key;
 
-   const char* colors = "krGbcymhwRgBCYMHW";
+   asprintf(&key, "%s|%d|%s", name, interval, archiveDir ? archiveDir : "");
 
-   int multiAxis = no;
-   mglGraph* gr = new mglGraph(0, 1360, 768); // 1024, 300); 
-   long st, et;
+   if (seriesLoaded.find(key) != seriesLoaded.end())
+   {
+      Series* series = &seriesLoaded[key];
+      free(key);
+      return series;
+   }
 
-   // ---------------------------
-   // fill mglData
+   Series* series = &seriesLoaded[key];
+   time_t since = time(0) - interval * tmeSecondsPerHour;
+   char* seriesFile = 0;
+   int rows = 0;
 
-   // select s.time, s.value, f.unit, f.title 
-   //   from samples s, valuefacts f 
-   //     where s.address = f.address
-   //     and s.type = f.type 
-   //     and s.time > DATE_SUB(NOW(),INTERVAL 24 HOUR) 
-   //     and f.name = ?
-   //   order by time;
+   sDb->clear();
+   sfDb->clear();
+   sfDb->setValue("NAME", name);
 
-   cDbStatement* stmt = new cDbStatement(sDb);
-   
-   stmt->build("select ");
-   stmt->setBindPrefix("s.");
-   stmt->bind(cTableSamples::fiTime, cDBS::bndOut);
-   stmt->bind(cTableSamples::fiValue, cDBS::bndOut, ", ");
-   stmt->setBindPrefix("f.");
-   stmt->bind(sfDb->getValue(cTableValueFacts::fiUnit), cDBS::bndOut, ", ");
-   stmt->bind(sfDb->getValue(cTableValueFacts::fiTitle), cDBS::bndOut, ", ");
-   stmt->build(" from %s s, %s f where ", sDb->TableName(), sfDb->TableName());
-   stmt->build("s.address = f.address ");
-   stmt->build("and s.type = f.type ");
-   stmt->build("and s.%s > DATE_SUB(NOW(),INTERVAL %d HOUR)", 
-            sDb->getField(cTableSamples::fiTime)->name, interval);
-   stmt->bind(sfDb->getValue(cTableValueFacts::fiName), cDBS::bndIn | cDBS::bndSet, " and ");
-   stmt->build(" order by %s;", sDb->getField(cTableSamples::fiTime)->name);
-   stmt->prepare();
+   if (cacheDir)
+      seriesFile = cacheFile("series", key, ".dat");
 
-   // --------------------
-   // fill sensor list
+   free(key);
+
+   // the samples of the last call are cached, select only the newer ones
+
+   if (seriesFile && readSeriesFile(seriesFile, series, since) == success)
+   {
+      if (series->samples.size())
+         since = series->samples.back().time;
+
+      tell(1, "took %d cached samples for '%s'", (int)series->samples.size(), name);
+   }
+
+   // the older part of the range may already be moved to the archive
+
+   else if (selSensor && selSensor->find())
+   {
+      cArchive archive(archiveDir);
+      std::vector<cArchive::Point> points;
+      time_t now = time(0);
+
+      // samples and aggregation rows are archived apart, the table delivers both
+
+      archive.read(sfDb->getStrValue("TYPE"), sfDb->getIntValue("ADDRESS"),
+                   now - interval * tmeSecondsPerHour, now, points, "S");
+      archive.read(sfDb->getStrValue("TYPE"), sfDb->getIntValue("ADDRESS"),
+                   now - interval * tmeSecondsPerHour, now, points, "A");
+
+      std::sort(points.begin(), points.end(), cArchive::before);
+
+      for (uint i = 0; i < points.size(); i++)
+      {
+         cDownsample::Point p = { points[i].time, points[i].value };
+         series->samples.push_back(p);
+      }
+
+      series->title = toMglCode(sfDb->getStrValue("TITLE"));
+      series->unit = toMglCode(sfDb->getStrValue("UNIT"));
+
+      tell(1, "added %d archived samples for '%s'", (int)points.size(), name);
+   }
+
+   if (selSensor)
+      selSensor->freeResult();
+
+   sDb->setValue("TIME", since);
+
+   for (int f = selSamples->find(); f; f = selSamples->fetch())
+   {
+      if (!rows++)
+      {
+         series->title = toMglCode(sfDb->getStrValue("TITLE"));
+         series->unit = toMglCode(sfDb->getStrValue("UNIT"));
+      }
+
+      cDownsample::Point p = { sDb->getTimeValue("TIME"), sDb->getFloatValue("VALUE") };
+      series->samples.push_back(p);
+   }
 
-   string lastUnit = "";
-   char* ss = strdup(sensorList);
+   selSamples->freeResult();
+
+   if (seriesFile)
+   {
+      writeSeriesFile(seriesFile, series);
+      free(seriesFile);
+   }
+
+   return series;
+}
+
+//***************************************************************************
+// Load Chart
+//   - parse the sensor list, check the cache and fill the mglData
+//***************************************************************************
+
+int loadChart(Chart* chart)
+{
+   cTimeMs timer;
+   char* ss = strdup(chart->sensorList.c_str());
    char* b = ss;
    char* e = 0;
    Sensor s;
-   int _min = 999999;
-   int _max = -999999;
+
+   // nothing to do if no sample arrived since the cached chart was rendered
+
+   if (cacheDir)
+   {
+      char* key;
+
+      asprintf(&key, "%s|%d|%dx%d|%s|%s", chart->sensorList.c_str(), chart->interval,
+               chart->width, chart->height, cDownsample::toName(downsampleMode), archiveDir ? archiveDir : "");
+      chart->cacheKey = key;
+      free(key);
+
+      chart->newest = maxSampleTime();
+
+      if (chart->newest && cachedChart(chart->cacheKey.c_str(), chart->newest, chart->file.c_str()) == success)
+      {
+         tell(1, "No samples since %s, took the chart '%s' from the cache",
+              l2pTime(chart->newest).c_str(), chart->file.c_str());
+         chart->cached = yes;
+         free(ss);
+         return success;
+      }
+   }
+
+   // --------------------
+   // fill sensor list
 
    while ((e = strchr(b, ',')))
    {
@@ -256,7 +682,7 @@ int chart(const char* sensorList, const char* file, int interval)
       s.name = b;
 
       tell(2, "Added sensor: %s, color '%s'", s.name.c_str(), s.color.c_str());
-      sensors.push_back(s);
+      chart->sensors.push_back(s);
 
       b = e+1;
    }
@@ -270,57 +696,76 @@ int chart(const char* sensorList, const char* file, int interval)
    }
 
    s.name = b;
-   sensors.push_back(s);
+   chart->sensors.push_back(s);
    tell(2, "Added sensor: %s, color '%s'", s.name.c_str(), s.color.c_str());
 
    free(ss);
 
-   for (it = sensors.begin(); it != sensors.end(); it++)
+   for (std::vector<Sensor>::iterator it = chart->sensors.begin(); it != chart->sensors.end(); it++)
    {
-      int i = 0;
-      
-      sDb->clear();
-      sfDb->clear();
-      sfDb->setValue(cTableValueFacts::fiName, (*it).name.c_str());
+      Series* series = loadSeries((*it).name.c_str(), chart->interval);
+      std::vector<cDownsample::Point> reduced;
+
+      (*it).title = series->title;
+      (*it).unit = series->unit;
 
-      for (int f = stmt->find(); f; f = stmt->fetch())
+      if (series->samples.size())
       {
-         if (i)
-         {
-            (*it).ydat.Insert('x', i, 1);
-            (*it).xdat.Insert('x', i, 1);
-         }
-         else
-         {
-            (*it).title = toMglCode(sfDb->getValue(cTableValueFacts::fiTitle)->getStrValue());
-            (*it).unit = toMglCode(sfDb->getValue(cTableValueFacts::fiUnit)->getStrValue());
+         chart->st = series->samples.front().time;
+         chart->et = series->samples.back().time;
 
-            if (lastUnit.length() && lastUnit != (*it).unit)
-               multiAxis = yes;
-            
-            lastUnit = (*it).unit;
+         if (chart->lastUnit.length() && chart->lastUnit != (*it).unit)
+            chart->multiAxis = yes;
 
-            st = sDb->getRow()->getValue(cTableSamples::fiTime)->getTimeValue();
-         }
-         
-         (*it).xdat.a[i] = sDb->getRow()->getValue(cTableSamples::fiTime)->getTimeValue();
-         (*it).ydat.a[i] = sDb->getFloatValue(cTableSamples::fiValue);
-         
-         et = sDb->getRow()->getValue(cTableSamples::fiTime)->getTimeValue();
+         chart->lastUnit = (*it).unit;
+      }
+
+      // more points than pixel only blur the line, reduce them to the chart width
+
+      cDownsample::reduce(downsampleMode, series->samples, reduced, chart->width);
+
+      (*it).xdat.Create(max((int)reduced.size(), 1));
+      (*it).ydat.Create(max((int)reduced.size(), 1));
 
-         i++;
+      for (uint i = 0; i < reduced.size(); i++)
+      {
+         (*it).xdat.a[i] = reduced[i].time;
+         (*it).ydat.a[i] = reduced[i].value;
       }
 
-      if (_min > (*it).ydat.Minimal())
-         _min = (*it).ydat.Minimal();
+      if (chart->_min > (*it).ydat.Minimal())
+         chart->_min = (*it).ydat.Minimal();
+
+      if (chart->_max < (*it).ydat.Maximal())
+         chart->_max = (*it).ydat.Maximal();
 
-      if (_max < (*it).ydat.Maximal())
-         _max = (*it).ydat.Maximal();
+      chart->samples += series->samples.size();
 
-      stmt->freeResult();
-      tell(1, "added %d samples for '%s' in color '%s'", i, (*it).name.c_str(), (*it).color.c_str());
+      tell(1, "added %d samples for '%s' in color '%s', %d points plotted (%s)", (int)series->samples.size(),
+           (*it).name.c_str(), (*it).color.c_str(), (int)reduced.size(), cDownsample::toName(downsampleMode));
    }
 
+   chart->loadMs = timer.Elapsed();
+
+   return success;
+}
+
+//***************************************************************************
+// Render Chart
+//   - no database access, may run in a thread of the render pool
+//***************************************************************************
+
+int renderChart(Chart* chart)
+{
+   std::vector<Sensor>::iterator it;
+   const char* colors = "krGbcymhwRgBCYMHW";
+   cTimeMs timer;
+
+   if (chart->cached)
+      return done;
+
+   mglGraph* gr = new mglGraph(0, chart->width, chart->height); // 1024, 300); 
+
    // some settings
 
    gr->SubPlot(1, 1, 0,"");
@@ -337,18 +782,18 @@ int chart(const char* sensorList, const char* file, int interval)
    gr->Clf(40, 40, 40);      // background color (RGB)
 
    gr->SetOrigin(NAN, NAN);
-   gr->SetRange('x', st, et);
+   gr->SetRange('x', chart->st, chart->et);
 
-   if (interval >= 48)
+   if (chart->interval >= 48)
       gr->SetTicksTime('x', 0, "%d.%m.%y");
    else
       gr->SetTicksTime('x', 0, "%H:%M");
 
-   if (!multiAxis)
+   if (!chart->multiAxis)
    {
-      double off = _max / 10;
-      gr->SetRange('y', _min-off, _max+off);
-      gr->Label('y', lastUnit.c_str());
+      double off = chart->_max / 10;
+      gr->SetRange('y', chart->_min-off, chart->_max+off);
+      gr->Label('y', chart->lastUnit.c_str());
       gr->Axis();
       gr->Grid("", ":");
    }
@@ -362,7 +807,7 @@ int chart(const char* sensorList, const char* file, int interval)
 
    int pos = 0;
 
-   for (it = sensors.begin(); it != sensors.end(); it++, pos++)
+   for (it = chart->sensors.begin(); it != chart->sensors.end(); it++, pos++)
    {
       char* tmp;
       double off = (*it).ydat.Maximal() / 10;
@@ -374,7 +819,7 @@ int chart(const char* sensorList, const char* file, int interval)
 
       strcpy(c , (*it).color.c_str());
 
-      if (multiAxis)
+      if (chart->multiAxis)
       {
          if (isEmpty((*it).color.c_str()))
          {
@@ -399,46 +844,365 @@ int chart(const char* sensorList, const char* file, int interval)
    }
 
    gr->Legend();
-   gr->WriteJPEG(file);
+   gr->WriteJPEG(chart->file.c_str());
+
+   if (chart->cacheKey.length())
+      storeChart(chart->cacheKey.c_str(), chart->newest, chart->file.c_str());
 
-   delete stmt;
    delete gr;
 
+   chart->renderMs = timer.Elapsed();
+
+   return success;
+}
+
+//***************************************************************************
+// Chart
+//***************************************************************************
+
+int chart(const char* sensorList, const char* file, int interval)
+{
+   Chart c;
+
+   c.sensorList = sensorList;
+   c.file = file;
+   c.interval = interval;
+
+   if (loadChart(&c) != success)
+      return fail;
+
+   return renderChart(&c);
+}
+
+//***************************************************************************
+// Batch
+//   - one chart per line of 'listFile': <file> <sensor-list> [<interval>]
+//   - the samples are selected one after the other (sensors used by
+//     several charts only once), the charts are rendered by 'threads'
+//     threads in parallel, charts of the same cache key only once
+//***************************************************************************
+
+struct RenderPool
+{
+   std::vector<Chart>* charts;
+   size_t next;
+   cMyMutex mutex;
+};
+
+void* renderThread(void* arg)
+{
+   RenderPool* pool = (RenderPool*)arg;
+
+   while (true)
+   {
+      size_t i;
+
+      pool->mutex.Lock();
+      i = pool->next++;
+      pool->mutex.Unlock();
+
+      if (i >= pool->charts->size())
+         break;
+
+      if ((*pool->charts)[i].sameAs == na)
+         renderChart(&(*pool->charts)[i]);
+   }
+
    return 0;
 }
 
+int batch(const char* listFile, int interval, int threads)
+{
+   std::vector<Chart> charts;
+   std::vector<pthread_t> tids;
+   RenderPool pool;
+   cTimeMs timer;
+   char line[1000+TB];
+   FILE* fp;
+
+   if (!(fp = fopen(listFile, "r")))
+   {
+      tell(0, "Error: Can't open chart list '%s', %s", listFile, strerror(errno));
+      return fail;
+   }
+
+   while (fgets(line, 1000, fp))
+   {
+      char file[500+TB];
+      char sensors[500+TB];
+      char* p = allTrim(line);
+      Chart c;
+
+      c.interval = interval;
+
+      if (*p == '#' || sscanf(p, "%500s %500s %d", file, sensors, &c.interval) < 2)
+         continue;
+
+      c.file = file;
+      c.sensorList = sensors;
+      charts.push_back(c);
+   }
+
+   fclose(fp);
+
+   if (threads <= 0)
+      threads = max((int)sysconf(_SC_NPROCESSORS_ONLN), 1);
+
+   threads = min(threads, max((int)charts.size(), 1));
+
+   // select all samples
+
+   for (uint i = 0; i < charts.size(); i++)
+      loadChart(&charts[i]);
+
+   uint64_t loadMs = timer.Elapsed();
+
+   // charts of the same key are rendered once, they would write the same cache files
+
+   std::map<std::string, int> byKey;
+
+   for (uint i = 0; i < charts.size(); i++)
+   {
+      Chart* c = &charts[i];
+
+      if (c->cached || c->cacheKey.empty())
+         continue;
+
+      if (byKey.find(c->cacheKey) != byKey.end())
+         c->sameAs = byKey[c->cacheKey];
+      else
+         byKey[c->cacheKey] = i;
+   }
+
+   // and render them on all cores
+
+   pool.charts = &charts;
+   pool.next = 0;
+
+   for (int i = 0; i < threads; i++)
+   {
+      pthread_t tid;
+
+      if (pthread_create(&tid, 0, renderThread, &pool) == 0)
+         tids.push_back(tid);
+   }
+
+   if (tids.empty())
+      renderThread(&pool);
+
+   for (uint i = 0; i < tids.size(); i++)
+      pthread_join(tids[i], 0);
+
+   for (uint i = 0; i < charts.size(); i++)
+   {
+      Chart* c = &charts[i];
+
+      if (c->sameAs != na && c->file != charts[c->sameAs].file)
+         copyFile(charts[c->sameAs].file.c_str(), c->file.c_str());
+
+      tell(0, "%-30s %2d sensors, %7d samples, load %4ld ms, render %4ld ms%s", c->file.c_str(),
+           (int)c->sensors.size(), c->samples, (long)c->loadMs, (long)c->renderMs,
+           c->cached ? " (cached)" : c->sameAs != na ? " (copied)" : "");
+   }
+
+   tell(0, "%d charts in %ld ms (select %ld ms, %d sensors; render with %d threads)",
+        (int)charts.size(), (long)timer.Elapsed(), (long)loadMs, (int)seriesLoaded.size(), (int)tids.size());
+
+   return success;
+}
+
 //***************************************************************************
 // Actual
+//   - values of the newest samples, written to '<file>.tmp' and renamed
+//       afText   variables as needed by VDRs gtft plugin
+//       afJson   {"time": .., "values": [{"name": .., ..}, ..]}
+//       afCsv    time,name,title,unit,value,text
+//   - with 'watch' [s] it keeps running and writes the file after each
+//     cycle of p4d, sensors with unchanged values aren't formatted again
+//   - p4d writes the samples of a cycle in background, a cycle is taken
+//     when its row count didn't change since the last poll and written
+//     again if rows came later
 //***************************************************************************
 
-int actual(const char* file)
+enum ActualFormat
+{
+   afText,
+   afJson,
+   afCsv
+};
+
+struct ActualValue
+{
+   double value;
+   string text;
+   string title;
+   string unit;
+   string formatted;
+};
+
+std::map<std::string, ActualValue> actualValues;    // by sensor name
+int doShutdown = no;
+
+void onSignal(int signal)
+{
+   doShutdown = yes;
+}
+
+string csvField(const char* s)
+{
+   return "\"" + strReplace("\"", "\"\"", s) + "\"";
+}
+
+string formatActual(ActualFormat format, const char* name, ActualValue* v)
+{
+   char* buf = 0;
+   string result;
+
+   if (format == afJson)
+   {
+      asprintf(&buf, "{\"name\": %s, \"title\": %s, \"unit\": %s, \"value\": %g, \"text\": %s}",
+               cHttpServer::jsonEscape(name).c_str(), cHttpServer::jsonEscape(v->title.c_str()).c_str(),
+               cHttpServer::jsonEscape(v->unit.c_str()).c_str(), v->value,
+               cHttpServer::jsonEscape(v->text.c_str()).c_str());
+   }
+   else if (format == afCsv)
+   {
+      // without the time, it's written in front of each line
+
+      asprintf(&buf, ",%s,%s,%s,%g,%s\n", csvField(name).c_str(), csvField(v->title.c_str()).c_str(),
+               csvField(v->unit.c_str()).c_str(), v->value, csvField(v->text.c_str()).c_str());
+   }
+   else
+   {
+      char* var = strdup(name);
+
+      var[0] = toupper(var[0]);
+
+      if (v->value != int(v->value))
+         asprintf(&buf, "// --------------------------------------------\n"
+                  "var var%sValue = %2.1f;\n", var, v->value);
+      else
+         asprintf(&buf, "// --------------------------------------------\n"
+                  "var var%sValue = %d;\n", var, (int)v->value);
+
+      result = buf;
+      free(buf);
+
+      asprintf(&buf, "var var%sTitle = %s;\nvar var%sUnit = %s;\nvar var%sText = %s;\n",
+               var, v->title.c_str(), var, v->unit.c_str(), var, v->text.c_str());
+
+      free(var);
+   }
+
+   result += buf;
+   free(buf);
+
+   return result;
+}
+
+int writeActual(cDbStatement* s, const char* file, ActualFormat format, time_t lastTime)
 {
+   string out;
+   char* tmp;
+   char* buf;
+   char timeStr[30];
    FILE* fp;
-   char line[500];
-   long lastTime;
+   int count = 0;
+   int formatted = 0;
 
-   // select max(time) from samples;
+   if (format == afJson)
+      asprintf(&buf, "{\"time\": %ld, \"values\": [", (long)lastTime);
+   else if (format == afCsv)
+      asprintf(&buf, "time,name,title,unit,value,text\n");
+   else
+      asprintf(&buf, "// %s\nvar varTime = %ld;\n", l2pTime(lastTime).c_str(), (long)lastTime);
 
-   cDbStatement* selMaxTime = new cDbStatement(sDb);
-   
-   selMaxTime->build("select max(");
-   selMaxTime->bind(cTableSamples::fiTime, cDBS::bndOut);
-   selMaxTime->build(") from %s;", sDb->TableName());
-   selMaxTime->prepare();
+   out = buf;
+   free(buf);
+
+   sprintf(timeStr, "%ld", (long)lastTime);
 
    sDb->clear();
+   sfDb->clear();
+   sDb->setValue("TIME", lastTime);
 
-   if (!selMaxTime->find())
-      return done;
+   for (int f = s->find(); f; f = s->fetch())
+   {
+      const char* name = sfDb->getStrValue("NAME");
+      ActualValue* v;
 
-   lastTime = sDb->getRow()->getValue(cTableSamples::fiTime)->getTimeValue();
+      if (isEmpty(name))
+         continue;
 
-   selMaxTime->freeResult();
+      v = &actualValues[name];
 
-   delete selMaxTime; 
-   selMaxTime = 0;
+      if (v->formatted.empty() || v->value != sDb->getFloatValue("VALUE")
+          || v->text != sDb->getStrValue("TEXT") || v->title != sfDb->getStrValue("TITLE")
+          || v->unit != sfDb->getStrValue("UNIT"))
+      {
+         v->value = sDb->getFloatValue("VALUE");
+         v->text = sDb->getStrValue("TEXT");
+         v->title = sfDb->getStrValue("TITLE");
+         v->unit = sfDb->getStrValue("UNIT");
+         v->formatted = formatActual(format, name, v);
+         formatted++;
+      }
+
+      if (format == afJson && count)
+         out += ", ";
+      else if (format == afCsv)
+         out += timeStr;
+
+      out += v->formatted;
+      count++;
+   }
 
-   // select s.value, f.name, f.title, f.unit
+   s->freeResult();
+
+   if (format == afJson)
+      out += "]}\n";
+
+   // write and rename, the readers never see a partial file
+
+   asprintf(&tmp, "%s.tmp", file);
+
+   if (!(fp = fopen(tmp, "w")))
+   {
+      tell(0, "Error: Can't open file '%s' for writing, %s", tmp, strerror(errno));
+      free(tmp);
+      return fail;
+   }
+
+   if (fwrite(out.c_str(), 1, out.length(), fp) != out.length() || fclose(fp) != 0 || rename(tmp, file) != 0)
+   {
+      tell(0, "Error: Writing file '%s' failed, %s", file, strerror(errno));
+      unlink(tmp);
+      free(tmp);
+      return fail;
+   }
+
+   free(tmp);
+
+   tell(1, "Wrote %d values of %s to '%s' (%d formatted)", count, l2pTime(lastTime).c_str(), file, formatted);
+
+   return success;
+}
+
+int countSamples(time_t time)
+{
+   int count = 0;
+   char* where;
+
+   asprintf(&where, "%s = from_unixtime(%ld)", sDb->getField("TIME")->getDbName(), (long)time);
+   sDb->countWhere(where, count);
+   free(where);
+
+   return count;
+}
+
+cDbStatement* prepareActual()
+{
+   // select s.value, s.text, f.name, f.title, f.unit
    //   from samples s, valuefacts f 
    //     where s.address = f.address and s.type = f.type and s.time = ?;
 
@@ -446,73 +1210,97 @@ int actual(const char* file)
 
    s->build("select ");
    s->setBindPrefix("s.");
-   s->bind(cTableSamples::fiValue, cDBS::bndOut);
-   s->bind(cTableSamples::fiText, cDBS::bndOut, ", ");
+   s->bind("VALUE", cDBS::bndOut);
+   s->bind("TEXT", cDBS::bndOut, ", ");
    s->setBindPrefix("f.");
-   s->bind(sfDb->getValue(cTableValueFacts::fiName), cDBS::bndOut, ", ");
-   s->bind(sfDb->getValue(cTableValueFacts::fiTitle), cDBS::bndOut, ", ");
-   s->bind(sfDb->getValue(cTableValueFacts::fiUnit), cDBS::bndOut, ", ");
+   s->bind(sfDb->getValue("NAME"), cDBS::bndOut, ", ");
+   s->bind(sfDb->getValue("TITLE"), cDBS::bndOut, ", ");
+   s->bind(sfDb->getValue("UNIT"), cDBS::bndOut, ", ");
    s->build(" from %s s, %s f where ", sDb->TableName(), sfDb->TableName());
    s->build("s.address = f.address ");
    s->build("and s.type = f.type ");
    s->setBindPrefix("s.");
-   s->bind(sDb->getValue(cTableSamples::fiTime), cDBS::bndIn | cDBS::bndSet, "and ");
+   s->bind(sDb->getValue("TIME"), cDBS::bndIn | cDBS::bndSet, "and ");
    s->build(";");
-   s->prepare();
 
-   sDb->clear();
-   sfDb->clear();
-   sDb->setValue(cTableSamples::fiTime, lastTime);  //-60*60);
+   if (s->prepare() != success)
+   {
+      delete s;
+      return 0;
+   }
 
-   fp = fopen(file, "w");
+   return s;
+}
 
-   if (fp)
+int actual(const char* file, ActualFormat format, int watch)
+{
+   time_t lastWritten = 0;
+   int writtenRows = 0;
+   time_t pendingTime = 0;
+   int pendingRows = 0;
+   int polls = 0;
+   cDbStatement* s;
+
+   if (!(s = prepareActual()))
+      return fail;
+
+   if (watch)
+   {
+      ::signal(SIGTERM, onSignal);
+      ::signal(SIGINT, onSignal);
+   }
+
+   // max(time) is served by the index on time, cheap enough to poll,
+   //   without 'watch' it polls each second until the cycle is complete
+
+   while (!doShutdown)
    {
-      sprintf(line, "// %s\n", l2pTime(lastTime).c_str());
-      fputs(line, fp);
+      // reconnect like p4d does
+
+      while (watch && !doShutdown && (!connection || !connection->isConnected()))
+      {
+         delete s;
+         s = 0;
+         exitDb();
+
+         if (initDb() == success && (s = prepareActual()))
+            break;
 
-      sprintf(line, "var varTime = %ld;\n", lastTime);
-      fputs(line, fp);
+         tell(0, "Retrying in %d seconds", watch);
+
+         for (int i = 0; i < watch && !doShutdown; i++)
+            sleep(1);
+      }
 
-      for (int f = s->find(); f; f = s->fetch())
+      if (doShutdown)
+         break;
+
+      time_t lastTime = maxSampleTime();
+      int rows = lastTime ? countSamples(lastTime) : 0;
+
+      if (lastTime && (lastTime != lastWritten || rows != writtenRows)
+          && lastTime == pendingTime && rows == pendingRows)
       {
-         char* name = strdup(sfDb->getRow()->getValue(cTableValueFacts::fiName)->getStrValue());
-         
-         if (isEmpty(name))
-            continue;
-
-         name[0] = toupper(name[0]);
-
-         fprintf(fp, "// --------------------------------------------\n");
-
-         double v =  sDb->getRow()->getValue(cTableSamples::fiValue)->getFloatValue();
-
-         if (v != int(v))
-            fprintf(fp, "var var%sValue = %2.1f;\n", name, v);
-         else
-            fprintf(fp, "var var%sValue = %d;\n", name, (int)v);
-         
-         fprintf(fp, "var var%sTitle = %s;\n", name,
-                 sfDb->getRow()->getValue(cTableValueFacts::fiTitle)->getStrValue());
-                 
-         fprintf(fp, "var var%sUnit = %s;\n", name,
-                 sfDb->getRow()->getValue(cTableValueFacts::fiUnit)->getStrValue());
-
-         fprintf(fp, "var var%sText = %s;\n", name,
-                 sDb->getRow()->getValue(cTableSamples::fiText)->getStrValue());
-      
-         free(name);
+         if (writeActual(s, file, format, lastTime) == success)
+         {
+            lastWritten = lastTime;
+            writtenRows = rows;
+         }
       }
+
+      pendingTime = lastTime;
+      pendingRows = rows;
+
+      if (!watch && (lastWritten || !lastTime || ++polls > 10))
+         break;
+
+      for (int i = 0; i < max(watch, 1) && !doShutdown; i++)
+         sleep(1);
    }
-   else 
-      tell(0, "Error: can't open file '%s' for writing", file, strerror(errno));
-   
-   s->freeResult();
+
    delete s;
-   
-   fclose(fp);
 
-   return 0;
+   return success;
 }
 
 //***************************************************************************
@@ -522,7 +1310,11 @@ int actual(const char* file)
 int main(int argc, char** argv)
 {
    int doChart = no;
+   int doBatch = no;
    int doActual = no;
+   int threads = 0;
+   int watch = 0;
+   ActualFormat format = afText;
    const char* sensors = 0;
    const char* file = 0;
    int interval = 10;
@@ -545,6 +1337,8 @@ int main(int argc, char** argv)
 
       if (strcmp(argv[1], "chart") == 0)
          doChart = yes;
+      else if (strcmp(argv[1], "batch") == 0)
+         doBatch = yes;
       else if (strcmp(argv[1], "actual") == 0)
          doActual = yes;
 
@@ -562,15 +1356,39 @@ int main(int argc, char** argv)
          case 'p': if (argv[i+1]) dbpass = argv[++i];         break;
          case 's': if (argv[i+1]) sensors = argv[++i];        break;
          case 'f': if (argv[i+1]) file = argv[++i];           break;
+         case 'c': if (argv[i+1]) confDir = argv[++i];        break;
+         case 'r': if (argv[i+1]) cDbStatement::prefetchRows = atoi(argv[++i]); break;
+         case 'A': if (argv[i+1]) archiveDir = argv[++i];     break;
+         case 'C': if (argv[i+1]) cacheDir = argv[++i];       break;
+         case 'j': if (argv[i+1]) threads = atoi(argv[++i]);  break;
+         case 'w': if (argv[i+1]) watch = atoi(argv[++i]);    break;
+         case 'o':
+         {
+            if (!argv[i+1])
+               break;
+
+            i++;
+
+            if (strcasecmp(argv[i], "json") == 0)
+               format = afJson;
+            else if (strcasecmp(argv[i], "csv") == 0)
+               format = afCsv;
+
+            break;
+         }
+         case 'm': if (argv[i+1]) downsampleMode = cDownsample::toMode(argv[++i], cDownsample::dmNone); break;
       }
    }
   
-   if (!doActual && !doChart)
+   if (!doActual && !doChart && !doBatch)
    {
       showUsage(argv[0]);
       return 0;
    }
 
+   if (cacheDir && mkdir(cacheDir, 0755) != 0 && errno != EEXIST)
+      tell(0, "Error: Can't create directory '%s', %s", cacheDir, strerror(errno));
+
    // init database connection
 
    if (initDb() != success)
@@ -585,8 +1403,17 @@ int main(int argc, char** argv)
       else
          chart(sensors, file, interval);
    }
+   else if (doBatch)
+   {
+      if (isEmpty(file))
+         tell(0, "Missing chart list");
+      else
+         batch(file, interval, threads);
+   }
+   else if (isEmpty(file))
+      tell(0, "Missing output file");
    else
-      actual(file);
+      actual(file, format, watch);
 
    // exit
 
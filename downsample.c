@@ -0,0 +1,223 @@
+//***************************************************************************
+// p4d / Linux - Heizungs Manager
+// File downsample.c
+// This code is distributed under the terms and conditions of the
+// GNU GENERAL PUBLIC LICENSE. See the file LICENSE for details.
+// Date 19.10.2026  Jörg Wendel
+//***************************************************************************
+
+#include <math.h>
+
+#include "downsample.h"
+
+//***************************************************************************
+// Reduce
+//***************************************************************************
+
+int cDownsample::reduce(Mode mode, const std::vector<Point>& in, std::vector<Point>& out, int maxPoints)
+{
+   switch (mode)
+   {
+      case dmLttb:    return lttb(in, out, maxPoints);
+      case dmMinMax:  return minMax(in, out, maxPoints);
+      case dmAverage: return average(in, out, maxPoints);
+      default:        out = in;
+   }
+
+   return success;
+}
+
+//***************************************************************************
+// LTTB
+//   - first and last point are kept, the others are split in 'maxPoints'-2
+//     buckets, of each bucket the point which forms the largest triangle
+//     with the point selected in the previous bucket and the average of
+//     the next bucket is taken
+//***************************************************************************
+
+int cDownsample::lttb(const std::vector<Point>& in, std::vector<Point>& out, int maxPoints)
+{
+   int count = in.size();
+
+   if (maxPoints >= count || maxPoints < 3)
+   {
+      out = in;
+      return success;
+   }
+
+   double every = (double)(count - 2) / (maxPoints - 2);
+   int a = 0;
+
+   out.clear();
+   out.reserve(maxPoints);
+   out.push_back(in[0]);
+
+   for (int b = 0; b < maxPoints - 2; b++)
+   {
+      // average of the next bucket, the last point for the last bucket
+
+      int avgStart = (int)floor((b + 1) * every) + 1;
+      int avgEnd = min((int)floor((b + 2) * every) + 1, count);
+      double avgTime = 0;
+      double avgValue = 0;
+
+      for (int i = avgStart; i < avgEnd; i++)
+      {
+         avgTime += in[i].time;
+         avgValue += in[i].value;
+      }
+
+      if (avgEnd > avgStart)
+      {
+         avgTime /= avgEnd - avgStart;
+         avgValue /= avgEnd - avgStart;
+      }
+      else
+      {
+         avgTime = in[count-1].time;
+         avgValue = in[count-1].value;
+      }
+
+      // point of this bucket with the largest triangle
+
+      int start = (int)floor(b * every) + 1;
+      int end = min((int)floor((b + 1) * every) + 1, count - 1);
+      double maxArea = -1;
+      int next = start;
+
+      // relative to point 'a' to keep the precision of the epoch times
+
+      double aTime = in[a].time;
+      double aValue = in[a].value;
+
+      for (int i = start; i < end; i++)
+      {
+         double area = fabs((aTime - avgTime) * (in[i].value - aValue)
+                            - (aTime - in[i].time) * (avgValue - aValue));
+
+         if (area > maxArea)
+         {
+            maxArea = area;
+            next = i;
+         }
+      }
+
+      out.push_back(in[next]);
+      a = next;
+   }
+
+   out.push_back(in[count-1]);
+
+   return success;
+}
+
+//***************************************************************************
+// Min Max
+//   - 'maxPoints'/2 buckets of equal time span, min and max of each bucket
+//     in the order of their time
+//***************************************************************************
+
+int cDownsample::minMax(const std::vector<Point>& in, std::vector<Point>& out, int maxPoints)
+{
+   int count = in.size();
+   int buckets = maxPoints / 2;
+
+   if (maxPoints >= count || buckets < 1)
+   {
+      out = in;
+      return success;
+   }
+
+   double span = in[count-1].time - in[0].time + 1;
+
+   out.clear();
+   out.reserve(maxPoints);
+
+   for (int i = 0; i < count; )
+   {
+      int bucket = (int)((in[i].time - in[0].time) * buckets / span);
+      int iMin = i;
+      int iMax = i;
+
+      for (; i < count && (int)((in[i].time - in[0].time) * buckets / span) == bucket; i++)
+      {
+         if (in[i].value < in[iMin].value) iMin = i;
+         if (in[i].value > in[iMax].value) iMax = i;
+      }
+
+      out.push_back(in[min(iMin, iMax)]);
+
+      if (iMin != iMax)
+         out.push_back(in[max(iMin, iMax)]);
+   }
+
+   return success;
+}
+
+//***************************************************************************
+// Average
+//   - 'maxPoints' buckets of equal time span
+//***************************************************************************
+
+int cDownsample::average(const std::vector<Point>& in, std::vector<Point>& out, int maxPoints)
+{
+   int count = in.size();
+
+   if (maxPoints >= count || maxPoints < 1)
+   {
+      out = in;
+      return success;
+   }
+
+   double span = in[count-1].time - in[0].time + 1;
+
+   out.clear();
+   out.reserve(maxPoints);
+
+   for (int i = 0; i < count; )
+   {
+      int bucket = (int)((in[i].time - in[0].time) * maxPoints / span);
+      double sumTime = 0;
+      double sumValue = 0;
+      int n = 0;
+
+      for (; i < count && (int)((in[i].time - in[0].time) * maxPoints / span) == bucket; i++, n++)
+      {
+         sumTime += in[i].time;
+         sumValue += in[i].value;
+      }
+
+      Point p = { (time_t)(sumTime / n), sumValue / n };
+      out.push_back(p);
+   }
+
+   return success;
+}
+
+//***************************************************************************
+// To Mode / Name
+//***************************************************************************
+
+cDownsample::Mode cDownsample::toMode(const char* name, Mode def)
+{
+   if (isEmpty(name))
+      return def;
+
+   if (strcasecmp(name, "none") == 0)    return dmNone;
+   if (strcasecmp(name, "lttb") == 0)    return dmLttb;
+   if (strcasecmp(name, "minmax") == 0)  return dmMinMax;
+   if (strcasecmp(name, "avg") == 0)     return dmAverage;
+
+   return def;
+}
+
+const char* cDownsample::toName(Mode mode)
+{
+   switch (mode)
+   {
+      case dmLttb:    return "lttb";
+      case dmMinMax:  return "minmax";
+      case dmAverage: return "avg";
+      default:        return "none";
+   }
+}
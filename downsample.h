@@ -0,0 +1,57 @@
+//***************************************************************************
+// p4d / Linux - Heizungs Manager
+// File downsample.h
+// This code is distributed under the terms and conditions of the
+// GNU GENERAL PUBLIC LICENSE. See the file LICENSE for details.
+// Date 19.10.2026  Jörg Wendel
+//***************************************************************************
+
+#ifndef _DOWNSAMPLE_H_
+#define _DOWNSAMPLE_H_
+
+#include <time.h>
+
+#include <vector>
+
+#include "lib/common.h"
+
+//***************************************************************************
+// Class Downsample
+//   - reduce a series (sorted by time) to at most 'maxPoints' points,
+//     usually the width of the chart in pixel
+//
+//     dmLttb     Largest-Triangle-Three-Buckets, keeps the visual shape
+//     dmMinMax   min and max of each bucket, keeps the peaks
+//     dmAverage  average of each bucket (time and value)
+//***************************************************************************
+
+class cDownsample
+{
+   public:
+
+      enum Mode
+      {
+         dmNone,
+         dmLttb,
+         dmMinMax,
+         dmAverage
+      };
+
+      struct Point
+      {
+         time_t time;
+         double value;
+      };
+
+      static int reduce(Mode mode, const std::vector<Point>& in, std::vector<Point>& out, int maxPoints);
+
+      static int lttb(const std::vector<Point>& in, std::vector<Point>& out, int maxPoints);
+      static int minMax(const std::vector<Point>& in, std::vector<Point>& out, int maxPoints);
+      static int average(const std::vector<Point>& in, std::vector<Point>& out, int maxPoints);
+
+      static Mode toMode(const char* name, Mode def = dmLttb);
+      static const char* toName(Mode mode);
+};
+
+//***************************************************************************
+#endif // _DOWNSAMPLE_H_
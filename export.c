@@ -0,0 +1,733 @@
+//***************************************************************************
+// p4d / Linux - Heizungs Manager
+// File export.c
+// This code is distributed under the terms and conditions of the
+// GNU GENERAL PUBLIC LICENSE. See the file LICENSE for details.
+// Date 19.10.2026  Jörg Wendel
+//***************************************************************************
+
+#include <sys/stat.h>
+#include <dirent.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "export.h"
+
+int cExport::chunkRows = 100000;
+int cExport::insertRows = 500;
+
+//***************************************************************************
+// Object
+//***************************************************************************
+
+cExport::cExport(const char* aPath, cDbConnectionPool* aPool)
+   : updspDef("updsp", "updsp", cDBS::ffInt, 10, cDBS::ftData)
+{
+   path = strdup(aPath);
+   pool = aPool;
+   pooled = 0;
+   connection = 0;
+
+   fromValue.setField(&updspDef);
+   toValue.setField(&updspDef);
+}
+
+cExport::~cExport()
+{
+   disconnect();
+   free(path);
+}
+
+int cExport::connect()
+{
+   if (!(pooled = pool->acquire()))
+   {
+      tell(eloAlways, "Error: Connecting database failed");
+      return fail;
+   }
+
+   connection = pooled->getConnection();
+
+   return success;
+}
+
+void cExport::disconnect()
+{
+   if (pooled)
+   {
+      pool->release(pooled);
+      pooled = 0;
+      connection = 0;
+   }
+}
+
+//***************************************************************************
+// Watermark
+//   - end of the last export, rows with a UPDSP before are already exported
+//***************************************************************************
+
+int cExport::readWatermark(time_t& watermark)
+{
+   char* file;
+   FILE* f;
+   long wm = 0;
+
+   watermark = 0;
+   asprintf(&file, "%s/watermark", path);
+
+   if ((f = fopen(file, "r")))
+   {
+      if (fscanf(f, "%ld", &wm) == 1)
+         watermark = wm;
+
+      fclose(f);
+   }
+
+   free(file);
+
+   return success;
+}
+
+int cExport::writeWatermark(time_t watermark)
+{
+   char* file;
+   char* tmp;
+   FILE* f;
+   int status = fail;
+
+   asprintf(&file, "%s/watermark", path);
+   asprintf(&tmp, "%s.tmp", file);
+
+   if ((f = fopen(tmp, "w")))
+   {
+      fprintf(f, "%ld\n", (long)watermark);
+
+      if (fclose(f) == 0 && rename(tmp, file) == 0)
+         status = success;
+   }
+
+   if (status != success)
+      tell(eloAlways, "Error: Writing watermark '%s' failed, %s", file, strerror(errno));
+
+   free(tmp);
+   free(file);
+
+   return status;
+}
+
+//***************************************************************************
+// Escape / Unescape
+//   - backslash, tab, newline, carriage return and 0 are escaped
+//***************************************************************************
+
+void cExport::escape(std::string& out, const char* data, int size)
+{
+   for (int i = 0; i < size; i++)
+   {
+      switch (data[i])
+      {
+         case '\\': out += "\\\\"; break;
+         case '\t': out += "\\t";  break;
+         case '\n': out += "\\n";  break;
+         case '\r': out += "\\r";  break;
+         case 0:    out += "\\0";  break;
+         default:   out += data[i];
+      }
+   }
+}
+
+int cExport::unescape(char* value)
+{
+   char* d = value;
+
+   for (char* s = value; *s; s++)
+   {
+      if (*s == '\\' && *(s+1))
+      {
+         s++;
+
+         switch (*s)
+         {
+            case 't': *d++ = '\t'; break;
+            case 'n': *d++ = '\n'; break;
+            case 'r': *d++ = '\r'; break;
+            case '0': *d++ = 0;    break;
+            default:  *d++ = *s;
+         }
+      }
+      else
+         *d++ = *s;
+   }
+
+   *d = 0;
+
+   return d - value;
+}
+
+std::string cExport::hexLiteral(const char* data, int size)
+{
+   std::string hex = "X'";
+   char h[3];
+
+   for (int n = 0; n < size; n++)
+   {
+      sprintf(h, "%02x", (byte)data[n]);
+      hex += h;
+   }
+
+   return hex + "'";
+}
+
+int cExport::readLine(gzFile gz, std::string& line)
+{
+   char buf[1024+TB];
+
+   line = "";
+
+   while (gzgets(gz, buf, sizeof(buf)))
+   {
+      line += buf;
+
+      if (line[line.length()-1] == '\n')
+      {
+         line.erase(line.length()-1);
+         return success;
+      }
+   }
+
+   return line.length() ? success : fail;     // end of file
+}
+
+//***************************************************************************
+// Export Tables
+//***************************************************************************
+
+int cExport::exportTables()
+{
+   std::map<std::string, cDbTableDef*>::iterator t;
+   time_t from;
+   time_t to = time(0);       // rows of the current second go to the next export
+   double start = usNow();
+   int status = success;
+   int files = 0;
+   long rows = 0;
+
+   if (mkdir(path, 0755) != 0 && errno != EEXIST)
+   {
+      tell(eloAlways, "Error: Can't create export directory '%s', %s", path, strerror(errno));
+      return fail;
+   }
+
+   readWatermark(from);
+
+   if (connect() != success)
+      return fail;
+
+   tell(eloAlways, "Exporting rows changed since %s to '%s' ...",
+        from ? l2pTime(from).c_str() : "ever", path);
+
+   for (t = dbDict.getFirstTableIterator(); t != dbDict.getTableEndIterator() && status == success; t++)
+   {
+      cDbTable* table = new cDbTable(connection, t->first.c_str());
+
+      if (table->open() != success)
+         status = fail;
+      else
+         status = exportTable(table, from, to, files, rows);
+
+      delete table;
+   }
+
+   disconnect();
+
+   // move the watermark only if all tables are complete, a failed run
+   //   is repeated from the old one, the import replaces duplicate rows
+
+   if (status != success || writeWatermark(to) != success)
+   {
+      tell(eloAlways, "Error: Export failed, watermark kept at %s", from ? l2pTime(from).c_str() : "begin");
+      return fail;
+   }
+
+   tell(eloAlways, "Exported %ld rows to %d files in %.2f seconds",
+        rows, files, (usNow() - start) / 1000000);
+
+   return success;
+}
+
+//***************************************************************************
+// Export Table
+//***************************************************************************
+
+int cExport::exportTable(cDbTable* table, time_t from, time_t to, int& files, long& rows)
+{
+   cDbStatement* select = new cDbStatement(table);
+   int incremental = table->getTableDef()->getField("UPDSP", yes) != 0;
+   gzFile gz = 0;
+   char* file = 0;
+   int status = success;
+   int count = 0;
+   int seq = 0;
+
+   // select <all columns including the meta ones> from <table>
+   //   where updsp >= ? and updsp < ?
+   // tables without update stamp are exported completely
+
+   select->setStreaming();
+   select->build("select ");
+
+   for (int i = 0; i < table->fieldCount(); i++)
+      select->bind(table->getField(i), cDBS::bndOut, i ? ", " : "");
+
+   select->build(" from %s", table->TableName());
+
+   if (incremental)
+   {
+      select->build(" where ");
+      select->bindCmp(0, "UPDSP", &fromValue, ">=");
+      select->bindCmp(0, "UPDSP", &toValue, "<", " and ");
+   }
+
+   if (select->prepare() != success)
+   {
+      delete select;
+      return fail;
+   }
+
+   table->clear();
+   fromValue.setValue((long)from);
+   toValue.setValue((long)to);
+
+   for (int f = select->find(); f; f = select->fetch())
+   {
+      std::string line = "";
+
+      if (!gz && !(gz = openChunk(table, from, to, seq++, file)))
+      {
+         status = fail;
+         break;
+      }
+
+      for (int i = 0; i < table->fieldCount(); i++)
+      {
+         cDbFieldDef* def = table->getField(i);
+         cDbValue* value = table->getValue(def);
+         char num[50];
+
+         if (i)
+            line += "\t";
+
+         if (value->isNull())
+         {
+            line += "\\N";
+            continue;
+         }
+
+         switch (def->getFormat())
+         {
+            case cDBS::ffInt:
+            case cDBS::ffUInt:     sprintf(num, "%ld", value->getIntValue());                  break;
+            case cDBS::ffBigInt:
+            case cDBS::ffUBigInt:  sprintf(num, "%lld", (long long)value->getBigintValue());   break;
+            case cDBS::ffFloat:    sprintf(num, "%.10g", value->getFloatValue());               break;
+            case cDBS::ffDateTime: sprintf(num, "%ld", (long)value->getTimeValue());            break;
+
+            default:
+            {
+               escape(line, value->getStrValue(), value->getStrValueSize());
+               continue;
+            }
+         }
+
+         line += num;
+      }
+
+      line += "\n";
+
+      if (gzputs(gz, line.c_str()) < 0)
+      {
+         tell(eloAlways, "Error: Writing export file '%s' failed", file);
+         status = fail;
+         break;
+      }
+
+      rows++;
+
+      if (++count >= chunkRows)
+      {
+         status = closeChunk(gz, file, yes);
+         gz = 0;
+
+         if (status != success)
+            break;
+
+         count = 0;
+         files++;
+      }
+   }
+
+   select->freeResult();
+
+   if (!connection->isConnected())
+      status = fail;
+
+   if (gz)
+   {
+      // an empty chunk is dropped, an incomplete one too, on any error the
+      // export fails and the watermark stays
+
+      int keep = status == success && count > 0;
+
+      if (closeChunk(gz, file, keep) != success)
+         status = fail;
+      else if (keep)
+         files++;
+   }
+
+   free(file);
+   delete select;
+
+   return status;
+}
+
+gzFile cExport::openChunk(cDbTable* table, time_t from, time_t to, int seq, char*& file)
+{
+   std::string columns = "";
+   char* tmp;
+   gzFile gz;
+
+   free(file);
+   asprintf(&file, "%s/%s-%010ld-%04d.p4x.gz", path, table->TableName(), (long)to, seq);
+   asprintf(&tmp, "%s.tmp", file);
+
+   if (!(gz = gzopen(tmp, "wb6")))
+   {
+      tell(eloAlways, "Error: Can't create export file '%s', %s", tmp, strerror(errno));
+      free(tmp);
+      return 0;
+   }
+
+   free(tmp);
+
+   for (int i = 0; i < table->fieldCount(); i++)
+   {
+      columns += i ? " " : "";
+      columns += table->getField(i)->getDbName();
+      columns += std::string(":") + cDBS::dictFormats[table->getField(i)->getFormat()];
+   }
+
+   gzprintf(gz, "#p4x 1\n");
+   gzprintf(gz, "table %s\n", table->TableName());
+   gzprintf(gz, "fingerprint %s\n", dbDict.fingerprint().c_str());
+   gzprintf(gz, "range %ld %ld\n", (long)from, (long)to);
+   gzprintf(gz, "columns %s\n", columns.c_str());
+   gzprintf(gz, "data\n");
+
+   return gz;
+}
+
+int cExport::closeChunk(gzFile gz, char* file, int keep)
+{
+   char* tmp;
+   int status = success;
+
+   asprintf(&tmp, "%s.tmp", file);
+
+   if (gzclose(gz) != Z_OK)
+      status = fail;
+
+   if (status == success && keep)
+   {
+      if (rename(tmp, file) != 0)
+      {
+         status = fail;
+         unlink(tmp);
+      }
+      else
+         tell(eloDetail, "Wrote '%s'", file);
+   }
+   else
+      unlink(tmp);
+
+   if (status != success)
+      tell(eloAlways, "Error: Writing export file '%s' failed", file);
+
+   free(tmp);
+
+   return status;
+}
+
+//***************************************************************************
+// Import Files
+//***************************************************************************
+
+int cExport::importFiles()
+{
+   std::vector<std::string> files;
+   struct dirent* entry;
+   DIR* dir;
+   double start = usNow();
+   long rows = 0;
+
+   if (!(dir = opendir(path)))
+   {
+      tell(eloAlways, "Error: Can't open directory '%s', %s", path, strerror(errno));
+      return fail;
+   }
+
+   while ((entry = readdir(dir)))
+   {
+      const char* sfx = strstr(entry->d_name, ".p4x.gz");
+
+      if (sfx && !sfx[7])
+         files.push_back(entry->d_name);
+   }
+
+   closedir(dir);
+
+   // name is <table>-<to>-<seq>, sorted the newer rows replace the older
+
+   std::sort(files.begin(), files.end());
+
+   if (connect() != success)
+      return fail;
+
+   for (uint i = 0; i < files.size(); i++)
+   {
+      char* file;
+
+      asprintf(&file, "%s/%s", path, files[i].c_str());
+      int status = importFile(file, rows);
+      free(file);
+
+      if (status != success)
+      {
+         disconnect();
+         return fail;
+      }
+   }
+
+   disconnect();
+
+   tell(eloAlways, "Imported %ld rows of %d files in %.2f seconds",
+        rows, (int)files.size(), (usNow() - start) / 1000000);
+
+   return success;
+}
+
+//***************************************************************************
+// Import File
+//***************************************************************************
+
+int cExport::importFile(const char* file, long& rows)
+{
+   std::vector<cDbFieldDef*> fields;         // field of each column, 0 if unknown
+   std::string line;
+   std::string columns = "";
+   std::string values = "";
+   cDbTable* table = 0;
+   int status = success;
+   int count = 0;
+   gzFile gz;
+
+   if (!(gz = gzopen(file, "rb")))
+   {
+      tell(eloAlways, "Error: Can't open '%s', %s", file, strerror(errno));
+      return fail;
+   }
+
+   if (readLine(gz, line) != success || line != "#p4x 1")
+   {
+      tell(eloAlways, "Error: '%s' is not a p4d export file", file);
+      gzclose(gz);
+      return fail;
+   }
+
+   // header
+
+   while (status == success && readLine(gz, line) == success && line != "data")
+   {
+      if (line.compare(0, 6, "table ") == 0)
+      {
+         table = new cDbTable(connection, line.substr(6).c_str());
+
+         if (table->open() != success)
+            status = fail;
+      }
+      else if (line.compare(0, 12, "fingerprint ") == 0)
+      {
+         if (line.substr(12) != dbDict.fingerprint())
+            tell(eloAlways, "Info: '%s' was written with another dictionary, "
+                 "importing the known columns", file);
+      }
+      else if (line.compare(0, 8, "columns ") == 0 && table)
+      {
+         char* buf = strdup(line.substr(8).c_str());
+         char* save = 0;
+
+         for (char* c = strtok_r(buf, " ", &save); c; c = strtok_r(0, " ", &save))
+         {
+            char* p = strchr(c, ':');
+            cDbFieldDef* def;
+
+            if (p) *p = 0;
+
+            if ((def = table->getRow()->getFieldByDbName(c)))
+            {
+               columns += std::string(columns.length() ? ", " : "") + def->getDbName();
+               fields.push_back(def);
+            }
+            else
+            {
+               tell(eloAlways, "Info: Skipping unknown column '%s' of '%s'", c, file);
+               fields.push_back(0);
+            }
+         }
+
+         free(buf);
+      }
+   }
+
+   if (status != success || !table || line != "data")
+   {
+      if (status == success)
+         tell(eloAlways, "Error: Incomplete header in '%s'", file);
+
+      delete table;
+      gzclose(gz);
+      return fail;
+   }
+
+   // bulk load, the keys are rebuilt once at the end (MyISAM only, a no-op
+   //   for InnoDB), the DDL commits implicitly so it's issued outside of the
+   //   transaction which makes the import of the file atomic
+
+   if (connection->hasFeature(cDbEngine::efDisableKeys))
+   {
+      connection->query("SET unique_checks = 0");
+      connection->query("alter table %s disable keys", table->TableName());
+   }
+
+   connection->startTransaction();
+
+   while (status == success && readLine(gz, line) == success)
+   {
+      if (line.empty())
+         continue;
+
+      char* buf = strdup(line.c_str());
+      char* p = buf;
+      std::string row = "";
+
+      for (uint i = 0; i < fields.size() && p; i++)
+      {
+         char* next = strchr(p, '\t');
+
+         if (next)
+            *next++ = 0;
+
+         if (fields[i])
+         {
+            row += row.length() ? ", " : "(";
+
+            if (strcmp(p, "\\N") == 0)
+               row += "null";
+
+            else
+            {
+               char* v;
+               int size = unescape(p);
+
+               switch (fields[i]->getFormat())
+               {
+                  case cDBS::ffInt:
+                  case cDBS::ffUInt:      asprintf(&v, "%ld", atol(p));                  break;
+                  case cDBS::ffBigInt:
+                  case cDBS::ffUBigInt:   asprintf(&v, "%lld", atoll(p));                break;
+                  case cDBS::ffFloat:     asprintf(&v, "%.10g", atof(p));                break;
+                  case cDBS::ffDateTime:  asprintf(&v, "from_unixtime(%ld)", atol(p));   break;
+
+                  case cDBS::ffMlob:      v = strdup(hexLiteral(p, size).c_str());       break;
+
+                  default:
+                  {
+                     // a string with an embedded '\0' is cut by the quoting,
+                     //   it's inserted by its bytes like a blob
+
+                     if (memchr(p, 0, size))
+                        v = strdup(hexLiteral(p, size).c_str());
+                     else
+                        asprintf(&v, "'%s'", connection->escapeSqlString(p).c_str());
+                  }
+               }
+
+               row += v;
+               free(v);
+            }
+         }
+
+         p = next;
+      }
+
+      free(buf);
+
+      if (!row.length())
+         continue;
+
+      values += std::string(values.length() ? ", " : "") + row + ")";
+
+      if (++count >= insertRows)
+      {
+         status = flushInsert(table, columns, values, count);
+         rows += count;
+         count = 0;
+      }
+   }
+
+   if (status == success && count)
+   {
+      status = flushInsert(table, columns, values, count);
+      rows += count;
+   }
+
+   if (status == success)
+      connection->commit();
+   else
+      connection->rollback();
+
+   if (connection->hasFeature(cDbEngine::efDisableKeys))
+   {
+      connection->query("alter table %s enable keys", table->TableName());
+      connection->query("SET unique_checks = 1");
+   }
+
+   tell(eloDetail, "Imported '%s'", file);
+
+   delete table;
+   gzclose(gz);
+
+   return status;
+}
+
+//***************************************************************************
+// Flush Insert
+//   - one multi-row statement, existing rows are replaced
+//***************************************************************************
+
+int cExport::flushInsert(cDbTable* table, std::string& columns, std::string& values, int count)
+{
+   std::string stmt = "replace into " + std::string(table->TableName())
+      + " (" + columns + ") values " + values;
+
+   values = "";
+
+   if (connection->query("%s", stmt.c_str()) != success)
+   {
+      tell(eloAlways, "Error: Importing %d rows into '%s' failed", count, table->TableName());
+      return fail;
+   }
+
+   return success;
+}
@@ -0,0 +1,78 @@
+//***************************************************************************
+// p4d / Linux - Heizungs Manager
+// File export.h
+// This code is distributed under the terms and conditions of the
+// GNU GENERAL PUBLIC LICENSE. See the file LICENSE for details.
+// Date 19.10.2026  Jörg Wendel
+//***************************************************************************
+
+#ifndef _EXPORT_H_
+#define _EXPORT_H_
+
+#include <zlib.h>
+
+#include <string>
+#include <vector>
+
+#include "lib/db.h"
+
+//***************************************************************************
+// Class Export
+//   - incremental export of the rows changed (UPDSP) since the last export
+//     to gzip compressed chunk files, each starting with a header which
+//     describes table, columns and range:
+//
+//       #p4x 1
+//       table <name>
+//       fingerprint <dictionary fingerprint>
+//       range <from> <to>
+//       columns <dbname>:<format> ...
+//       data
+//       <one row per line, tab separated, \N for NULL>
+//
+//   - import of these files with multi-row 'replace into' statements
+//***************************************************************************
+
+class cExport
+{
+   public:
+
+      cExport(const char* aPath, cDbConnectionPool* aPool);
+      ~cExport();
+
+      int exportTables();          // rows changed since the last export, moves the watermark
+      int importFiles();           // all chunk files of the directory in order of their creation
+
+      static int chunkRows;        // rows per file
+      static int insertRows;       // rows per insert statement on import
+
+   protected:
+
+      int connect();
+      void disconnect();
+
+      int exportTable(cDbTable* table, time_t from, time_t to, int& files, long& rows);
+      gzFile openChunk(cDbTable* table, time_t from, time_t to, int seq, char*& file);
+      int closeChunk(gzFile gz, char* file, int keep);
+      int importFile(const char* file, long& rows);
+      int flushInsert(cDbTable* table, std::string& columns, std::string& values, int count);
+
+      int readWatermark(time_t& watermark);
+      int writeWatermark(time_t watermark);
+
+      static void escape(std::string& out, const char* data, int size);
+      static int unescape(char* value);
+      static std::string hexLiteral(const char* data, int size);
+      static int readLine(gzFile gz, std::string& line);
+
+      char* path;
+      cDbConnectionPool* pool;
+      cDbConnectionPool::cPooled* pooled;
+      cDbConnection* connection;           // of 'pooled' while connected
+      cDbFieldDef updspDef;
+      cDbValue fromValue;
+      cDbValue toValue;
+};
+
+//***************************************************************************
+#endif // _EXPORT_H_
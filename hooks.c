@@ -0,0 +1,401 @@
+//***************************************************************************
+// p4d / Linux - Heizungs Manager
+// File hooks.c
+// This code is distributed under the terms and conditions of the
+// GNU GENERAL PUBLIC LICENSE. See the file LICENSE for details.
+// Date 19.10.2026  Jörg Wendel
+//***************************************************************************
+
+#include <spawn.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/wait.h>
+
+#include "hooks.h"
+
+extern char** environ;
+
+int cHookExecutor::maxWorkers = 2;
+int cHookExecutor::maxPending = 32;
+int cHookExecutor::timeout = 60;
+int cHookExecutor::maxOutput = 4096;
+
+//***************************************************************************
+// Object
+//***************************************************************************
+
+cHookExecutor::cHookExecutor()
+{
+   stopRequested = no;
+}
+
+cHookExecutor::~cHookExecutor()
+{
+   stop();
+}
+
+//***************************************************************************
+// Start / Stop
+//***************************************************************************
+
+int cHookExecutor::start()
+{
+   if (threads.size())
+      return done;
+
+   stopRequested = no;
+
+   for (int i = 0; i < max(maxWorkers, 1); i++)
+   {
+      pthread_t thread;
+
+      if (pthread_create(&thread, 0, threadFct, this) != 0)
+      {
+         tell(eloAlways, "Error: Starting hook thread failed, %s", strerror(errno));
+         break;
+      }
+
+      threads.push_back(thread);
+   }
+
+   tell(eloAlways, "Started %d hook threads", (int)threads.size());
+
+   return threads.size() ? success : fail;
+}
+
+//***************************************************************************
+// Stop
+//   - running scripts are waited for (up to 'timeout'), queued ones dropped
+//***************************************************************************
+
+void cHookExecutor::stop()
+{
+   if (!threads.size())
+      return;
+
+   mutex.Lock();
+
+   if (queue.size())
+      tell(eloAlways, "Warning: Dropping %d queued hooks", (int)queue.size());
+
+   queue.clear();
+   stopRequested = yes;
+   waitCond.Broadcast();
+   mutex.Unlock();
+
+   for (unsigned int i = 0; i < threads.size(); i++)
+      pthread_join(threads[i], 0);
+
+   threads.clear();
+}
+
+//***************************************************************************
+// Submit
+//***************************************************************************
+
+int cHookExecutor::submit(const Hook& hook)
+{
+   mutex.Lock();
+
+   // a queued after-update run isn't needed anymore, it gets the newer values
+
+   if (hook.kind == hkAfterUpdate)
+   {
+      for (unsigned int i = 0; i < queue.size(); i++)
+      {
+         if (queue[i].kind == hkAfterUpdate)
+         {
+            queue[i] = hook;
+            coalesced.inc();
+            mutex.Unlock();
+
+            tell(eloDetail, "Queued call of '%s' replaced by the newer one", hook.path.c_str());
+            return done;
+         }
+      }
+   }
+
+   if ((int)queue.size() >= maxPending)
+   {
+      mutex.Unlock();
+      dropped.inc();
+      tell(eloAlways, "Warning: Too many queued hooks, skipping '%s'", hook.path.c_str());
+      return fail;
+   }
+
+   queue.push_back(hook);
+   waitCond.Signal();
+   mutex.Unlock();
+
+   return success;
+}
+
+//***************************************************************************
+// Get Results
+//   - of the hooks with a WEBIF job
+//***************************************************************************
+
+int cHookExecutor::getResults(std::vector<Result>& list)
+{
+   mutex.Lock();
+   list.swap(results);
+   results.clear();
+   mutex.Unlock();
+
+   return list.size();
+}
+
+unsigned int cHookExecutor::pending()
+{
+   unsigned int count;
+
+   mutex.Lock();
+   count = queue.size();
+   mutex.Unlock();
+
+   return count;
+}
+
+//***************************************************************************
+// Thread
+//***************************************************************************
+
+void* cHookExecutor::threadFct(void* arg)
+{
+   ((cHookExecutor*)arg)->action();
+   return 0;
+}
+
+void cHookExecutor::action()
+{
+   mutex.Lock();
+
+   while (!stopRequested)
+   {
+      Hook hook;
+      Result result;
+
+      if (!queue.size())
+      {
+         waitCond.Wait(mutex);
+         continue;
+      }
+
+      hook = queue.front();
+      queue.pop_front();
+      mutex.Unlock();
+
+      run(&hook, &result);
+
+      if (result.timedOut)
+      {
+         timedOut.inc();
+         tell(eloAlways, "Warning: '%s' killed after %d seconds", hook.path.c_str(), timeout);
+      }
+      else if (result.status != 0)
+      {
+         failed.inc();
+         tell(eloAlways, "Called '%s', exit status was (%d)", hook.path.c_str(), result.status);
+      }
+      else
+      {
+         succeeded.inc();
+         tell(eloDetail, "Called '%s', exit status was (0)", hook.path.c_str());
+      }
+
+      mutex.Lock();
+
+      if (hook.jobId)
+         results.push_back(result);
+   }
+
+   mutex.Unlock();
+}
+
+//***************************************************************************
+// Run
+//   - by '/bin/sh -c' as system() did, the path may contain arguments
+//   - stdin is an unlinked temporary file, a script not reading it can't
+//     block us, close-on-exec for the spawns of the other workers
+//***************************************************************************
+
+int cHookExecutor::run(const Hook* hook, Result* result)
+{
+   posix_spawn_file_actions_t actions;
+   posix_spawnattr_t attr;
+   sigset_t mask;
+   std::vector<char*> envp;
+   const char* argv[] = { "sh", "-c", hook->path.c_str(), 0 };
+   int in = na;
+   int out[2];
+   pid_t pid;
+   int status;
+
+   result->jobId = hook->jobId;
+   result->status = na;
+   result->timedOut = no;
+   result->output = "";
+
+   if (hook->input.length())
+   {
+      char tmp[] = "/tmp/p4d-hook-XXXXXX";
+
+      if ((in = mkostemp(tmp, O_CLOEXEC)) < 0)
+         tell(eloAlways, "Error: Creating input file for '%s' failed, %s", hook->path.c_str(), strerror(errno));
+      else
+      {
+         unlink(tmp);
+
+         if (write(in, hook->input.c_str(), hook->input.length()) != (ssize_t)hook->input.length())
+            tell(eloAlways, "Error: Writing input of '%s' failed, %s", hook->path.c_str(), strerror(errno));
+
+         lseek(in, 0, SEEK_SET);
+      }
+   }
+
+   if (pipe2(out, O_CLOEXEC) < 0)
+   {
+      tell(eloAlways, "Error: Creating pipe for '%s' failed, %s", hook->path.c_str(), strerror(errno));
+
+      if (in >= 0)
+         close(in);
+
+      return fail;
+   }
+
+   // the values first, they hide variables of the same name
+
+   for (unsigned int i = 0; i < hook->env.size(); i++)
+      envp.push_back((char*)hook->env[i].c_str());
+
+   for (char** e = environ; *e; e++)
+      envp.push_back(*e);
+
+   envp.push_back(0);
+
+   posix_spawn_file_actions_init(&actions);
+
+   if (in >= 0)
+      posix_spawn_file_actions_adddup2(&actions, in, STDIN_FILENO);
+   else
+      posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, "/dev/null", O_RDONLY, 0);
+
+   posix_spawn_file_actions_adddup2(&actions, out[1], STDOUT_FILENO);
+   posix_spawn_file_actions_adddup2(&actions, out[1], STDERR_FILENO);
+
+   // own process group to kill the children of the script too
+
+   sigemptyset(&mask);
+   posix_spawnattr_init(&attr);
+   posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETPGROUP | POSIX_SPAWN_SETSIGMASK);
+   posix_spawnattr_setpgroup(&attr, 0);
+   posix_spawnattr_setsigmask(&attr, &mask);
+
+   status = posix_spawn(&pid, "/bin/sh", &actions, &attr, (char* const*)argv, &envp[0]);
+
+   posix_spawnattr_destroy(&attr);
+   posix_spawn_file_actions_destroy(&actions);
+   close(out[1]);
+
+   if (in >= 0)
+      close(in);
+
+   if (status != 0)
+   {
+      tell(eloAlways, "Error: Calling '%s' failed, %s", hook->path.c_str(), strerror(status));
+      close(out[0]);
+      return fail;
+   }
+
+   tell(eloDetail, "Calling '%s' (pid %d)", hook->path.c_str(), pid);
+
+   status = collect(pid, out[0], result);
+   close(out[0]);
+
+   return status;
+}
+
+//***************************************************************************
+// Collect
+//   - read the output until the script exits, the output of processes it
+//     left in background isn't waited for
+//***************************************************************************
+
+static int readOutput(int fd, std::string& output)
+{
+   char buf[1024];
+   int n;
+
+   while ((n = read(fd, buf, sizeof(buf))) > 0)
+   {
+      if ((int)output.length() < cHookExecutor::maxOutput)
+         output.append(buf, min(n, cHookExecutor::maxOutput - (int)output.length()));
+   }
+
+   return n == 0 ? done : success;     // done -> all writers closed the pipe
+}
+
+int cHookExecutor::collect(int pid, int fd, Result* result)
+{
+   uint64_t end = cTimeMs::Now() + timeout * 1000;
+   int eof = no;
+   int status = 0;
+
+   fcntl(fd, F_SETFL, O_NONBLOCK);
+
+   while (true)
+   {
+      if (!eof)
+      {
+         struct pollfd pfd = { fd, POLLIN, 0 };
+
+         if (::poll(&pfd, 1, 100) > 0)
+            eof = readOutput(fd, result->output) == done;
+      }
+      else
+      {
+         usleep(10000);
+      }
+
+      if (waitpid(pid, &status, WNOHANG) == pid)
+         break;
+
+      if (cTimeMs::Now() > end)
+      {
+         // SIGTERM, after 2 seconds SIGKILL
+
+         int reaped = no;
+
+         kill(-pid, SIGTERM);
+
+         for (int i = 0; i < 20 && !reaped; i++)
+         {
+            if (!(reaped = waitpid(pid, &status, WNOHANG) == pid))
+               usleep(100000);
+         }
+
+         if (!reaped)
+         {
+            kill(-pid, SIGKILL);
+            waitpid(pid, &status, 0);
+         }
+
+         result->timedOut = yes;
+         break;
+      }
+   }
+
+   if (!eof)
+      readOutput(fd, result->output);
+
+   // trailing newlines
+
+   while (result->output.length() && isspace(result->output[result->output.length()-1]))
+      result->output.erase(result->output.length()-1);
+
+   if (!result->timedOut && WIFEXITED(status))
+      result->status = WEXITSTATUS(status);
+
+   return result->timedOut ? fail : success;
+}
@@ -0,0 +1,95 @@
+//***************************************************************************
+// p4d / Linux - Heizungs Manager
+// File hooks.h
+// This code is distributed under the terms and conditions of the
+// GNU GENERAL PUBLIC LICENSE. See the file LICENSE for details.
+// Date 19.10.2026  Jörg Wendel
+//***************************************************************************
+
+#ifndef _HOOKS_H_
+#define _HOOKS_H_
+
+#include <pthread.h>
+
+#include <string>
+#include <vector>
+#include <deque>
+
+#include "lib/common.h"
+
+//***************************************************************************
+// Class Hook Executor
+//   - runs the after-update script and the scripts of the WEBIF by
+//     posix_spawn in up to 'maxWorkers' threads, a script running longer
+//     than 'timeout' seconds is killed with its process group
+//   - a queued after-update run is replaced by a newer one (coalesced),
+//     the current values are passed by the environment and stdin
+//   - the output of the WEBIF scripts is kept for the result of the job,
+//     the owner fetches the finished ones by getResults()
+//***************************************************************************
+
+class cHookExecutor
+{
+   public:
+
+      enum Kind
+      {
+         hkAfterUpdate,
+         hkScript
+      };
+
+      struct Hook
+      {
+         int kind;
+         std::string path;
+         std::vector<std::string> env;       // "NAME=value", added to the environment
+         std::string input;                  // to stdin
+         long jobId;                         // WEBIF job, 0 -> none
+      };
+
+      struct Result
+      {
+         long jobId;
+         int status;                         // exit status, na if killed or not started
+         int timedOut;
+         std::string output;                 // stdout and stderr, up to 'maxOutput' bytes
+      };
+
+      cHookExecutor();
+      ~cHookExecutor();
+
+      int start();
+      void stop();
+
+      int submit(const Hook& hook);
+      int getResults(std::vector<Result>& list);
+      unsigned int pending();
+
+      static int maxWorkers;
+      static int maxPending;
+      static int timeout;                    // [s]
+      static int maxOutput;                  // [bytes]
+
+      cCounter succeeded;
+      cCounter failed;
+      cCounter timedOut;
+      cCounter coalesced;
+      cCounter dropped;
+
+   protected:
+
+      static void* threadFct(void* arg);
+      void action();
+      int run(const Hook* hook, Result* result);
+      int collect(int pid, int fd, Result* result);
+
+      std::deque<Hook> queue;
+      std::vector<Result> results;
+      std::vector<pthread_t> threads;
+      int stopRequested;
+      cMyMutex mutex;
+      cCondVar waitCond;
+};
+
+//***************************************************************************
+#endif // _HOOKS_H_
@@ -449,6 +449,62 @@ function prettyUnit($u)
    return $unit;
 }
 
+// ---------------------------------------------------------------------------
+// Read Value Cache
+//   latest values published by p4d in shared memory (see valuecache.h),
+//   rows like the join of samples and valuefacts, false if not available
+// ---------------------------------------------------------------------------
+
+function readValueCache(&$time)
+{
+   $headerSize = 64;
+
+   if (!function_exists("shmop_open"))
+      return false;
+
+   if (!($shm = @shmop_open(0x50344456, "a", 0, 0)))
+      return false;
+
+   for ($try = 0; $try < 100; $try++)
+   {
+      $head = unpack("a4magic/Llayout/Lsequence/Lcount/qtime/Lcapacity/LrecordSize", shmop_read($shm, 0, 32));
+
+      if ($head['magic'] != "P4VC" || $head['layout'] != 1 || $head['count'] == 0)
+         return false;
+
+      if ($head['sequence'] % 2)       // p4d is writing
+      {
+         usleep(100);
+         continue;
+      }
+
+      $data = shmop_read($shm, $headerSize, $head['count'] * $head['recordSize']);
+      $check = unpack("Lsequence", shmop_read($shm, 8, 4));
+
+      if ($check['sequence'] == $head['sequence'])
+         break;
+   }
+
+   if ($try >= 100)
+      return false;
+
+   $values = array();
+   $time = date("Y-m-d H:i:s", $head['time']);
+
+   for ($i = 0; $i < $head['count']; $i++)
+   {
+      $v = unpack("laddress/Z4type/dvalue/Z16unit/Z104text/Z104title/Z104usrtitle",
+                  substr($data, $i * $head['recordSize'], $head['recordSize']));
+
+      $values[$v['type'] . ":" . $v['address']] = array(
+         's_address' => $v['address'], 's_type' => $v['type'],
+         's_time' => $time, 's_value' => sprintf("%.2f", $v['value']), 's_text' => $v['text'],
+         'f_unit' => $v['unit'], 'f_title' => $v['title'], 'f_usrtitle' => $v['usrtitle']);
+   }
+
+   return $values;
+}
+
 }  // "functions_once"
 
 ?>
@@ -26,11 +26,18 @@ printHeader(60);
   $mysqli->query("SET lc_time_names = 'de_DE'");
 
   // -------------------------
-  // get last time stamp
+  // get last time stamp, from the value cache of p4d if available
 
-  $result = $mysqli->query("select max(time), DATE_FORMAT(max(time),'%d. %M %Y   %H:%i') as maxPretty, " .
-                        "DATE_FORMAT(max(time),'%H:%i:%S') as maxPrettyShort from samples;")
-     or die("Error" . $mysqli->error);
+  $valueCache = readValueCache($cacheTime);
+
+  if ($valueCache !== false)
+     $result = $mysqli->query("select '$cacheTime' as 'max(time)', DATE_FORMAT('$cacheTime','%d. %M %Y   %H:%i') as maxPretty, " .
+                              "DATE_FORMAT('$cacheTime','%H:%i:%S') as maxPrettyShort;")
+        or die("Error" . $mysqli->error);
+  else
+     $result = $mysqli->query("select max(time), DATE_FORMAT(max(time),'%d. %M %Y   %H:%i') as maxPretty, " .
+                              "DATE_FORMAT(max(time),'%H:%i:%S') as maxPrettyShort from samples;")
+        or die("Error" . $mysqli->error);
   $row = $result->fetch_assoc();
   $max = $row['max(time)'];
   $maxPretty = $row['maxPretty'];
@@ -183,23 +190,38 @@ printHeader(60);
   // Sensor List
   {
      $addresses = !isMobile() ? $_SESSION['addrsMain'] : $_SESSION['addrsMainMobile'];
+     $rows = array();
+
+     if ($valueCache !== false)
+     {
+        $addrList = explode(",", str_replace(" ", "", $addresses));
 
-     if ($addresses == "")
-        $strQuery = sprintf("select s.address as s_address, s.type as s_type, s.time as s_time, s.value as s_value, s.text as s_text, f.usrtitle as f_usrtitle, f.title as f_title, f.unit as f_unit
-                from samples s, valuefacts f where f.state = 'A' and f.address = s.address and f.type = s.type and s.time = '%s';", $max);
+        foreach ($valueCache as $v)
+           if ($addresses == "" || ($v['s_type'] == 'VA' && in_array($v['s_address'], $addrList)))
+              $rows[] = $v;
+     }
      else
-        $strQuery = sprintf("select s.address as s_address, s.type as s_type, s.time as s_time, s.value as s_value, s.text as s_text, f.usrtitle as f_usrtitle, f.title as f_title, f.unit as f_unit
-                from samples s, valuefacts f where f.state = 'A' and f.address = s.address and f.type = s.type and s.address in (%s) and s.type = 'VA' and s.time = '%s';", $addresses, $max);
+     {
+        if ($addresses == "")
+           $strQuery = sprintf("select s.address as s_address, s.type as s_type, s.time as s_time, s.value as s_value, s.text as s_text, f.usrtitle as f_usrtitle, f.title as f_title, f.unit as f_unit
+                   from samples s, valuefacts f where f.state = 'A' and f.address = s.address and f.type = s.type and s.time = '%s';", $max);
+        else
+           $strQuery = sprintf("select s.address as s_address, s.type as s_type, s.time as s_time, s.value as s_value, s.text as s_text, f.usrtitle as f_usrtitle, f.title as f_title, f.unit as f_unit
+                   from samples s, valuefacts f where f.state = 'A' and f.address = s.address and f.type = s.type and s.address in (%s) and s.type = 'VA' and s.time = '%s';", $addresses, $max);
 
-     // syslog(LOG_DEBUG, "p4: selecting " . " '" . $strQuery . "'");
+        // syslog(LOG_DEBUG, "p4: selecting " . " '" . $strQuery . "'");
 
-     $result = $mysqli->query($strQuery)
-        or die("Error" . $mysqli->error);
+        $result = $mysqli->query($strQuery)
+           or die("Error" . $mysqli->error);
+
+        while ($row = $result->fetch_assoc())
+           $rows[] = $row;
+     }
 
      echo "      <div class=\"rounded-border table2Col\">\n";
      echo "        <center>Messwerte vom $maxPretty</center>\n";
 
-     while ($row = $result->fetch_assoc())
+     foreach ($rows as $row)
      {
         $value = $row['s_value'];
         $text = $row['s_text'];
@@ -17,6 +17,12 @@ $pumpsVA = "|," . $_SESSION['pumpsVA'] . ",";   // Workaround damit die IDs erka
 $pumpsDO = "|," . $_SESSION['pumpsDO'] . ",";
 $pumpsAO = "|," . $_SESSION['pumpsAO'] . ",";
 
+// -------------------------
+// latest values from the value cache of p4d if available
+
+if (!isset($valueCache))
+   $valueCache = readValueCache($cacheTime);
+
 // -------------------------
 // show values
 
@@ -33,11 +39,20 @@ while ($rowConf = $resultConf->fetch_assoc())
    $showUnit = $rowConf['showunit'];
    $showText = $rowConf['showtext'];
 
-   $strQuery = sprintf("select s.value as s_value, s.text as s_text, f.title as f_title, f.usrtitle as f_usrtitle, f.unit as f_unit from samples s, valuefacts f where f.address = s.address and f.type = s.type and s.time = '%s' and f.address = %s and f.type = '%s';", $max, $addr, $type);
-   $result = $mysqli->query($strQuery)
-      or die("Error" . $mysqli->error);
+   if ($valueCache !== false)
+   {
+      $row = isset($valueCache["$type:$addr"]) ? $valueCache["$type:$addr"] : false;
+   }
+   else
+   {
+      $strQuery = sprintf("select s.value as s_value, s.text as s_text, f.title as f_title, f.usrtitle as f_usrtitle, f.unit as f_unit from samples s, valuefacts f where f.address = s.address and f.type = s.type and s.time = '%s' and f.address = %s and f.type = '%s';", $max, $addr, $type);
+      $result = $mysqli->query($strQuery)
+         or die("Error" . $mysqli->error);
+
+      $row = $result->fetch_assoc();
+   }
 
-   if ($row = $result->fetch_assoc())
+   if ($row)
    {
       $urlStart = "          <a class=\"schemaValue\">";
       $urlEnd   = "</a>\n";
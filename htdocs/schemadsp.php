@@ -12,10 +12,16 @@
   $mysqli->query("SET lc_time_names = 'de_DE'");
 
   // -------------------------
-  // get last time stamp
+  // get last time stamp, from the value cache of p4d if available
 
-  $result = $mysqli->query("select max(time), DATE_FORMAT(max(time),'%d. %M %Y   %H:%i') as maxPretty from samples;")
-     or die("Error" . $mysqli->error);
+  $valueCache = readValueCache($cacheTime);
+
+  if ($valueCache !== false)
+     $result = $mysqli->query("select '$cacheTime' as 'max(time)', DATE_FORMAT('$cacheTime','%d. %M %Y   %H:%i') as maxPretty;")
+        or die("Error" . $mysqli->error);
+  else
+     $result = $mysqli->query("select max(time), DATE_FORMAT(max(time),'%d. %M %Y   %H:%i') as maxPretty from samples;")
+        or die("Error" . $mysqli->error);
 
   $row = $result->fetch_assoc();
   $max = $row['max(time)'];
@@ -7,6 +7,7 @@
 
 #include <sys/stat.h>
 #include <sys/time.h>
+#include <sys/eventfd.h>
 
 #include <stdarg.h>
 #include <stdio.h>
@@ -44,6 +45,30 @@ void tell(int eloquence, const char* format, ...)
    char t[sizeBuffer+100]; *t = 0;
    va_list ap;
 
+   if (asyncLog.isActive())
+   {
+      timeval tp;
+      int status;
+
+      va_start(ap, format);
+      status = asyncLog.push(format, ap);
+      va_end(ap);
+
+      if (status == success)
+         return;
+
+      // too long for a record
+
+      gettimeofday(&tp, 0);
+      va_start(ap, format);
+      vsnprintf(t, sizeBuffer, format, ap);
+      va_end(ap);
+
+      asyncLog.output(&tp, t);
+
+      return;
+   }
+
 #ifdef VDR_PLUGIN
    cMutexLock lock(&logMutex);
 #endif
@@ -82,6 +107,303 @@ void tell(int eloquence, const char* format, ...)
    va_end(ap);
 }
 
+//***************************************************************************
+// Async Log
+//***************************************************************************
+
+cAsyncLog asyncLog;
+
+cAsyncLog::cAsyncLog()
+{
+   ring = 0;
+   enqueuePos = 0;
+   dequeuePos = 0;
+   dropped = 0;
+   droppedReported = 0;
+   active = no;
+   stopRequested = no;
+   waiting = no;
+   eventFd = na;
+   file = 0;
+   maxFileSize = 0;
+   fileSize = 0;
+   fp = 0;
+}
+
+cAsyncLog::~cAsyncLog()
+{
+   stop();
+}
+
+int cAsyncLog::start(const char* aFile, long aMaxFileSize)
+{
+   if (active)
+      return done;
+
+   if ((eventFd = eventfd(0, EFD_CLOEXEC)) < 0)
+   {
+      tell(eloAlways, "Error: Creating eventfd for the log thread failed, %s", strerror(errno));
+      return fail;
+   }
+
+   ring = (Record*)calloc(records, sizeof(Record));
+
+   for (size_t i = 0; i < records; i++)
+      ring[i].sequence = i;
+
+   enqueuePos = dequeuePos = 0;
+   dropped = droppedReported = 0;
+   maxFileSize = aMaxFileSize;
+   file = !isEmpty(aFile) ? strdup(aFile) : 0;
+
+   if (file && openFile() != success)
+   {
+      free(file);
+      file = 0;
+   }
+
+   stopRequested = no;
+
+   if (pthread_create(&thread, 0, threadFct, this) != 0)
+   {
+      tell(eloAlways, "Error: Starting log thread failed, %s", strerror(errno));
+      free(ring);
+      ring = 0;
+      ::close(eventFd);
+      eventFd = na;
+      return fail;
+   }
+
+   active = yes;
+
+   return success;
+}
+
+void cAsyncLog::stop()
+{
+   if (!active)
+      return;
+
+   // new messages are written directly, the thread writes the pending ones
+
+   active = no;
+   stopRequested = yes;
+   wakeup();
+   pthread_join(thread, 0);
+
+   ::close(eventFd);
+   eventFd = na;
+
+   if (fp)
+      fclose(fp);
+
+   fp = 0;
+   free(file);
+   file = 0;
+   free(ring);
+   ring = 0;
+}
+
+//***************************************************************************
+// Push
+//   - bounded MPSC queue, a record is free for position 'pos' if its
+//     sequence is 'pos' and filled if it's 'pos+1'
+//***************************************************************************
+
+int cAsyncLog::push(const char* format, va_list ap)
+{
+   size_t pos = enqueuePos;
+   Record* record;
+   int len;
+
+   while (true)
+   {
+      record = &ring[pos & (records-1)];
+      long diff = (long)(record->sequence - pos);
+
+      if (diff == 0)
+      {
+         if (__sync_bool_compare_and_swap(&enqueuePos, pos, pos+1))
+            break;
+      }
+      else if (diff < 0)
+      {
+         __sync_fetch_and_add(&dropped, 1);      // full
+         return success;
+      }
+
+      pos = enqueuePos;
+   }
+
+   gettimeofday(&record->time, 0);
+
+   if ((len = vsnprintf(record->text, recordSize, format, ap)) >= recordSize)
+      *record->text = 0;                         // the caller writes it directly
+
+   __sync_synchronize();
+   record->sequence = pos + 1;
+
+   // the thread checks the ring again after it set 'waiting', one of both sees the other
+
+   __sync_synchronize();
+
+   if (waiting)
+      wakeup();
+
+   return len >= recordSize ? fail : success;
+}
+
+int cAsyncLog::wakeup()
+{
+   uint64_t one = 1;
+
+   return write(eventFd, &one, sizeof(one)) == sizeof(one) ? success : fail;
+}
+
+//***************************************************************************
+// Drain
+//***************************************************************************
+
+int cAsyncLog::drain()
+{
+   int count = 0;
+
+   while (true)
+   {
+      Record* record = &ring[dequeuePos & (records-1)];
+
+      if ((long)(record->sequence - (dequeuePos+1)) < 0)
+         break;
+
+      __sync_synchronize();
+
+      if (*record->text)
+         output(&record->time, record->text);
+
+      __sync_synchronize();
+      record->sequence = dequeuePos + records;
+      dequeuePos++;
+      count++;
+   }
+
+   if (dropped != droppedReported)
+   {
+      unsigned long now = dropped;
+      char msg[100];
+      timeval tp;
+
+      sprintf(msg, "Warning: %lu log messages dropped", now - droppedReported);
+      droppedReported = now;
+      gettimeofday(&tp, 0);
+      output(&tp, msg);
+   }
+
+   if (count && !fp && logstdout)
+      fflush(stdout);
+
+   return count;
+}
+
+//***************************************************************************
+// Thread
+//***************************************************************************
+
+void* cAsyncLog::threadFct(void* arg)
+{
+   ((cAsyncLog*)arg)->action();
+   return 0;
+}
+
+void cAsyncLog::action()
+{
+   while (!stopRequested)
+   {
+      uint64_t value;
+
+      if (drain())
+         continue;
+
+      waiting = yes;
+      __sync_synchronize();
+
+      if (!drain() && !stopRequested)
+         read(eventFd, &value, sizeof(value));   // blocks until push() or stop() wakes us
+
+      waiting = no;
+   }
+
+   drain();
+}
+
+//***************************************************************************
+// Output
+//***************************************************************************
+
+int cAsyncLog::openFile()
+{
+   if (!(fp = fopen(file, "a")))
+   {
+      syslog(LOG_ERR, "Error: Can't open log file '%s', %s", file, strerror(errno));
+      return fail;
+   }
+
+   fileSize = ftell(fp);
+
+   return success;
+}
+
+void cAsyncLog::output(const timeval* time, const char* text)
+{
+   outputMutex.Lock();
+
+   if (fp)
+   {
+      char stamp[50+TB];
+      tm tm;
+
+      localtime_r(&time->tv_sec, &tm);
+      strftime(stamp, 50, "%Y-%m-%d %H:%M:%S", &tm);
+
+      fileSize += fprintf(fp, "%s,%3.3ld %s\n", stamp, (long)time->tv_usec / 1000, text);
+
+      // rotate, keep one old file
+
+      if (maxFileSize > 0 && fileSize > maxFileSize)
+      {
+         char* old;
+
+         asprintf(&old, "%s.1", file);
+         fclose(fp);
+         rename(file, old);
+         free(old);
+
+         if (openFile() != success)
+            fp = 0;
+      }
+      else if (!active || dequeuePos == enqueuePos)
+         fflush(fp);
+   }
+   else if (logstdout)
+   {
+      char buf[50+TB];
+      *buf = 0;
+
+      if (logstamp)
+      {
+         tm tm;
+
+         localtime_r(&time->tv_sec, &tm);
+         sprintf(buf, "%2.2d:%2.2d:%2.2d,%3.3ld ", tm.tm_hour, tm.tm_min, tm.tm_sec, (long)time->tv_usec / 1000);
+      }
+
+      printf("%s%s\n", buf, text);
+   }
+   else
+      syslog(LOG_ERR, "%s", text);
+
+   outputMutex.Unlock();
+}
+
 //***************************************************************************
 // Save Realloc
 //***************************************************************************
@@ -984,6 +1306,75 @@ void cMyMutex::Unlock(void)
     pthread_mutex_unlock(&mutex);
 }
 
+//***************************************************************************
+// cCondVar
+//***************************************************************************
+
+cCondVar::cCondVar()
+{
+   pthread_cond_init(&cond, 0);
+}
+
+cCondVar::~cCondVar()
+{
+   pthread_cond_broadcast(&cond);   // wake up any sleepers
+   pthread_cond_destroy(&cond);
+}
+
+void cCondVar::Wait(cMyMutex& mutex)
+{
+   int locked = mutex.locked;
+
+   // the mutex is released while waiting, restore the lock count afterwards
+
+   if (locked)
+      mutex.locked = 0;
+
+   pthread_cond_wait(&cond, &mutex.mutex);
+
+   if (locked)
+      mutex.locked = locked;
+}
+
+int cCondVar::TimedWait(cMyMutex& mutex, int timeoutMs)
+{
+   int signaled = yes;
+   struct timespec abstime;
+   int locked = mutex.locked;
+
+   clock_gettime(CLOCK_REALTIME, &abstime);
+
+   abstime.tv_sec += timeoutMs / 1000;
+   abstime.tv_nsec += (timeoutMs % 1000) * 1000000;
+
+   if (abstime.tv_nsec >= 1000000000)
+   {
+      abstime.tv_sec++;
+      abstime.tv_nsec -= 1000000000;
+   }
+
+   if (locked)
+      mutex.locked = 0;
+
+   if (pthread_cond_timedwait(&cond, &mutex.mutex, &abstime) == ETIMEDOUT)
+      signaled = no;
+
+   if (locked)
+      mutex.locked = locked;
+
+   return signaled;
+}
+
+void cCondVar::Broadcast()
+{
+   pthread_cond_broadcast(&cond);
+}
+
+void cCondVar::Signal()
+{
+   pthread_cond_signal(&cond);
+}
+
 
 //***************************************************************************
 // cTimeMs 
@@ -13,6 +13,10 @@
 #include <iconv.h>
 #include <errno.h>
 #include <string.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <sys/time.h>
 
 #include <string>
 #include <map>
@@ -75,6 +79,16 @@ enum Eloquence
 
 void __attribute__ ((format(printf, 2, 3))) tell(int eloquence, const char* format, ...);
 
+// level check before the call, with a constant eloquence above MAX_ELOQUENCE
+// (-DMAX_ELOQUENCE=n) the compiler removes the trace completely
+
+#ifndef MAX_ELOQUENCE
+#  define MAX_ELOQUENCE eloDebug3
+#endif
+
+#define TELL(eloquence, ...) \
+   do { if ((eloquence) <= MAX_ELOQUENCE && (eloquence) <= loglevel) tell(eloquence, __VA_ARGS__); } while (0)
+
 char* srealloc(void* ptr, size_t size);
 
 //***************************************************************************
@@ -191,6 +205,114 @@ class cMyMutex
       int locked;
 };
 
+//***************************************************************************
+// cCondVar
+//***************************************************************************
+
+class cCondVar
+{
+   public:
+
+      cCondVar();
+      ~cCondVar();
+      void Wait(cMyMutex& mutex);
+      int TimedWait(cMyMutex& mutex, int timeoutMs);   // yes if signaled, no on timeout
+      void Broadcast();
+      void Signal();
+
+   private:
+
+      pthread_cond_t cond;
+};
+
+//***************************************************************************
+// Counter
+//   - lock free, for statistics updated and read by several threads
+//***************************************************************************
+
+class cCounter
+{
+   public:
+
+      cCounter()                       { value = 0; }
+
+      void inc(uint64_t n = 1)         { __sync_fetch_and_add(&value, n); }
+      uint64_t get()                   { return __sync_fetch_and_add(&value, 0); }
+
+   private:
+
+      volatile uint64_t value;
+};
+
+//***************************************************************************
+// Async Log
+//   - tell() formats the message into a record of a lock free ring buffer
+//     (many writers, one reader), a thread writes the records to the file,
+//     stdout or syslog, the file is rotated at 'maxFileSize'
+//   - if the ring is full the message is dropped and counted, messages
+//     longer than a record are written directly
+//   - the thread sleeps on an eventfd while the ring is empty, the writer
+//     which finds it waiting wakes it up (write() is async signal safe)
+//***************************************************************************
+
+class cAsyncLog
+{
+   public:
+
+      enum Misc
+      {
+         records = 4096,             // power of 2
+         recordSize = 256
+      };
+
+      cAsyncLog();
+      ~cAsyncLog();
+
+      int start(const char* file = 0, long maxFileSize = 0);
+      void stop();
+      int isActive()                   { return active; }
+
+      int push(const char* format, va_list ap);    // fail -> too long, write it directly
+      void output(const timeval* time, const char* text);
+      unsigned long getDropped()       { return dropped; }
+      unsigned long getQueued()        { return active ? enqueuePos - dequeuePos : 0; }
+
+   protected:
+
+      struct Record
+      {
+         volatile size_t sequence;
+         timeval time;
+         char text[recordSize];
+      };
+
+      static void* threadFct(void* arg);
+      void action();
+      int wakeup();
+      int drain();
+      int openFile();
+
+      Record* ring;
+      volatile size_t enqueuePos;
+      size_t dequeuePos;
+      volatile unsigned long dropped;
+      unsigned long droppedReported;
+
+      pthread_t thread;
+      volatile int active;
+      volatile int stopRequested;
+      volatile int waiting;            // thread sleeps, the ring was empty
+      int eventFd;
+      cMyMutex outputMutex;
+
+      char* file;
+      long maxFileSize;
+      long fileSize;
+      FILE* fp;
+};
+
+extern cAsyncLog asyncLog;
+
 //***************************************************************************
 // Tools
 //***************************************************************************
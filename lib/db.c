@@ -6,9 +6,9 @@
  */
 
 #include <stdio.h>
-#include <errmsg.h>
 
 #include <map>
+#include <algorithm>
 
 #include "db.h"
 
@@ -17,6 +17,9 @@
 //***************************************************************************
 
 int cDbStatement::explain = no;
+int cDbStatement::prefetchRows = 100;
+cCounter cDbStatement::executions;
+cCounter cDbStatement::executeUs;
 
 cDbStatement::cDbStatement(cDbTable* aTable)
 {
@@ -29,10 +32,11 @@ cDbStatement::cDbStatement(cDbTable* aTable)
    inBind = 0;
    outBind = 0;
    affected = 0;
-   metaResult = 0;
    bindPrefix = 0;
    firstExec = yes;
    buildErrors = 0;
+   streaming = no;
+   streamRows = 0;
 
    callsPeriod = 0;
    callsTotal = 0;
@@ -53,7 +57,6 @@ cDbStatement::cDbStatement(cDbConnection* aConnection, const char* sText)
    inBind = 0;
    outBind = 0;
    affected = 0;
-   metaResult = 0;
    bindPrefix = 0;
    firstExec = yes;
 
@@ -61,6 +64,8 @@ cDbStatement::cDbStatement(cDbConnection* aConnection, const char* sText)
    callsTotal = 0;
    duration = 0;
    buildErrors = 0;
+   streaming = no;
+   streamRows = 0;
 
    if (connection)
       connection->statements.append(this);
@@ -82,7 +87,7 @@ int cDbStatement::execute(int noResult)
 {
    affected = 0;
 
-   if (!connection || !connection->getMySql())
+   if (!connection || !connection->isConnected())
       return fail;
 
    if (!stmt)
@@ -118,34 +123,52 @@ int cDbStatement::execute(int noResult)
 
    double start = usNow();
 
-   if (mysql_stmt_execute(stmt))
+   if (stmt->execute() != success)
       return connection->errorSql(connection, "execute(stmt_execute)", stmt, stmtTxt.c_str());
 
-   duration += usNow() - start;
+   double us = usNow() - start;
+
+   duration += us;
    callsPeriod++;
    callsTotal++;
+   executions.inc();
+   executeUs.inc((uint64_t)us);
 
    // out binding - if needed
 
-   if (outCount && !noResult)
+   if (outCount && !noResult && streaming)
+   {
+      // rows are delivered by the server side cursor in chunks of 'streamRows',
+      //   only fetch the first one - affected rows is unknown in this mode
+
+      int res = stmt->fetch();
+
+      if (res == fail)
+         return connection->errorSql(connection, "execute(stmt_fetch)", stmt, stmtTxt.c_str());
+
+      affected = res == yes ? 1 : 0;
+
+      return success;
+   }
+   else if (outCount && !noResult)
    {
-      if (mysql_stmt_store_result(stmt))
+      if (stmt->storeResult() != success)
          return connection->errorSql(connection, "execute(store_result)", stmt, stmtTxt.c_str());
 
       // fetch the first result - if any
 
-      if (mysql_stmt_affected_rows(stmt) > 0)
-         mysql_stmt_fetch(stmt);
+      if (stmt->affectedRows() > 0)
+         stmt->fetch();
    }
    else if (outCount)
    {
-      mysql_stmt_store_result(stmt);
+      stmt->storeResult();
    }
 
    // result was stored (above) only if output (outCound) is expected,
    // therefore we don't need to call freeResult() after insert() or update()
 
-   affected = mysql_stmt_affected_rows(stmt);
+   affected = stmt->affectedRows();
 
    return success;
 }
@@ -156,26 +179,15 @@ int cDbStatement::execute(int noResult)
 
 int cDbStatement::getLastInsertId()
 {
-   MYSQL_RES* result = 0;
-   int insertId = na;
-
-   if ((result = mysql_store_result(connection->getMySql())) == 0 &&
-       mysql_field_count(connection->getMySql()) == 0 &&
-       mysql_insert_id(connection->getMySql()) != 0)
-   {
-      insertId = mysql_insert_id(connection->getMySql());
-   }
-
-   mysql_free_result(result);
+   if (!connection->isConnected())
+      return na;
 
-   return insertId;
+   return connection->getEngine()->lastInsertId();
 }
 
 int cDbStatement::getResultCount()
 {
-   mysql_stmt_store_result(stmt);
-
-   return mysql_stmt_affected_rows(stmt);
+   return stmt ? stmt->resultCount() : 0;
 }
 
 int cDbStatement::find()
@@ -188,7 +200,7 @@ int cDbStatement::find()
 
 int cDbStatement::fetch()
 {
-   if (!mysql_stmt_fetch(stmt))
+   if (stmt && stmt->fetch() == yes)
       return yes;
 
    return no;
@@ -196,11 +208,29 @@ int cDbStatement::fetch()
 
 int cDbStatement::freeResult()
 {
-   if (metaResult)
-      mysql_free_result(metaResult);
+   if (stmt)
+      stmt->freeResult();
 
+   return success;
+}
+
+//***************************************************************************
+// Set Streaming
+//   - for large scans, the rows are read via a read-only server side cursor
+//     'rows' at a time instead of storing the whole result on client side.
+//     Other statements of the connection can be used while the cursor is open
+//***************************************************************************
+
+int cDbStatement::setStreaming(int rows)
+{
    if (stmt)
-      mysql_stmt_free_result(stmt);
+   {
+      tell(0, "Error: Streaming mode has to be set before prepare() [%s]", stmtTxt.c_str());
+      return fail;
+   }
+
+   streaming = yes;
+   streamRows = rows > 0 ? rows : prefetchRows;
 
    return success;
 }
@@ -447,8 +477,7 @@ void cDbStatement::clear()
 
    if (stmt)
    {
-      mysql_stmt_free_result(stmt);
-      mysql_stmt_close(stmt);
+      delete stmt;
       stmt = 0;
    }
 }
@@ -553,33 +582,21 @@ int cDbStatement::appendBinding(cDbValue* value, BindType bt)
 
 int cDbStatement::prepare()
 {
-   if (!stmtTxt.length() || !connection->getMySql())
+   if (!stmtTxt.length() || !connection->isConnected())
       return fail;
 
    if (buildErrors)
       return fail;
 
-   stmt = mysql_stmt_init(connection->getMySql());
+   stmt = connection->getEngine()->createStatement();
 
-   // prepare statement
+   // prepare statement, bind parameters and result
 
-   if (mysql_stmt_prepare(stmt, stmtTxt.c_str(), stmtTxt.length()))
+   if (stmt->prepare(stmtTxt.c_str(), inBind, inCount, outBind, outCount, streaming ? streamRows : 0) != success)
       return connection->errorSql(connection, "prepare(stmt_prepare)", stmt, stmtTxt.c_str());
 
-   if (outBind)
-   {
-      if (mysql_stmt_bind_result(stmt, outBind))
-         return connection->errorSql(connection, "execute(bind_result)", stmt);
-   }
-
-   if (inBind)
-   {
-      if (mysql_stmt_bind_param(stmt, inBind))
-         return connection->errorSql(connection, "buildPrimarySelect(bind_param)", stmt);
-   }
-
-   tell(2, "Statement '%s' with (%ld) in parameters and (%d) out bindings prepared",
-        stmtTxt.c_str(), mysql_stmt_param_count(stmt), outCount);
+   tell(2, "Statement '%s' with (%d) in parameters and (%d) out bindings prepared",
+        stmtTxt.c_str(), stmt->paramCount(), outCount);
 
    return success;
 }
@@ -612,6 +629,7 @@ char* cDbConnection::dbUser = 0;
 char* cDbConnection::dbPass = 0;
 char* cDbConnection::dbName = 0;
 int   cDbConnection::initThreads = 0;
+int   cDbConnection::engineType = cDbEngine::etMySql;
 cMyMutex cDbConnection::initMutex;
 
 //***************************************************************************
@@ -622,6 +640,8 @@ cMyMutex cDbConnection::initMutex;
 // Object
 //***************************************************************************
 
+int cDbTable::checkStructure = yes;
+
 cDbTable::cDbTable(cDbConnection* aConnection, const char* name)
 {
    connection = aConnection;
@@ -726,17 +746,20 @@ int cDbTable::init(int allowAlter)
    if (!isConnected())
       return fail;
 
-   // check/create table ...
+   if (checkStructure)
+   {
+      // check/create table ...
 
-   if (exist() && allowAlter)
-      validateStructure(allowAlter);
+      if (exist() && allowAlter)
+         validateStructure(allowAlter);
 
-   if (createTable() != success)
-      return fail;
+      if (createTable() != success)
+         return fail;
 
-   // check/create indices
+      // check/create indices
 
-   createIndices();
+      createIndices();
+   }
 
    // ------------------------------
    // prepare BASIC statements
@@ -775,7 +798,9 @@ int cDbTable::init(int allowAlter)
 
    stmtInsert = new cDbStatement(this);
 
-   stmtInsert->build("insert into %s set ", TableName());
+   // 'insert into ... (...) values (...)' is understood by all engines
+
+   stmtInsert->build("insert into %s (", TableName());
 
    n = 0;
 
@@ -786,10 +811,22 @@ int cDbTable::init(int allowAlter)
       if (f->second->getType() & ftAutoinc)
          continue;
 
-      stmtInsert->bind(f->second, bndIn | bndSet, n++ ? ", " : "");
+      stmtInsert->build("%s%s", n++ ? ", " : "", f->second->getDbName());
    }
 
-   stmtInsert->build(";");
+   stmtInsert->build(") values (");
+
+   n = 0;
+
+   for (f = tableDef->dfields.begin(); f != tableDef->dfields.end(); f++)
+   {
+      if (f->second->getType() & ftAutoinc)
+         continue;
+
+      stmtInsert->bind(f->second, bndIn, n++ ? ", " : "");
+   }
+
+   stmtInsert->build(");");
 
    if (stmtInsert->prepare() != success)
       return fail;
@@ -846,70 +883,36 @@ int cDbTable::exist(const char* name)
    if (isEmpty(name))
       name = TableName();
 
-   if (!connection || !connection->getMySql())
+   if (!connection || !connection->isConnected())
       return fail;
 
-   MYSQL_RES* result = mysql_list_tables(connection->getMySql(), name);
-   MYSQL_ROW tabRow = mysql_fetch_row(result);
-   mysql_free_result(result);
-
-   return tabRow ? yes : no;
+   return connection->getEngine()->tableExists(name);
 }
 
 //***************************************************************************
 // Validate Structure
 //***************************************************************************
 
-struct FieldInfo
-{
-   std::string columnFormat;
-   std::string description;
-};
-
 int cDbTable::validateStructure(int allowAlter)
 {
-   std::map<std::string, FieldInfo, _casecmp_> fields;
-   MYSQL_RES* result;
-   MYSQL_ROW row;
-   std::map<std::string, FieldInfo, _casecmp_>::iterator it;
+   cDbColumns fields;
+   cDbColumns::iterator it;
 
    if (!allowAlter)
       return done;
 
-   const char* select = "select column_name, column_type, column_comment, data_type, is_nullable, "
-      " character_maximum_length, column_default, numeric_precision "
-      " from information_schema.columns "
-      " where table_name = '%s' and table_schema= '%s'";
-
    if (attach() != success)
       return fail;
 
    // ------------------------
-   // execute query
-
-   if (connection->query(select, TableName(), connection->getName()) != success)
-   {
-      connection->errorSql(getConnection(), "validateStructure()", 0);
-      return fail;
-   }
-
-   // ------------------------
-   // process the result
+   // get the columns of the table
 
-   if (!(result = mysql_store_result(connection->getMySql())))
+   if (connection->getEngine()->getColumns(TableName(), fields) != success)
    {
       connection->errorSql(getConnection(), "validateStructure()");
       return fail;
    }
 
-   while ((row = mysql_fetch_row(result)))
-   {
-      fields[row[0]].columnFormat = row[1];
-      fields[row[0]].description = row[2];
-   }
-
-   mysql_free_result(result);
-
    // --------------------------------------
    // validate if all fields of dict are in
    //   table and check their format, ...
@@ -925,12 +928,18 @@ int cDbTable::validateStructure(int allowAlter)
 
       else
       {
-         FieldInfo* fieldInfo = &fields[getField(i)->getDbName()];
+         cDbColumnInfo* fieldInfo = &fields[getField(i)->getDbName()];
+
+         // the column type of an inline autoinc column is fixed
 
-         getField(i)->toColumnFormat(colType);
+         if (getField(i)->getType() & ftAutoinc && connection->hasFeature(cDbEngine::efInlineAutoinc))
+            continue;
+
+         getField(i)->toColumnFormat(colType, connection->hasFeature(cDbEngine::efUnsigned));
 
          if (strcasecmp(fieldInfo->columnFormat.c_str(), colType) != 0 ||
-             strcasecmp(fieldInfo->description.c_str(), getField(i)->getDescription()) != 0)
+             (connection->hasFeature(cDbEngine::efComments) &&
+              strcasecmp(fieldInfo->description.c_str(), getField(i)->getDescription()) != 0))
          {
             alterModifyField(getField(i));
          }
@@ -966,6 +975,14 @@ int cDbTable::alterModifyField(cDbFieldDef* def)
    char* statement;
    char colType[100];
 
+   if (!connection->hasFeature(cDbEngine::efAlterModify))
+   {
+      tell(0, "Info: Definition of field '%s.%s' modified, the %s engine can't alter it, "
+           "recreate the table to apply the change",
+           TableName(), def->getName(), cDbEngine::toName(connection->getEngineType()));
+      return done;
+   }
+
    tell(0, "  Info: Definition of field '%s.%s' modified, try to alter table",
         TableName(), def->getName());
 
@@ -974,7 +991,7 @@ int cDbTable::alterModifyField(cDbFieldDef* def)
    asprintf(&statement, "alter table %s modify column %s %s comment '%s'",
             TableName(),
             def->getDbName(),
-            def->toColumnFormat(colType),
+            def->toColumnFormat(colType, connection->hasFeature(cDbEngine::efUnsigned)),
             def->getDbDescription());
 
    tell(1, "%s", statement);
@@ -1003,20 +1020,20 @@ int cDbTable::alterAddField(cDbFieldDef* def)
    // alter table channelmap add column ord int(11) [after source]
 
    statement = std::string("alter table ") + TableName() + std::string(" add column ")
-      + def->getDbName() + std::string(" ") + def->toColumnFormat(colType);
+      + def->getDbName() + std::string(" ") + def->toColumnFormat(colType, connection->hasFeature(cDbEngine::efUnsigned));
 
    if (def->getFormat() != ffMlob)
    {
-      if (def->getType() & ftAutoinc)
+      if (def->getType() & ftAutoinc && !connection->hasFeature(cDbEngine::efInlineAutoinc))
          statement += " not null auto_increment";
       else if (def->getType() & ftDef0)
          statement += " default '0'";
    }
 
-   if (!isEmpty(def->getDbDescription()))
+   if (!isEmpty(def->getDbDescription()) && connection->hasFeature(cDbEngine::efComments))
       statement += std::string(" comment '") + def->getDbDescription() + std::string("'");
 
-   if (def->getIndex() > 0)
+   if (def->getIndex() > 0 && connection->hasFeature(cDbEngine::efColumnPosition))
       statement += std::string(" after ") + getField(def->getIndex()-1)->getDbName();
 
    tell(1, "%s", statement.c_str());
@@ -1053,6 +1070,38 @@ int cDbTable::alterDropField(const char* name)
    return done;
 }
 
+//***************************************************************************
+// Partition Helper
+//   - months are handled as 'year * 12 + month' with month 0-11
+//***************************************************************************
+
+static int monthOf(time_t t)
+{
+   struct tm tm;
+
+   localtime_r(&t, &tm);
+
+   return (tm.tm_year + 1900) * 12 + tm.tm_mon;
+}
+
+static std::string partitionName(int month)
+{
+   char name[20+TB];
+
+   sprintf(name, "p%04d%02d", month / 12, month % 12 + 1);
+
+   return name;
+}
+
+static std::string partitionBound(int month)     // first day of the month
+{
+   char date[20+TB];
+
+   sprintf(date, "%04d-%02d-01", month / 12, month % 12 + 1);
+
+   return date;
+}
+
 //***************************************************************************
 // Create Table
 //***************************************************************************
@@ -1079,13 +1128,24 @@ int cDbTable::createTable()
 
    statement = std::string("create table ") + TableName() + std::string("(");
 
+   int inlineAutoinc = no;
+
    for (int i = 0; i < fieldCount(); i++)
    {
       char colType[100];
 
       if (i) statement += std::string(", ");
 
-      statement += std::string(getField(i)->getDbName()) + " " + std::string(getField(i)->toColumnFormat(colType));
+      // sqlite knows autoinc only for the rowid alias 'integer primary key'
+
+      if (getField(i)->getType() & ftAutoinc && connection->hasFeature(cDbEngine::efInlineAutoinc))
+      {
+         statement += std::string(getField(i)->getDbName()) + " integer primary key autoincrement";
+         inlineAutoinc = yes;
+         continue;
+      }
+
+      statement += std::string(getField(i)->getDbName()) + " " + std::string(getField(i)->toColumnFormat(colType, connection->hasFeature(cDbEngine::efUnsigned)));
 
       if (getField(i)->getFormat() != ffMlob)
       {
@@ -1095,13 +1155,13 @@ int cDbTable::createTable()
             statement += " default '0'";
       }
 
-      if (!isEmpty(getField(i)->getDbDescription()))
+      if (!isEmpty(getField(i)->getDbDescription()) && connection->hasFeature(cDbEngine::efComments))
          statement += std::string(" comment '") + getField(i)->getDbDescription() + std::string("'");
    }
 
    aKey = "";
 
-   for (int i = 0, n = 0; i < fieldCount(); i++)
+   for (int i = 0, n = 0; i < fieldCount() && !inlineAutoinc; i++)
    {
       if (getField(i)->getType() & ftPrimary)
       {
@@ -1119,7 +1179,7 @@ int cDbTable::createTable()
 
    aKey = "";
 
-   for (int i = 0, n = 0; i < fieldCount(); i++)
+   for (int i = 0, n = 0; i < fieldCount() && !inlineAutoinc; i++)
    {
       if (getField(i)->getType() & ftAutoinc && !(getField(i)->getType() & ftPrimary))
       {
@@ -1135,8 +1195,26 @@ int cDbTable::createTable()
       statement += ")";
    }
 
-   // statement += std::string(") ENGINE MYISAM;");
-   statement += std::string(") ENGINE InnoDB;");
+   statement += ")";
+
+   // statement += std::string(" ENGINE MYISAM;");
+
+   if (connection->hasFeature(cDbEngine::efTableOptions))
+      statement += std::string(" ENGINE InnoDB");
+
+   // range partitions by month, one for older rows and the current month up to 'ahead'
+
+   if (tableDef->getPartition() && connection->hasFeature(cDbEngine::efPartitions))
+   {
+      cDbPartitionDef* def = tableDef->getPartition();
+
+      statement += std::string(" PARTITION BY RANGE (TO_DAYS(") + def->getField()->getDbName() + "))";
+      statement += " (PARTITION p000000 VALUES LESS THAN (TO_DAYS('" + partitionBound(monthOf(time(0))) + "')), ";
+      statement += partitionDefinition(monthOf(time(0)), def->getAhead()+1);
+      statement += ", PARTITION pmax VALUES LESS THAN MAXVALUE)";
+   }
+
+   statement += ";";
 
    tell(1, "%s", statement.c_str());
 
@@ -1147,6 +1225,144 @@ int cDbTable::createTable()
    return success;
 }
 
+//***************************************************************************
+// Partition Definition
+//***************************************************************************
+
+std::string cDbTable::partitionDefinition(int fromMonth, int count)
+{
+   std::string definition;
+
+   for (int month = fromMonth; month < fromMonth + count; month++)
+   {
+      if (month > fromMonth) definition += ", ";
+
+      definition += "PARTITION " + partitionName(month)
+         + " VALUES LESS THAN (TO_DAYS('" + partitionBound(month+1) + "'))";
+   }
+
+   return definition;
+}
+
+//***************************************************************************
+// Maintain Partitions
+//   - create the partitions for the next 'ahead' months by splitting the
+//     (empty) MAXVALUE partition and drop partitions older than 'retention'
+//     months, which is much cheaper than deleting the rows
+//***************************************************************************
+
+int cDbTable::maintainPartitions(int retention)
+{
+   cDbPartitionDef* def = tableDef ? tableDef->getPartition() : 0;
+   std::vector<int> months;
+   int hasMax = no;
+   int hasLower = no;
+   cDbRows rows;
+
+   if (!def || !connection->hasFeature(cDbEngine::efPartitions))
+      return done;
+
+   if (retention == na)
+      retention = def->getRetention();
+
+   if (attach() != success)
+      return fail;
+
+   if (connection->query("select partition_name from information_schema.partitions "
+                         "where table_schema = '%s' and table_name = '%s' and partition_name is not null "
+                         "order by partition_ordinal_position", connection->getName(), TableName()) != success)
+      return connection->errorSql(connection, "maintainPartitions()");
+
+   if (connection->getEngine()->getResult(rows) != success)
+      return connection->errorSql(connection, "maintainPartitions()");
+
+   for (uint i = 0; i < rows.size(); i++)
+   {
+      const char* name = rows[i][0].c_str();
+      int year, mon;
+
+      if (strcasecmp(name, "pmax") == 0)
+         hasMax = yes;
+      else if (strcasecmp(name, "p000000") == 0)
+         hasLower = yes;
+      else if (sscanf(name, "p%4d%2d", &year, &mon) == 2)
+         months.push_back(year * 12 + mon - 1);
+   }
+
+   if (!hasMax)
+   {
+      int now = monthOf(time(0));
+
+      tell(0, "Info: Table '%s' isn't partitioned, to convert it call "
+           "'ALTER TABLE %s PARTITION BY RANGE (TO_DAYS(%s)) (PARTITION p000000 VALUES LESS THAN (TO_DAYS('%s')), "
+           "%s, PARTITION pmax VALUES LESS THAN MAXVALUE)' manually",
+           TableName(), TableName(), def->getField()->getDbName(), partitionBound(now).c_str(),
+           partitionDefinition(now, def->getAhead()+1).c_str());
+
+      return done;
+   }
+
+   // create missing partitions up to 'ahead' months
+
+   int current = monthOf(time(0));
+   int last = months.size() ? *std::max_element(months.begin(), months.end()) : current-1;
+   int count = current + def->getAhead() - last;
+
+   if (count > 0)
+   {
+      std::string statement = "alter table " + std::string(TableName()) + " reorganize partition pmax into ("
+         + partitionDefinition(last+1, count) + ", PARTITION pmax VALUES LESS THAN MAXVALUE)";
+
+      tell(1, "%s", statement.c_str());
+
+      if (connection->query("%s", statement.c_str()) != success)
+         return connection->errorSql(connection, "maintainPartitions()", 0, statement.c_str());
+
+      tell(0, "Created %d partition(s) of '%s' up to '%s'", count,
+           TableName(), partitionName(last+count).c_str());
+   }
+
+   // drop expired partitions
+
+   if (retention > 0 && months.size())
+   {
+      int horizon = current - retention;
+      int first = *std::min_element(months.begin(), months.end());
+      std::string names;
+      int dropped = 0;
+
+      // p000000 holds all rows before the first monthly partition
+
+      if (hasLower && first <= horizon)
+      {
+         names = "p000000";
+         dropped++;
+      }
+
+      for (uint i = 0; i < months.size(); i++)
+      {
+         if (months[i] >= horizon)
+            continue;
+
+         if (dropped++) names += ", ";
+         names += partitionName(months[i]);
+      }
+
+      if (dropped)
+      {
+         double start = usNow();
+
+         if (connection->query("alter table %s drop partition %s", TableName(), names.c_str()) != success)
+            return connection->errorSql(connection, "maintainPartitions()", 0, names.c_str());
+
+         tell(0, "Dropped %d expired partition(s) of '%s' [%s] in %.2fms",
+              dropped, TableName(), names.c_str(), (usNow() - start) / 1000);
+      }
+   }
+
+   return success;
+}
+
 //***************************************************************************
 // Create Indices
 //***************************************************************************
@@ -1214,57 +1430,16 @@ int cDbTable::createIndices()
 
 int cDbTable::checkIndex(const char* idxName, int& fieldCount)
 {
-   enum IndexQueryFields
-   {
-      idTable,
-      idNonUnique,
-      idKeyName,
-      idSeqInIndex,
-      idColumnName,
-      idCollation,
-      idCardinality,
-      idSubPart,
-      idPacked,
-      idNull,
-      idIndexType,
-      idComment,
-      idIndexComment,
-
-      idCount
-   };
-
-   MYSQL_RES* result;
-   MYSQL_ROW row;
-
    fieldCount = 0;
 
-   if (connection->query("show index from %s", TableName()) != success)
+   if (connection->getEngine()->getIndexFieldCount(TableName(), idxName, fieldCount) != success)
    {
-      connection->errorSql(getConnection(), "checkIndex()", 0);
+      connection->errorSql(getConnection(), "checkIndex()");
 
       return fail;
    }
 
-   if ((result = mysql_store_result(connection->getMySql())))
-   {
-      while ((row = mysql_fetch_row(result)))
-      {
-         tell(5, "%s:  %-20s %s %s",
-              row[idTable], row[idKeyName],
-              row[idSeqInIndex], row[idColumnName]);
-
-         if (strcasecmp(row[idKeyName], idxName) == 0)
-            fieldCount++;
-      }
-
-      mysql_free_result(result);
-
-      return success;
-   }
-
-   connection->errorSql(getConnection(), "checkIndex()");
-
-   return fail;
+   return success;
 }
 
 //***************************************************************************
@@ -1323,51 +1498,27 @@ void cDbTable::copyValues(cDbRow* r, int typesFilter)
 //***************************************************************************
 
 int cDbConnection::errorSql(cDbConnection* connection, const char* prefix,
-                            MYSQL_STMT* stmt, const char* stmtTxt)
+                            cDbEngineStatement* stmt, const char* stmtTxt)
 {
-   if (!connection || !connection->mysql)
+   if (!connection || !connection->engine || !connection->engine->isOpen())
    {
       tell(0, "SQL-Error in '%s'", prefix);
       return fail;
    }
 
-   int error = mysql_errno(connection->mysql);
+   int error = connection->engine->errorNo();
    char* conErr = 0;
    char* stmtErr = 0;
 
-   if (error == CR_SERVER_LOST ||
-       error == CR_SERVER_GONE_ERROR ||
-       error == CR_INVALID_CONN_HANDLE ||
-       error == CR_COMMANDS_OUT_OF_SYNC ||
-       error == CR_SERVER_LOST_EXTENDED ||
-       error == CR_STMT_CLOSED ||
-       error == CR_CONN_UNKNOW_PROTOCOL ||
-       error == CR_UNSUPPORTED_PARAM_TYPE ||
-       error == CR_NO_PREPARE_STMT ||
-       error == CR_SERVER_HANDSHAKE_ERR ||
-       error == CR_WRONG_HOST_INFO ||
-       error == CR_OUT_OF_MEMORY ||
-       error == CR_IPSOCK_ERROR ||
-       error == CR_SOCKET_CREATE_ERROR ||
-       error == CR_CONNECTION_ERROR ||
-       error == CR_TCP_CONNECTION ||
-       error == CR_PARAMS_NOT_BOUND ||
-       error == CR_CONN_HOST_ERROR ||
-       error == CR_SSL_CONNECTION_ERROR
-
-       // to be continued - not all errors should result in a reconnect ...
-
-      )
-   {
+   if (connection->engine->isConnectionError(error))
       connectDropped = yes;
-   }
 
    if (error)
-      asprintf(&conErr, "%s (%d) ", mysql_error(connection->mysql), error);
+      asprintf(&conErr, "%s (%d) ", connection->engine->errorText(), error);
 
    if (stmt || stmtTxt)
       asprintf(&stmtErr, "'%s' [%s]",
-               stmt ? mysql_stmt_error(stmt) : "",
+               stmt ? stmt->error() : "",
                stmtTxt ? stmtTxt : "");
 
    tell(0, "SQL-Error in '%s' - %s%s", prefix,
@@ -1377,7 +1528,8 @@ int cDbConnection::errorSql(cDbConnection* connection, const char* prefix,
    free(stmtErr);
 
    if (connectDropped)
-      tell(0, "Fatal, lost connection to mysql server, aborting pending actions");
+      tell(0, "Fatal, lost connection to %s database, aborting pending actions",
+           cDbEngine::toName(engineType));
 
    return fail;
 }
@@ -1392,7 +1544,7 @@ int cDbTable::deleteWhere(const char* where, ...)
    char* tmp;
    va_list more;
 
-   if (!connection || !connection->getMySql())
+   if (!connection || !connection->isConnected())
       return fail;
 
    va_start(more, where);
@@ -1415,8 +1567,7 @@ int cDbTable::deleteWhere(const char* where, ...)
 int cDbTable::countWhere(const char* where, int& count, const char* what)
 {
    std::string tmp;
-   MYSQL_RES* res;
-   MYSQL_ROW data;
+   cDbRows rows;
 
    count = 0;
 
@@ -1431,15 +1582,8 @@ int cDbTable::countWhere(const char* where, int& count, const char* what)
    if (connection->query("%s", tmp.c_str()))
       return connection->errorSql(connection, "countWhere()", 0, tmp.c_str());
 
-   if ((res = mysql_store_result(connection->getMySql())))
-   {
-      data = mysql_fetch_row(res);
-
-      if (data)
-         count = atoi(data[0]);
-
-      mysql_free_result(res);
-   }
+   if (connection->getEngine()->getResult(rows) == success && rows.size() && rows[0].size())
+      count = atoi(rows[0][0].c_str());
 
    return success;
 }
@@ -1605,3 +1749,235 @@ void cDbTable::reset(cDbStatement* stmt)
    if (stmt)
       stmt->freeResult();
 }
+
+//***************************************************************************
+// Class cDbConnectionPool
+//***************************************************************************
+
+cDbConnectionPool::cDbConnectionPool(int aMaxConnections)
+{
+   maxConnections = aMaxConnections > 0 ? aMaxConnections : 1;
+   checkIdleAfter = 60;
+}
+
+cDbConnectionPool::~cDbConnectionPool()
+{
+   mutex.Lock();
+
+   for (std::list<cPooled*>::iterator it = connections.begin(); it != connections.end(); ++it)
+   {
+      if ((*it)->inUse)
+         tell(0, "Warning: Destroying connection pool while a connection is still in use");
+
+      disconnect(*it);
+      delete *it;
+   }
+
+   connections.clear();
+   mutex.Unlock();
+}
+
+//***************************************************************************
+// Acquire
+//   - returns an idle connection, a new one if the limit isn't reached yet,
+//     or waits up to 'timeoutMs' for a connection to be released
+//***************************************************************************
+
+cDbConnectionPool::cPooled* cDbConnectionPool::acquire(int timeoutMs, StatementSetFactory factory, void* factoryArg)
+{
+   cPooled* pooled = 0;
+   uint64_t deadline = cTimeMs::Now() + timeoutMs;
+
+   mutex.Lock();
+
+   while (!pooled)
+   {
+      std::list<cPooled*>::iterator it;
+
+      // prefer idle connections which are already connected
+
+      for (it = connections.begin(); it != connections.end(); ++it)
+      {
+         if (!(*it)->inUse && (!pooled || (*it)->ready))
+            pooled = *it;
+      }
+
+      if (!pooled && (int)connections.size() < maxConnections)
+      {
+         pooled = new cPooled();
+         connections.push_back(pooled);
+      }
+
+      if (pooled)
+         break;
+
+      uint64_t now = cTimeMs::Now();
+
+      if (now >= deadline || !released.TimedWait(mutex, deadline - now))
+      {
+         mutex.Unlock();
+         tell(0, "Error: No database connection available after %d ms (%d in use)",
+              timeoutMs, maxConnections);
+         return 0;
+      }
+   }
+
+   pooled->inUse = yes;
+   mutex.Unlock();
+
+   // connecting or checking is done outside the lock,
+   //   the connection is exclusively ours now
+
+   if (pooled->ready && time(0) - pooled->lastUsed > checkIdleAfter)
+   {
+      if (pooled->connection->check() != success)
+      {
+         tell(0, "Pooled database connection lost while idle, reconnecting");
+         disconnect(pooled);
+      }
+   }
+
+   if ((!pooled->ready && connect(pooled) != success) || prepare(pooled, factory, factoryArg) != success)
+   {
+      release(pooled);
+      return 0;
+   }
+
+   return pooled;
+}
+
+//***************************************************************************
+// Release
+//***************************************************************************
+
+void cDbConnectionPool::release(cPooled* pooled)
+{
+   if (!pooled)
+      return ;
+
+   // a dropped connection is reconnected lazily at next acquire()
+
+   if (pooled->ready && !pooled->connection->isConnected())
+      disconnect(pooled);
+
+   mutex.Lock();
+   pooled->inUse = no;
+   pooled->lastUsed = time(0);
+   released.Signal();
+   mutex.Unlock();
+}
+
+//***************************************************************************
+// Close
+//***************************************************************************
+
+void cDbConnectionPool::close()
+{
+   mutex.Lock();
+
+   for (std::list<cPooled*>::iterator it = connections.begin(); it != connections.end(); ++it)
+   {
+      if (!(*it)->inUse)
+         disconnect(*it);
+   }
+
+   mutex.Unlock();
+}
+
+//***************************************************************************
+// Counts
+//***************************************************************************
+
+int cDbConnectionPool::getCount()
+{
+   mutex.Lock();
+   int count = connections.size();
+   mutex.Unlock();
+
+   return count;
+}
+
+int cDbConnectionPool::getIdleCount()
+{
+   int count = 0;
+
+   mutex.Lock();
+
+   for (std::list<cPooled*>::iterator it = connections.begin(); it != connections.end(); ++it)
+   {
+      if (!(*it)->inUse)
+         count++;
+   }
+
+   mutex.Unlock();
+
+   return count;
+}
+
+//***************************************************************************
+// Connect / Disconnect
+//***************************************************************************
+
+int cDbConnectionPool::connect(cPooled* pooled)
+{
+   if (pooled->connection->attachConnection() != success)
+      return fail;
+
+   pooled->ready = yes;
+
+   return success;
+}
+
+void cDbConnectionPool::disconnect(cPooled* pooled)
+{
+   std::map<StatementSetFactory, cDbStatementSet*>::iterator it;
+
+   for (it = pooled->sets.begin(); it != pooled->sets.end(); ++it)
+   {
+      it->second->exit();
+      delete it->second;
+   }
+
+   pooled->sets.clear();
+
+   if (!pooled->ready)
+      return ;
+
+   pooled->connection->close();   // close() instead of detach, the handle may be dropped already
+   pooled->ready = no;
+}
+
+//***************************************************************************
+// Prepare
+//   - the statement set of the user, once per connection
+//***************************************************************************
+
+int cDbConnectionPool::prepare(cPooled* pooled, StatementSetFactory factory, void* factoryArg)
+{
+   cDbStatementSet* set;
+
+   if (!factory || pooled->sets.find(factory) != pooled->sets.end())
+      return success;
+
+   if (!(set = factory(factoryArg)))
+      return fail;
+
+   if (set->init(pooled->connection) != success)
+   {
+      tell(0, "Error: Preparing statements of pooled connection failed");
+      set->exit();
+      delete set;
+      return fail;
+   }
+
+   pooled->sets[factory] = set;
+
+   return success;
+}
+
+cDbStatementSet* cDbConnectionPool::cPooled::getSet(StatementSetFactory factory)
+{
+   std::map<StatementSetFactory, cDbStatementSet*>::iterator it = sets.find(factory);
+
+   return it != sets.end() ? it->second : 0;
+}
@@ -16,12 +16,12 @@
 #include <stdarg.h>
 #include <errno.h>
 
-#include <mysql/mysql.h>
-
 #include <list>
+#include <map>
 
 #include "common.h"
 #include "dbdict.h"
+#include "dbengine.h"
 
 class cDbTable;
 class cDbConnection;
@@ -479,6 +479,8 @@ class cDbStatement : public cDbService
       // ..
 
       int prepare();
+      int setStreaming(int rows = na);   // call before prepare()
+      int isStreaming()    { return streaming; }
       int getAffected()    { return affected; }
       int getResultCount();
       int getLastInsertId();
@@ -489,13 +491,17 @@ class cDbStatement : public cDbService
       // data
 
       static int explain;         // debug explain
+      static int prefetchRows;    // default row count fetched per round trip in streaming mode
+
+      static cCounter executions; // of all statements of all threads
+      static cCounter executeUs;  // their duration [us]
 
    private:
 
       int appendBinding(cDbValue* value, BindType bt);
 
       std::string stmtTxt;
-      MYSQL_STMT* stmt;
+      cDbEngineStatement* stmt;
       int affected;
       cDbConnection* connection;
       cDbTable* table;
@@ -503,10 +509,11 @@ class cDbStatement : public cDbService
       MYSQL_BIND* inBind;         // to db
       int outCount;
       MYSQL_BIND* outBind;        // from db (result)
-      MYSQL_RES* metaResult;
       const char* bindPrefix;
       int firstExec;              // debug explain
       int buildErrors;
+      int streaming;              // read via server side cursor instead of storing the result
+      int streamRows;
 
       unsigned long callsPeriod;
       unsigned long callsTotal;
@@ -687,7 +694,7 @@ class cDbConnection
 
       cDbConnection()
       {
-         mysql = 0;
+         engine = 0;
          attached = 0;
          inTact = no;
          connectDropped = yes;
@@ -696,46 +703,32 @@ class cDbConnection
       virtual ~cDbConnection()
       {
          close();
+         delete engine;
       }
 
-      int isConnected() { return getMySql() != 0; }
+      int isConnected() { return getEngine() != 0; }
 
       int attachConnection()
       {
-         static int first = yes;
-
-         if (!mysql)
+         if (!engine || !engine->isOpen())
          {
             connectDropped = yes;
 
-            tell(0, "Calling mysql_init(%ld)", syscall(__NR_gettid));
+            // the engine object lives as long as the connection, this way the
+            //   statements can detect a re-opened engine
 
-            if (!(mysql = mysql_init(0)))
-               return errorSql(this, "attachConnection(init)");
+            if (!engine && !(engine = cDbEngine::create(engineType)))
+               return fail;
 
-            if (!mysql_real_connect(mysql, dbHost, dbUser, dbPass, dbName, dbPort, 0, 0))
+            if (engine->open(dbHost, dbPort, dbName, dbUser, dbPass, encoding) != success)
             {
-               errorSql(this, "connecting to database");
-               tell(0, "Error, connecting to database at '%s' on port (%d) failed", dbHost, dbPort);
+               tell(0, "Error, connecting to %s database '%s' at '%s' on port (%d) failed",
+                    cDbEngine::toName(engineType), dbName, dbHost, dbPort);
                close();
                return fail;
             }
 
             connectDropped = no;
-
-            // init encoding
-
-            if (encoding && *encoding)
-            {
-               if (mysql_set_character_set(mysql, encoding))
-                  errorSql(this, "init(character_set)");
-
-               if (first)
-               {
-                  tell(0, "SQL client character now '%s'", mysql_character_set_name(mysql));
-                  first = no;
-               }
-            }
          }
 
          attached++;
@@ -753,13 +746,9 @@ class cDbConnection
 
       void close()
       {
-         if (mysql)
+         if (engine && engine->isOpen())
          {
-            tell(0, "Closing mysql connection and calling mysql_thread_end(%ld)", syscall(__NR_gettid));
-
-            mysql_close(mysql);
-            mysql_thread_end();
-            mysql = 0;
+            engine->close();
             attached = 0;
          }
       }
@@ -801,20 +790,12 @@ class cDbConnection
 
          if ((status = vquery(format, more)) == success)
          {
-            MYSQL_RES* res;
-            MYSQL_ROW data;
+            cDbRows rows;
 
             // get affected rows ..
 
-            if ((res = mysql_store_result(getMySql())))
-            {
-               data = mysql_fetch_row(res);
-
-               if (data)
-                  count = atoi(data[0]);
-
-               mysql_free_result(res);
-            }
+            if (getEngine()->getResult(rows) == success && rows.size() && rows[0].size())
+               count = atoi(rows[0][0].c_str());
          }
 
          return status;
@@ -822,31 +803,28 @@ class cDbConnection
 
       virtual int vquery(const char* format, va_list more)
       {
-         int status = 1;
-         MYSQL* h = getMySql();
+         int status = fail;
+         cDbEngine* e = getEngine();
 
-         if (h && format)
+         if (e && format)
          {
             char* stmt;
 
             vasprintf(&stmt, format, more);
 
-            if ((status = mysql_query(h, stmt)))
+            if ((status = e->query(stmt)) != success)
                errorSql(this, stmt);
 
             free(stmt);
          }
 
-         return status ? fail : success;
+         return status;
       }
 
       virtual void queryReset()
       {
-         if (getMySql())
-         {
-            MYSQL_RES* result = mysql_use_result(getMySql());
-            mysql_free_result(result);
-         }
+         if (getEngine())
+            getEngine()->freeResult();
       }
 
       // escapeSqlString - only need to be used in string statements not in bind values!!
@@ -858,15 +836,7 @@ class cDbConnection
          if (!isConnected())
             return result;
 
-         int length = strlen(str);
-         int bufferSize = length*2 + TB;
-
-         char* buffer = (char*)malloc(bufferSize);
-         mysql_real_escape_string(getMySql(), buffer, str, length);
-         result = buffer;
-         free(buffer);
-
-         return result;
+         return getEngine()->escape(str);
       }
 
       virtual int executeSqlFile(const char* file)
@@ -877,7 +847,7 @@ class cDbConnection
          int size = 1000;
          int nread = 0;
 
-         if (!getMySql())
+         if (!isConnected())
             return fail;
 
          if (!(f = fopen(file, "r")))
@@ -915,35 +885,49 @@ class cDbConnection
 
       virtual int startTransaction()
       {
+         if (!isConnected())
+            return fail;
+
          inTact = yes;
-         return query("START TRANSACTION");
+         return getEngine()->startTransaction() == success ? success : errorSql(this, "startTransaction()");
       }
 
       virtual int commit()
       {
+         if (!isConnected())
+            return fail;
+
          inTact = no;
-         return query("COMMIT");
+         return getEngine()->commit() == success ? success : errorSql(this, "commit()");
       }
 
       virtual int rollback()
       {
+         if (!isConnected())
+            return fail;
+
          inTact = no;
-         return query("ROLLBACK");
+         return getEngine()->rollback() == success ? success : errorSql(this, "rollback()");
       }
 
       virtual int inTransaction() { return inTact; }
 
-      MYSQL* getMySql()
+      // write pending batched rows (engines without batching ignore it)
+
+      int flush()                                    { return isConnected() ? getEngine()->flush() : done; }
+
+      cDbEngine* getEngine()
       {
          if (connectDropped)
             close();
 
-         return mysql;
+         return engine && engine->isOpen() ? engine : 0;
       }
 
+      int hasFeature(int feature)                    { return engine ? engine->hasFeature(feature) : no; }
       int getAttachedCount()                         { return attached; }
       void showStat(const char* name = "")           { statements.showStat(name); }
-      int errorSql(cDbConnection* mysql, const char* prefix, MYSQL_STMT* stmt = 0, const char* stmtTxt = 0);
+      int errorSql(cDbConnection* connection, const char* prefix, cDbEngineStatement* stmt = 0, const char* stmtTxt = 0);
 
       // data
 
@@ -968,6 +952,8 @@ class cDbConnection
       static const char* getEncoding()               { return encoding; }
       static void setConfPath(const char* cpath)     { free(confPath); confPath = strdup(cpath); }
       static const char* getConfPath()               { return confPath; }
+      static void setEngineType(int type)            { engineType = type; }   // before init()
+      static int getEngineType()                     { return engineType; }
 
       // -----------------------------------------------------------
       // init() and exit() must exactly called 'once' per process
@@ -980,17 +966,11 @@ class cDbConnection
 
          if (!initThreads)
          {
-            tell(1, "Info: Calling mysql_library_init()");
-
-            if (mysql_library_init(0, 0, 0))
-            {
-               tell(0, "Error: mysql_library_init() failed");
-               status = fail;
-            }
+            status = cDbEngine::libraryInit(engineType);
          }
          else
          {
-            tell(1, "Info: Skipping calling mysql_library_init(), it's already done!");
+            tell(1, "Info: Skipping library init of %s engine, it's already done!", cDbEngine::toName(engineType));
          }
 
          initThreads++;
@@ -1007,8 +987,7 @@ class cDbConnection
 
          if (!initThreads)
          {
-            tell(1, "Info: Released the last usage of mysql_lib, calling mysql_library_end() now");
-            mysql_library_end();
+            cDbEngine::libraryEnd(engineType);
 
             free(dbHost);
             free(dbUser);
@@ -1019,7 +998,7 @@ class cDbConnection
          }
          else
          {
-            tell(1, "Info: The mysql_lib is still in use, skipping mysql_library_end() call");
+            tell(1, "Info: The %s engine is still in use, skipping library end", cDbEngine::toName(engineType));
          }
 
          initMutex.Unlock();
@@ -1029,7 +1008,7 @@ class cDbConnection
 
    private:
 
-      MYSQL* mysql;
+      cDbEngine* engine;
 
       int initialized;
       int attached;
@@ -1038,6 +1017,7 @@ class cDbConnection
 
       static cMyMutex initMutex;
       static int initThreads;
+      static int engineType;
 
       static char* encoding;
       static char* confPath;
@@ -1141,8 +1121,7 @@ class cDbTable : public cDbService
 
       cDbTableDef* getTableDef()                                      { return tableDef; }
       cDbConnection* getConnection()                                  { return connection; }
-      MYSQL* getMySql()                                               { return connection->getMySql(); }
-      int isConnected()                                               { return connection && connection->getMySql(); }
+      int isConnected()                                               { return connection && connection->isConnected(); }
 
       int getLastInsertId()                                           { return lastInsertId; }
 
@@ -1150,6 +1129,9 @@ class cDbTable : public cDbService
       virtual int validateStructure(int allowAlter = 1);        // 0 - off, 1 - on, 2 on with allow drop unused columns
       virtual int createTable();
       virtual int createIndices();
+      virtual int maintainPartitions(int retention = na);  // retention in partitions, na for dictionary default
+
+      static int checkStructure;   // check/create table and indices on open(), off if the dictionary is unchanged
 
    protected:
 
@@ -1158,6 +1140,7 @@ class cDbTable : public cDbService
       virtual int alterModifyField(cDbFieldDef* def);
       virtual int alterAddField(cDbFieldDef* def);
       virtual int alterDropField(const char* name);
+      std::string partitionDefinition(int fromMonth, int count);
 
       // data
 
@@ -1194,14 +1177,8 @@ class cDbView : public cDbService
 
       int exist()
       {
-         if (connection->getMySql())
-         {
-            MYSQL_RES* result = mysql_list_tables(connection->getMySql(), name);
-            MYSQL_ROW tabRow = mysql_fetch_row(result);
-            mysql_free_result(result);
-
-            return tabRow ? yes : no;
-         }
+         if (connection->isConnected())
+            return connection->getEngine()->tableExists(name);
 
          return no;
       }
@@ -1257,7 +1234,7 @@ class cDbProcedure : public cDbService
 
       int call(int ll = 1)
       {
-         if (!connection || !connection->getMySql())
+         if (!connection || !connection->isConnected())
             return fail;
 
          cDbStatement stmt(connection);
@@ -1276,7 +1253,7 @@ class cDbProcedure : public cDbService
 
       int created()
       {
-         if (!connection || !connection->getMySql())
+         if (!connection || !connection->isConnected())
             return fail;
 
          cDbStatement stmt(connection);
@@ -1344,5 +1321,81 @@ class cDbProcedure : public cDbService
 
 };
 
+//***************************************************************************
+// cDbStatementSet
+//   - the tables and prepared statements a pool user needs on a
+//     connection, created by the user's factory once per connection
+//***************************************************************************
+
+class cDbStatementSet
+{
+   public:
+
+      virtual ~cDbStatementSet() {}
+
+      virtual int init(cDbConnection* connection) = 0;   // open tables, prepare statements
+      virtual int exit() = 0;                            // delete statements, close tables
+};
+
+//***************************************************************************
+// cDbConnectionPool
+//   - thread safe, each acquired connection is used by exactly one thread
+//     until released, engine handles are never shared between threads
+//   - each user passes the factory of its statement set to acquire(), a
+//     connection keeps the sets of all its users until it's disconnected
+//***************************************************************************
+
+class cDbConnectionPool
+{
+   public:
+
+      typedef cDbStatementSet* (*StatementSetFactory)(void* arg);
+
+      class cPooled
+      {
+         public:
+
+            friend class cDbConnectionPool;
+
+            cDbConnection* getConnection()    { return connection; }
+            cDbStatementSet* getSet(StatementSetFactory factory);
+
+         private:
+
+            cPooled()  { connection = new cDbConnection(); inUse = no; ready = no; lastUsed = 0; }
+            ~cPooled() { delete connection; }
+
+            cDbConnection* connection;
+            std::map<StatementSetFactory, cDbStatementSet*> sets;
+            int inUse;
+            int ready;                // connected
+            time_t lastUsed;
+      };
+
+      cDbConnectionPool(int aMaxConnections = 4);
+      ~cDbConnectionPool();
+
+      cPooled* acquire(int timeoutMs = 10000, StatementSetFactory factory = 0, void* factoryArg = 0);
+      void release(cPooled* pooled);
+      void close();                     // disconnect all idle connections
+
+      void setMaxConnections(int count)    { maxConnections = count > 0 ? count : 1; }
+      void setCheckIdleAfter(int seconds)  { checkIdleAfter = seconds; }
+      int getCount();
+      int getIdleCount();
+
+   private:
+
+      int connect(cPooled* pooled);
+      int prepare(cPooled* pooled, StatementSetFactory factory, void* factoryArg);
+      void disconnect(cPooled* pooled);
+
+      std::list<cPooled*> connections;
+      cMyMutex mutex;
+      cCondVar released;
+      int maxConnections;
+      int checkIdleAfter;               // health check connections idle longer than [s]
+};
+
 //***************************************************************************
 #endif //__DB_H
@@ -0,0 +1,187 @@
+/*
+ * dbbench.c
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ *  ingest and query cost of the database engines
+ *   usage: dbbench [-e mysql|sqlite] [-n rows] [-c dictionary] [-d name]
+ */
+
+#include <stdint.h>
+#include <unistd.h>
+#include <stdio.h>
+
+#include "common.h"
+#include "db.h"
+#include "dbdict.h"
+
+cDbConnection* connection = 0;
+
+//***************************************************************************
+// Show Result
+//***************************************************************************
+
+void showResult(const char* what, long rows, uint64_t ms)
+{
+   tell(0, "%-12s %-22s %8ld rows in %6ld ms  (%ld rows/s)",
+        cDbEngine::toName(cDbConnection::getEngineType()), what,
+        rows, (long)ms, ms ? (long)(rows * 1000 / ms) : rows * 1000);
+}
+
+//***************************************************************************
+// Ingest
+//   - one sample per sensor and minute, like p4d stores them
+//***************************************************************************
+
+int ingest(cDbTable* table, long rows, time_t start)
+{
+   const int sensors = 50;
+   uint64_t begin = cTimeMs::Now();
+
+   for (long i = 0; i < rows; i++)
+   {
+      table->clear();
+      table->setValue("ADDRESS", (long)(i % sensors));
+      table->setValue("TYPE", "VA");
+      table->setValue("AGGREGATE", "S");
+      table->setValue("TIME", start + (i / sensors) * 60);
+      table->setValue("VALUE", 20.0 + (i % 100) / 10.0);
+      table->setValue("SAMPLES", 1);
+
+      if (table->insert() != success)
+         return fail;
+   }
+
+   connection->flush();
+   showResult("insert", rows, cTimeMs::Now() - begin);
+
+   return success;
+}
+
+//***************************************************************************
+// Query
+//***************************************************************************
+
+int query(cDbTable* table, long rows, time_t start)
+{
+   cDbStatement* select = new cDbStatement(table);
+   cDbValue from;
+   cDbFieldDef fromDef("time", "time", cDBS::ffDateTime, 0, cDBS::ftData);
+   long count = 0;
+   int loops = 50;
+
+   from.setField(&fromDef);
+
+   select->build("select ");
+   select->bind("TIME", cDBS::bndOut);
+   select->bind("VALUE", cDBS::bndOut, ", ");
+   select->build(" from %s where ", table->TableName());
+   select->bind("ADDRESS", cDBS::bndIn | cDBS::bndSet);
+   select->bind("TYPE", cDBS::bndIn | cDBS::bndSet, " and ");
+   select->bindCmp(0, &from, ">=", " and ");
+   select->build(" order by time");
+
+   if (select->prepare() != success)
+   {
+      delete select;
+      return fail;
+   }
+
+   // range select of the last quarter for 'loops' sensors
+
+   uint64_t begin = cTimeMs::Now();
+
+   for (int l = 0; l < loops; l++)
+   {
+      table->clear();
+      table->setValue("ADDRESS", (long)l);
+      table->setValue("TYPE", "VA");
+      from.setValue(start + (rows / 50) * 60 * 3 / 4);
+
+      for (int f = select->find(); f; f = select->fetch())
+         count++;
+
+      select->freeResult();
+   }
+
+   showResult("range select", count, cTimeMs::Now() - begin);
+
+   // count
+
+   int total = 0;
+
+   begin = cTimeMs::Now();
+   table->countWhere("type = 'VA'", total);
+   showResult("count", total, cTimeMs::Now() - begin);
+
+   delete select;
+
+   return success;
+}
+
+//***************************************************************************
+// Main
+//***************************************************************************
+
+int main(int argc, char** argv)
+{
+   const char* engine = "mysql";
+   const char* dictPath = "../configs/p4d.dat";
+   const char* name = "p4bench";
+   long rows = 100000;
+
+   logstdout = yes;
+   loglevel = 0;
+
+   for (int i = 1; argv[i]; i++)
+   {
+      if (argv[i][0] != '-' || strlen(argv[i]) != 2 || !argv[i+1])
+      {
+         printf("Usage: dbbench [-e mysql|sqlite] [-n rows] [-c dictionary] [-d name]\n");
+         return 1;
+      }
+
+      switch (argv[i][1])
+      {
+         case 'e': engine = argv[++i];       break;
+         case 'n': rows = atol(argv[++i]);   break;
+         case 'c': dictPath = argv[++i];     break;
+         case 'd': name = argv[++i];         break;
+      }
+   }
+
+   if (dbDict.in(dictPath) != success)
+   {
+      tell(0, "Fatal: Dictionary '%s' not loaded, aborting!", dictPath);
+      return 1;
+   }
+
+   cDbConnection::setEngineType(cDbEngine::toType(engine));
+
+   if (cDbConnection::init() != success)
+      return 1;
+
+   cDbConnection::setEncoding("utf8");
+   cDbConnection::setHost("localhost");
+   cDbConnection::setName(name);
+   cDbConnection::setUser("p4");
+   cDbConnection::setPass("p4");
+
+   connection = new cDbConnection();
+
+   cDbTable* table = new cDbTable(connection, "samples");
+   time_t start = time(0) - (rows / 50) * 60;
+
+   if (table->open(yes) == success && table->truncate() == success)
+   {
+      if (ingest(table, rows, start) == success)
+         query(table, rows, start);
+   }
+
+   table->close();
+   delete table;
+   delete connection;
+   cDbConnection::exit();
+
+   return 0;
+}
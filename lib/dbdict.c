@@ -287,6 +287,72 @@ void cDbDict::forget()
    fltFromNameFct = 0;
 }    
 
+//***************************************************************************
+// Fingerprint
+//   - FNV-1a hash over everything of the parsed dictionary which affects
+//     the database structure, comments and formatting of the file don't
+//     change it
+//***************************************************************************
+
+std::string cDbDict::fingerprint()
+{
+   std::map<std::string, cDbTableDef*>::iterator t;
+   std::string def = "";
+   char* buf;
+   char hash[16+TB];
+   uint64_t h = 0xcbf29ce484222325ULL;
+
+   for (t = tables.begin(); t != tables.end(); t++)
+   {
+      cDbTableDef* table = t->second;
+
+      def += "T:" + t->first + ";";
+
+      for (int i = 0; i < table->fieldCount(); i++)
+      {
+         cDbFieldDef* field = table->getField(i);
+
+         asprintf(&buf, "F:%s,%s,%d,%d,%d,%s;", field->getName(), field->getDbName(),
+                  field->getFormat(), field->getSize(), field->getType(),
+                  field->getDescription() ? field->getDescription() : "");
+         def += buf;
+         free(buf);
+      }
+
+      for (int i = 0; i < table->indexCount(); i++)
+      {
+         cDbIndexDef* index = table->getIndex(i);
+
+         def += std::string("I:") + index->getName();
+
+         for (int n = 0; n < index->fieldCount(); n++)
+            def += std::string(",") + index->getField(n)->getName();
+
+         def += ";";
+      }
+
+      if (table->getPartition())
+      {
+         cDbPartitionDef* partition = table->getPartition();
+
+         asprintf(&buf, "P:%s,%d,%d,%d;", partition->getField()->getName(),
+                  partition->getInterval(), partition->getAhead(), partition->getRetention());
+         def += buf;
+         free(buf);
+      }
+   }
+
+   for (uint i = 0; i < def.length(); i++)
+   {
+      h ^= (byte)def[i];
+      h *= 0x100000001b3ULL;
+   }
+
+   sprintf(hash, "%016llx", (unsigned long long)h);
+
+   return hash;
+}
+
 //***************************************************************************
 // Show
 //***************************************************************************
@@ -313,6 +379,7 @@ int cDbDict::atLine(const char* line)
    int status = success;
    static int prsTable = no;
    static int prsIndex = no;
+   static int prsPartition = no;
 
    const char* p;
 
@@ -339,6 +406,21 @@ int cDbDict::atLine(const char* line)
       prsIndex = yes;
       p = line + strlen("Table ");
    }
+   else if (strncasecmp(line, "Partition ", 10) == 0)
+   {
+      char tableName[100];
+
+      prsPartition = yes;
+      p = line + strlen("Partition ");
+      strcpy(tableName, p);
+      allTrim(tableName);
+
+      if (!(curTable = getTable(tableName)))
+      {
+         tell(0, "Fatal: Partition for unknown table '%s' defined", tableName);
+         status = fail;
+      }
+   }
 
    else if (strchr(line, '{'))
       inside = yes;
@@ -348,6 +430,7 @@ int cDbDict::atLine(const char* line)
       inside = no;
       prsTable = no;
       prsIndex = no;
+      prsPartition = no;
    }
 
    else if (inside && prsTable)
@@ -356,6 +439,9 @@ int cDbDict::atLine(const char* line)
    else if (inside && prsIndex)
       status += parseIndex(line);
 
+   else if (inside && prsPartition)
+      status += parsePartition(line);
+
    else
       tell(0, "Info: Ignoring extra line [%s]", line);
 
@@ -499,3 +585,55 @@ int cDbDict::parseIndex(const char* line)
 
    return success;
 }
+
+//***************************************************************************
+// Parse Partition
+//   <field> <description> <interval> <ahead> <retention>,
+//***************************************************************************
+
+int cDbDict::parsePartition(const char* line)
+{
+   const int sizeTokenMax = 100;
+   char token[sizeTokenMax+TB];
+   const char* p = line;
+
+   if (!curTable)
+      return fail;
+
+   cDbPartitionDef* partition = new cDbPartitionDef();
+
+   for (int i = 0; i < pdtCount; i++)
+   {
+      if (getToken(p, token, sizeTokenMax) != success)
+      {
+         delete partition;
+         tell(0, "Error: Can't parse line [%s]", line);
+         return fail;
+      }
+
+      if (strchr(token, ','))
+         *(strchr(token, ',')) = 0;
+
+      switch (i)
+      {
+         case pdtField:       partition->field = curTable->getField(token);     break;
+         case pdtDescription: partition->setDescription(token);                 break;
+         case pdtInterval:    partition->interval = cDbPartitionDef::toInterval(token); break;
+         case pdtAhead:       partition->ahead = atoi(token);                   break;
+         case pdtRetention:   partition->retention = atoi(token);               break;
+      }
+   }
+
+   if (!partition->field || !partition->field->hasType(ftPrimary) ||
+       !partition->field->isDateTime() || partition->interval == cDbPartitionDef::piUnknown)
+   {
+      tell(0, "Error: Can't parse line [%s], partitioning needs a primary "
+           "key DateTime field and a valid interval", line);
+      delete partition;
+      return fail;
+   }
+
+   curTable->setPartition(partition);
+
+   return success;
+}
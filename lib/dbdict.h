@@ -172,7 +172,7 @@ class cDbFieldDef : public cDbService
          dbdescription = strdup(strReplace("'", "\\'", description).c_str());
       }
 
-      const char* toColumnFormat(char* buf) // column type to be used for create/alter
+      const char* toColumnFormat(char* buf, int withUnsigned = yes) // column type to be used for create/alter
       {
          if (!buf)
             return 0;
@@ -196,7 +196,7 @@ class cDbFieldDef : public cDbService
             else if (format == ffInt || format == ffUInt || format == ffAscii)
                sprintf(eos(buf), "(%d)", size);
             
-            if (format == ffUInt || format == ffUBigInt)
+            if ((format == ffUInt || format == ffUBigInt) && withUnsigned)
                sprintf(eos(buf), " unsigned");
          }
          
@@ -279,6 +279,55 @@ class cDbIndexDef
       std::vector<cDbFieldDef*> dfields;  // index fields
 };
 
+//***************************************************************************
+// cDbPartitionDef
+//***************************************************************************
+
+class cDbPartitionDef : public cDbService
+{
+   public:
+
+      enum Interval
+      {
+         piUnknown = na,
+         piMonthly
+      };
+
+      cDbPartitionDef()  { field = 0; description = 0; interval = piUnknown; ahead = 0; retention = 0; }
+      ~cDbPartitionDef() { free(description); }
+
+      void setDescription(const char* d) { free(description); description = strdup(d); }
+      const char* getDescription()       { return description; }
+
+      cDbFieldDef* getField()            { return field; }
+      int getInterval()                  { return interval; }
+      int getAhead()                     { return ahead; }        // partitions created in advance
+      int getRetention()                 { return retention; }    // partitions kept, 0 for all
+
+      static int toInterval(const char* name)
+      {
+         if (strcasecmp(name, "monthly") == 0)
+            return piMonthly;
+
+         return piUnknown;
+      }
+
+      void show()
+      {
+         tell(0, "Partition by %s monthly, %d ahead, retention %d", field->getName(), ahead, retention);
+      }
+
+   protected:
+
+      friend class cDbDict;
+
+      cDbFieldDef* field;
+      char* description;
+      int interval;
+      int ahead;
+      int retention;
+};
+
 //***************************************************************************
 // cDbTableDef
 //***************************************************************************
@@ -291,7 +340,7 @@ class cDbTableDef : public cDbService
       friend class cDbTable;
       friend class cDbStatement;
 
-      cDbTableDef(const char* n)       { name = strdup(n); }
+      cDbTableDef(const char* n)       { name = strdup(n); partition = 0; }
 
       ~cDbTableDef()                
       { 
@@ -299,6 +348,7 @@ class cDbTableDef : public cDbService
             delete indices[i];
 
          indices.clear();
+         delete partition;
 
          free(name);
          clear();
@@ -351,6 +401,9 @@ class cDbTableDef : public cDbService
       cDbIndexDef* getIndex(int i)        { return indices[i]; }
       void addIndex(cDbIndexDef* i)       { indices.push_back(i); }
 
+      cDbPartitionDef* getPartition()            { return partition; }
+      void setPartition(cDbPartitionDef* p)      { delete partition; partition = p; }
+
       void clear()
       {
          std::map<std::string, cDbFieldDef*>::iterator f;
@@ -386,6 +439,9 @@ class cDbTableDef : public cDbService
          for (uint i = 0; i < indices.size(); i++)
             indices[i]->show();
 
+         if (partition)
+            partition->show();
+
          tell(0, " ");
       }
 
@@ -393,6 +449,7 @@ class cDbTableDef : public cDbService
 
       char* name;
       std::vector<cDbIndexDef*> indices;
+      cDbPartitionDef* partition;
 
       // FiledDefs stored as list to have access via index
       std::vector<cDbFieldDef*> _dfields;
@@ -431,6 +488,17 @@ class cDbDict : public cDbService
          idtFields
       };
 
+      enum PartitionDictToken
+      {
+         pdtField,
+         pdtDescription,
+         pdtInterval,
+         pdtAhead,
+         pdtRetention,
+
+         pdtCount
+      };
+
       cDbDict();
       virtual ~cDbDict();
 
@@ -442,6 +510,7 @@ class cDbDict : public cDbService
       int init(cDbFieldDef*& field, const char* tname, const char* fname);
       const char* getPath() { return path ? path : ""; }
       void forget();
+      std::string fingerprint();    // hash of the parsed definitions
 
       std::map<std::string, cDbTableDef*>::iterator getFirstTableIterator() { return tables.begin(); }
       std::map<std::string, cDbTableDef*>::iterator getTableEndIterator()   { return tables.end(); }
@@ -451,6 +520,7 @@ class cDbDict : public cDbService
       int atLine(const char* line);
       int parseField(const char* line);
       int parseIndex(const char* line);
+      int parsePartition(const char* line);
       int toFilter(char* token);
 
       // data
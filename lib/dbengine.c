@@ -0,0 +1,405 @@
+/*
+ * dbengine.c
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#include <linux/unistd.h>
+#include <unistd.h>
+#include <errmsg.h>
+
+#include "dbengine.h"
+
+//***************************************************************************
+// Engine Statics
+//***************************************************************************
+
+static const char* engineNames[] =
+{
+   "mysql",
+   "sqlite",
+
+   0
+};
+
+const char* cDbEngine::toName(int type)
+{
+   if (type < 0 || type >= etCount)
+      return "unknown";
+
+   return engineNames[type];
+}
+
+int cDbEngine::toType(const char* name)
+{
+   for (int i = 0; engineNames[i]; i++)
+      if (strcasecmp(engineNames[i], name) == 0)
+         return i;
+
+   return etUnknown;
+}
+
+cDbEngine* cDbEngine::create(int type)
+{
+   switch (type)
+   {
+      case etMySql:  return new cDbMySqlEngine();
+#ifdef USESQLITE
+      case etSqlite: return new cDbSqliteEngine();
+#endif
+   }
+
+   tell(0, "Error: Database engine '%s' not supported by this build", toName(type));
+
+   return 0;
+}
+
+int cDbEngine::libraryInit(int type)
+{
+   if (type == etMySql)
+   {
+      tell(1, "Info: Calling mysql_library_init()");
+
+      if (mysql_library_init(0, 0, 0))
+      {
+         tell(0, "Error: mysql_library_init() failed");
+         return fail;
+      }
+   }
+#ifdef USESQLITE
+   else if (type == etSqlite)
+   {
+      if (sqlite3_initialize() != SQLITE_OK)
+      {
+         tell(0, "Error: sqlite3_initialize() failed");
+         return fail;
+      }
+   }
+#endif
+
+   return success;
+}
+
+void cDbEngine::libraryEnd(int type)
+{
+   if (type == etMySql)
+   {
+      tell(1, "Info: Released the last usage of mysql_lib, calling mysql_library_end() now");
+      mysql_library_end();
+   }
+#ifdef USESQLITE
+   else if (type == etSqlite)
+      sqlite3_shutdown();
+#endif
+}
+
+//***************************************************************************
+// MySQL Statement
+//***************************************************************************
+
+cDbMySqlStatement::~cDbMySqlStatement()
+{
+   if (stmt)
+   {
+      mysql_stmt_free_result(stmt);
+      mysql_stmt_close(stmt);
+   }
+}
+
+int cDbMySqlStatement::prepare(const char* sql, MYSQL_BIND* inBind, int inCount,
+                               MYSQL_BIND* outBind, int outCount, int streamRows)
+{
+   stmt = mysql_stmt_init(mysql);
+
+   // prepare statement
+
+   if (mysql_stmt_prepare(stmt, sql, strlen(sql)))
+      return fail;
+
+   if (streamRows > 0)
+   {
+      unsigned long type = CURSOR_TYPE_READ_ONLY;
+      unsigned long rows = streamRows;
+
+      if (mysql_stmt_attr_set(stmt, STMT_ATTR_CURSOR_TYPE, &type) ||
+          mysql_stmt_attr_set(stmt, STMT_ATTR_PREFETCH_ROWS, &rows))
+         return fail;
+   }
+
+   if (outBind && mysql_stmt_bind_result(stmt, outBind))
+      return fail;
+
+   if (inBind && mysql_stmt_bind_param(stmt, inBind))
+      return fail;
+
+   return success;
+}
+
+int cDbMySqlStatement::execute()
+{
+   return mysql_stmt_execute(stmt) ? fail : success;
+}
+
+int cDbMySqlStatement::storeResult()
+{
+   return mysql_stmt_store_result(stmt) ? fail : success;
+}
+
+int cDbMySqlStatement::fetch()
+{
+   int res = mysql_stmt_fetch(stmt);
+
+   if (res == 1)
+      return fail;
+
+   return res == 0 ? yes : no;
+}
+
+int cDbMySqlStatement::freeResult()
+{
+   if (stmt)
+      mysql_stmt_free_result(stmt);
+
+   return success;
+}
+
+long cDbMySqlStatement::affectedRows()
+{
+   return mysql_stmt_affected_rows(stmt);
+}
+
+long cDbMySqlStatement::resultCount()
+{
+   mysql_stmt_store_result(stmt);
+
+   return mysql_stmt_affected_rows(stmt);
+}
+
+int cDbMySqlStatement::paramCount()
+{
+   return stmt ? mysql_stmt_param_count(stmt) : 0;
+}
+
+const char* cDbMySqlStatement::error()
+{
+   return stmt ? mysql_stmt_error(stmt) : "";
+}
+
+//***************************************************************************
+// MySQL Engine
+//***************************************************************************
+
+int cDbMySqlEngine::open(const char* host, int port, const char* name,
+                         const char* user, const char* pass, const char* encoding)
+{
+   static int first = yes;
+
+   tell(0, "Calling mysql_init(%ld)", syscall(__NR_gettid));
+
+   if (!(mysql = mysql_init(0)))
+      return fail;
+
+   if (!mysql_real_connect(mysql, host, user, pass, name, port, 0, 0))
+   {
+      tell(0, "Error, connecting to database at '%s' on port (%d) failed; %s",
+           host, port, mysql_error(mysql));
+      close();
+      return fail;
+   }
+
+   schema = name ? name : "";
+
+   // init encoding
+
+   if (encoding && *encoding)
+   {
+      if (mysql_set_character_set(mysql, encoding))
+         tell(0, "SQL-Error in 'init(character_set)' - %s", mysql_error(mysql));
+
+      if (first)
+      {
+         tell(0, "SQL client character now '%s'", mysql_character_set_name(mysql));
+         first = no;
+      }
+   }
+
+   return success;
+}
+
+void cDbMySqlEngine::close()
+{
+   if (mysql)
+   {
+      tell(0, "Closing mysql connection and calling mysql_thread_end(%ld)", syscall(__NR_gettid));
+
+      mysql_close(mysql);
+      mysql_thread_end();
+      mysql = 0;
+   }
+}
+
+int cDbMySqlEngine::query(const char* statement)
+{
+   return mysql_query(mysql, statement) ? fail : success;
+}
+
+int cDbMySqlEngine::getResult(cDbRows& rows)
+{
+   MYSQL_RES* res;
+   MYSQL_ROW data;
+
+   rows.clear();
+
+   if (!(res = mysql_store_result(mysql)))
+      return mysql_errno(mysql) ? fail : success;
+
+   int fields = mysql_num_fields(res);
+
+   while ((data = mysql_fetch_row(res)))
+   {
+      std::vector<std::string> row;
+
+      for (int i = 0; i < fields; i++)
+         row.push_back(data[i] ? data[i] : "");
+
+      rows.push_back(row);
+   }
+
+   mysql_free_result(res);
+
+   return success;
+}
+
+void cDbMySqlEngine::freeResult()
+{
+   MYSQL_RES* result = mysql_use_result(mysql);
+   mysql_free_result(result);
+}
+
+long cDbMySqlEngine::lastInsertId()
+{
+   MYSQL_RES* result = 0;
+   long insertId = na;
+
+   if ((result = mysql_store_result(mysql)) == 0 &&
+       mysql_field_count(mysql) == 0 &&
+       mysql_insert_id(mysql) != 0)
+   {
+      insertId = mysql_insert_id(mysql);
+   }
+
+   mysql_free_result(result);
+
+   return insertId;
+}
+
+std::string cDbMySqlEngine::escape(const char* str)
+{
+   std::string result = "";
+
+   int length = strlen(str);
+   int bufferSize = length*2 + TB;
+
+   char* buffer = (char*)malloc(bufferSize);
+   mysql_real_escape_string(mysql, buffer, str, length);
+   result = buffer;
+   free(buffer);
+
+   return result;
+}
+
+int cDbMySqlEngine::tableExists(const char* name)
+{
+   MYSQL_RES* result = mysql_list_tables(mysql, name);
+   MYSQL_ROW tabRow = mysql_fetch_row(result);
+   mysql_free_result(result);
+
+   return tabRow ? yes : no;
+}
+
+int cDbMySqlEngine::getColumns(const char* table, cDbColumns& columns)
+{
+   char* select;
+   cDbRows rows;
+
+   asprintf(&select, "select column_name, column_type, column_comment"
+            " from information_schema.columns"
+            " where table_name = '%s' and table_schema = '%s'", table, schema.c_str());
+
+   int status = query(select);
+   free(select);
+
+   if (status != success || getResult(rows) != success)
+      return fail;
+
+   for (uint i = 0; i < rows.size(); i++)
+   {
+      columns[rows[i][0]].columnFormat = rows[i][1];
+      columns[rows[i][0]].description = rows[i][2];
+   }
+
+   return success;
+}
+
+int cDbMySqlEngine::getIndexFieldCount(const char* table, const char* index, int& count)
+{
+   enum IndexQueryFields
+   {
+      idTable,
+      idNonUnique,
+      idKeyName,
+      idSeqInIndex,
+      idColumnName
+   };
+
+   char* statement;
+   cDbRows rows;
+
+   count = 0;
+
+   asprintf(&statement, "show index from %s", table);
+
+   int status = query(statement);
+   free(statement);
+
+   if (status != success || getResult(rows) != success)
+      return fail;
+
+   for (uint i = 0; i < rows.size(); i++)
+   {
+      tell(5, "%s:  %-20s %s %s",
+           rows[i][idTable].c_str(), rows[i][idKeyName].c_str(),
+           rows[i][idSeqInIndex].c_str(), rows[i][idColumnName].c_str());
+
+      if (strcasecmp(rows[i][idKeyName].c_str(), index) == 0)
+         count++;
+   }
+
+   return success;
+}
+
+int cDbMySqlEngine::isConnectionError(int error)
+{
+   return error == CR_SERVER_LOST ||
+      error == CR_SERVER_GONE_ERROR ||
+      error == CR_INVALID_CONN_HANDLE ||
+      error == CR_COMMANDS_OUT_OF_SYNC ||
+      error == CR_SERVER_LOST_EXTENDED ||
+      error == CR_STMT_CLOSED ||
+      error == CR_CONN_UNKNOW_PROTOCOL ||
+      error == CR_UNSUPPORTED_PARAM_TYPE ||
+      error == CR_NO_PREPARE_STMT ||
+      error == CR_SERVER_HANDSHAKE_ERR ||
+      error == CR_WRONG_HOST_INFO ||
+      error == CR_OUT_OF_MEMORY ||
+      error == CR_IPSOCK_ERROR ||
+      error == CR_SOCKET_CREATE_ERROR ||
+      error == CR_CONNECTION_ERROR ||
+      error == CR_TCP_CONNECTION ||
+      error == CR_PARAMS_NOT_BOUND ||
+      error == CR_CONN_HOST_ERROR ||
+      error == CR_SSL_CONNECTION_ERROR;
+
+      // to be continued - not all errors should result in a reconnect ...
+}
@@ -0,0 +1,315 @@
+/*
+ * dbengine.h
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#ifndef __DBENGINE_H
+#define __DBENGINE_H
+
+#include <mysql/mysql.h>
+
+#ifdef USESQLITE
+#  include <sqlite3.h>
+#endif
+
+#include <string>
+#include <vector>
+#include <map>
+
+#include "common.h"
+#include "dbdict.h"
+
+//***************************************************************************
+// Engine Types
+//***************************************************************************
+
+typedef std::vector<std::vector<std::string> > cDbRows;   // rows of a plain query, NULL as ""
+
+struct cDbColumnInfo
+{
+   std::string columnFormat;
+   std::string description;
+};
+
+typedef std::map<std::string, cDbColumnInfo, _casecmp_> cDbColumns;
+
+//***************************************************************************
+// Engine Statement
+//   - prepared statement of a storage engine, the values are exchanged
+//     via the MYSQL_BIND arrays of cDbStatement for all engines
+//***************************************************************************
+
+class cDbEngineStatement
+{
+   public:
+
+      virtual ~cDbEngineStatement() {}
+
+      virtual int prepare(const char* sql, MYSQL_BIND* inBind, int inCount,
+                          MYSQL_BIND* outBind, int outCount, int streamRows) = 0;
+      virtual int execute() = 0;
+      virtual int storeResult() = 0;
+      virtual int fetch() = 0;              // yes, no if no more rows, fail on error
+      virtual int freeResult() = 0;
+      virtual long affectedRows() = 0;
+      virtual long resultCount() = 0;       // rows of the whole result
+      virtual int paramCount() = 0;
+      virtual const char* error() = 0;
+};
+
+//***************************************************************************
+// Engine
+//   - the storage specific part of cDbConnection, the dialect differences
+//     needed by the dictionary driven create/validate logic are queried
+//     via hasFeature()
+//***************************************************************************
+
+class cDbEngine
+{
+   public:
+
+      enum Type
+      {
+         etUnknown = na,
+
+         etMySql,
+         etSqlite,
+
+         etCount
+      };
+
+      enum Feature
+      {
+         efComments,          // column comments
+         efTableOptions,      // 'ENGINE ...' clause of create table
+         efPartitions,        // range partitions
+         efAlterModify,       // 'alter table ... modify column'
+         efColumnPosition,    // 'alter table ... add column ... after'
+         efUnsigned,          // 'unsigned' attribute of integer columns
+         efInlineAutoinc,     // autoinc only as 'integer primary key autoincrement'
+         efDisableKeys        // 'alter table ... disable keys' and 'unique_checks' for bulk loads
+      };
+
+      virtual ~cDbEngine() {}
+
+      virtual int getType() = 0;
+      virtual int open(const char* host, int port, const char* name,
+                       const char* user, const char* pass, const char* encoding) = 0;
+      virtual void close() = 0;
+      virtual int isOpen() = 0;
+      virtual cDbEngineStatement* createStatement() = 0;
+
+      // plain queries
+
+      virtual int query(const char* statement) = 0;
+      virtual int getResult(cDbRows& rows) = 0;         // result of the last query
+      virtual void freeResult() = 0;
+      virtual long lastInsertId() = 0;
+      virtual std::string escape(const char* str) = 0;
+
+      // transactions
+
+      virtual int startTransaction() = 0;
+      virtual int commit() = 0;
+      virtual int rollback() = 0;
+      virtual int flush()                               { return done; }
+
+      // schema
+
+      virtual int tableExists(const char* name) = 0;
+      virtual int getColumns(const char* table, cDbColumns& columns) = 0;
+      virtual int getIndexFieldCount(const char* table, const char* index, int& count) = 0;
+      virtual int hasFeature(int feature) = 0;
+
+      // errors
+
+      virtual int errorNo() = 0;
+      virtual const char* errorText() = 0;
+      virtual int isConnectionError(int error) = 0;
+
+      // statics
+
+      static cDbEngine* create(int type);
+      static int libraryInit(int type);
+      static void libraryEnd(int type);
+      static int toType(const char* name);
+      static const char* toName(int type);
+};
+
+//***************************************************************************
+// MySQL Engine
+//***************************************************************************
+
+class cDbMySqlStatement : public cDbEngineStatement
+{
+   public:
+
+      cDbMySqlStatement(MYSQL* aMysql)   { mysql = aMysql; stmt = 0; }
+      virtual ~cDbMySqlStatement();
+
+      virtual int prepare(const char* sql, MYSQL_BIND* inBind, int inCount,
+                          MYSQL_BIND* outBind, int outCount, int streamRows);
+      virtual int execute();
+      virtual int storeResult();
+      virtual int fetch();
+      virtual int freeResult();
+      virtual long affectedRows();
+      virtual long resultCount();
+      virtual int paramCount();
+      virtual const char* error();
+
+   private:
+
+      MYSQL* mysql;
+      MYSQL_STMT* stmt;
+};
+
+class cDbMySqlEngine : public cDbEngine
+{
+   public:
+
+      cDbMySqlEngine()   { mysql = 0; }
+      virtual ~cDbMySqlEngine()  { close(); }
+
+      virtual int getType()                   { return etMySql; }
+      virtual int open(const char* host, int port, const char* name,
+                       const char* user, const char* pass, const char* encoding);
+      virtual void close();
+      virtual int isOpen()                    { return mysql != 0; }
+      virtual cDbEngineStatement* createStatement()  { return new cDbMySqlStatement(mysql); }
+
+      virtual int query(const char* statement);
+      virtual int getResult(cDbRows& rows);
+      virtual void freeResult();
+      virtual long lastInsertId();
+      virtual std::string escape(const char* str);
+
+      virtual int startTransaction()          { return query("START TRANSACTION"); }
+      virtual int commit()                    { return query("COMMIT"); }
+      virtual int rollback()                  { return query("ROLLBACK"); }
+
+      virtual int tableExists(const char* name);
+      virtual int getColumns(const char* table, cDbColumns& columns);
+      virtual int getIndexFieldCount(const char* table, const char* index, int& count);
+      virtual int hasFeature(int feature)     { return yes; }
+
+      virtual int errorNo()                   { return mysql ? mysql_errno(mysql) : 0; }
+      virtual const char* errorText()         { return mysql ? mysql_error(mysql) : ""; }
+      virtual int isConnectionError(int error);
+
+   private:
+
+      MYSQL* mysql;
+      std::string schema;
+};
+
+//***************************************************************************
+// SQLite Engine
+//   - WAL journal, write statements outside an explicit transaction are
+//     collected in one transaction until 'batchRows' rows or 'batchTime'
+//     milliseconds are reached or flush() is called
+//***************************************************************************
+
+#ifdef USESQLITE
+
+class cDbSqliteEngine;
+
+class cDbSqliteStatement : public cDbEngineStatement
+{
+   public:
+
+      cDbSqliteStatement(cDbSqliteEngine* aEngine);
+      virtual ~cDbSqliteStatement();
+
+      virtual int prepare(const char* sql, MYSQL_BIND* inBind, int inCount,
+                          MYSQL_BIND* outBind, int outCount, int streamRows);
+      virtual int execute();
+      virtual int storeResult()              { return success; }
+      virtual int fetch();
+      virtual int freeResult();
+      virtual long affectedRows()            { return affected; }
+      virtual long resultCount();
+      virtual int paramCount();
+      virtual const char* error();
+
+   private:
+
+      int bindParameters();
+      void readRow();
+
+      cDbSqliteEngine* engine;
+      sqlite3_stmt* stmt;
+      int generation;
+      MYSQL_BIND* inBind;
+      int inCount;
+      MYSQL_BIND* outBind;
+      int outCount;
+      int pending;                           // stepped row not fetched yet
+      int active;                            // positioned inside the result
+      long rows;                             // rows stepped since execute
+      long affected;
+};
+
+class cDbSqliteEngine : public cDbEngine
+{
+   public:
+
+      cDbSqliteEngine();
+      virtual ~cDbSqliteEngine()             { close(); }
+
+      virtual int getType()                  { return etSqlite; }
+      virtual int open(const char* host, int port, const char* name,
+                       const char* user, const char* pass, const char* encoding);
+      virtual void close();
+      virtual int isOpen()                   { return db != 0; }
+      virtual cDbEngineStatement* createStatement()  { return new cDbSqliteStatement(this); }
+
+      virtual int query(const char* statement);
+      virtual int getResult(cDbRows& rows);
+      virtual void freeResult()              { result.clear(); }
+      virtual long lastInsertId()            { return db ? sqlite3_last_insert_rowid(db) : na; }
+      virtual std::string escape(const char* str);
+
+      virtual int startTransaction();
+      virtual int commit();
+      virtual int rollback();
+      virtual int flush();
+
+      virtual int tableExists(const char* name);
+      virtual int getColumns(const char* table, cDbColumns& columns);
+      virtual int getIndexFieldCount(const char* table, const char* index, int& count);
+      virtual int hasFeature(int feature)    { return feature == efInlineAutoinc; }
+
+      virtual int errorNo()                  { return db ? sqlite3_errcode(db) : 0; }
+      virtual const char* errorText()        { return db ? sqlite3_errmsg(db) : ""; }
+      virtual int isConnectionError(int error);
+
+      sqlite3* getDb()                       { return db; }
+      int getGeneration()                    { return generation; }
+      int beforeWrite();
+      int afterWrite(int rows);
+
+      static const char* dataDir;            // for database names without path
+      static int batchRows;
+      static int batchTime;                  // [ms]
+
+   private:
+
+      int exec(const char* statement);
+      static void registerFunctions(sqlite3* db);
+
+      sqlite3* db;
+      int generation;                        // incremented on each open, invalidates old statements
+      cDbRows result;
+      int inTact;
+      int inBatch;
+      int batchCount;
+      uint64_t batchStart;
+};
+
+#endif // USESQLITE
+
+//***************************************************************************
+#endif //__DBENGINE_H
@@ -0,0 +1,681 @@
+/*
+ * dbsqlite.c
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#include <algorithm>
+
+#include "dbengine.h"
+
+//***************************************************************************
+// SQLite Engine
+//***************************************************************************
+
+const char* cDbSqliteEngine::dataDir = "/var/lib/p4d";
+int cDbSqliteEngine::batchRows = 500;
+int cDbSqliteEngine::batchTime = 1000;
+
+//***************************************************************************
+// Time Helper
+//   - DATETIME values are stored as text 'YYYY-MM-DD HH:MM:SS' in local
+//     time, this way they compare and sort like they do on MySQL
+//***************************************************************************
+
+static void toSqlTime(time_t t, char* buf)
+{
+   struct tm tm;
+
+   localtime_r(&t, &tm);
+   strftime(buf, 20+TB, "%Y-%m-%d %H:%M:%S", &tm);
+}
+
+static time_t fromSqlTime(const char* s)
+{
+   struct tm tm;
+
+   memset(&tm, 0, sizeof(tm));
+
+   if (!s || sscanf(s, "%d-%d-%d %d:%d:%d", &tm.tm_year, &tm.tm_mon, &tm.tm_mday,
+                    &tm.tm_hour, &tm.tm_min, &tm.tm_sec) < 3)
+      return 0;
+
+   tm.tm_year -= 1900;
+   tm.tm_mon--;
+   tm.tm_isdst = -1;
+
+   return mktime(&tm);
+}
+
+//***************************************************************************
+// MySQL compatible functions used in the statements of p4d
+//***************************************************************************
+
+static void sqlFromUnixtime(sqlite3_context* context, int argc, sqlite3_value** argv)
+{
+   char buf[20+TB];
+
+   if (sqlite3_value_type(argv[0]) == SQLITE_NULL)
+      return sqlite3_result_null(context);
+
+   toSqlTime(sqlite3_value_int64(argv[0]), buf);
+   sqlite3_result_text(context, buf, -1, SQLITE_TRANSIENT);
+}
+
+static void sqlUnixTimestamp(sqlite3_context* context, int argc, sqlite3_value** argv)
+{
+   if (!argc)
+      return sqlite3_result_int64(context, time(0));
+
+   if (sqlite3_value_type(argv[0]) == SQLITE_NULL)
+      return sqlite3_result_null(context);
+
+   sqlite3_result_int64(context, fromSqlTime((const char*)sqlite3_value_text(argv[0])));
+}
+
+static void sqlNow(sqlite3_context* context, int argc, sqlite3_value** argv)
+{
+   char buf[20+TB];
+
+   toSqlTime(time(0), buf);
+   sqlite3_result_text(context, buf, -1, SQLITE_TRANSIENT);
+}
+
+void cDbSqliteEngine::registerFunctions(sqlite3* db)
+{
+   sqlite3_create_function(db, "from_unixtime", 1, SQLITE_UTF8, 0, sqlFromUnixtime, 0, 0);
+   sqlite3_create_function(db, "unix_timestamp", 0, SQLITE_UTF8, 0, sqlUnixTimestamp, 0, 0);
+   sqlite3_create_function(db, "unix_timestamp", 1, SQLITE_UTF8, 0, sqlUnixTimestamp, 0, 0);
+   sqlite3_create_function(db, "now", 0, SQLITE_UTF8, 0, sqlNow, 0, 0);
+   sqlite3_create_function(db, "sysdate", 0, SQLITE_UTF8, 0, sqlNow, 0, 0);
+}
+
+//***************************************************************************
+// Object
+//***************************************************************************
+
+cDbSqliteEngine::cDbSqliteEngine()
+{
+   db = 0;
+   generation = 0;
+   inTact = no;
+   inBatch = no;
+   batchCount = 0;
+   batchStart = 0;
+}
+
+//***************************************************************************
+// Open / Close
+//***************************************************************************
+
+int cDbSqliteEngine::open(const char* host, int port, const char* name,
+                          const char* user, const char* pass, const char* encoding)
+{
+   std::string file = name && *name ? name : "p4";
+
+   if (file[0] != '/' && file != ":memory:")
+      file = std::string(dataDir) + "/" + file + ".db";
+
+   tell(0, "Opening sqlite database '%s'", file.c_str());
+
+   if (sqlite3_open_v2(file.c_str(), &db, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, 0) != SQLITE_OK)
+   {
+      tell(0, "Error, opening sqlite database '%s' failed; %s", file.c_str(), sqlite3_errmsg(db));
+      sqlite3_close(db);
+      db = 0;
+      return fail;
+   }
+
+   generation++;
+
+   // WAL with 'synchronous normal' syncs only on checkpoints, readers
+   //   (like the web interface) don't block the writer
+
+   sqlite3_busy_timeout(db, 5000);
+
+   if (exec("PRAGMA journal_mode = WAL") != success || exec("PRAGMA synchronous = NORMAL") != success)
+      tell(0, "Warning: Switching sqlite database to WAL mode failed; %s", sqlite3_errmsg(db));
+
+   registerFunctions(db);
+
+   return success;
+}
+
+void cDbSqliteEngine::close()
+{
+   if (db)
+   {
+      tell(0, "Closing sqlite database");
+
+      flush();
+
+      // statements not finalized yet keep the handle as zombie until they are deleted
+
+      sqlite3_close_v2(db);
+      db = 0;
+      inTact = no;
+   }
+}
+
+//***************************************************************************
+// Exec - statement without result
+//***************************************************************************
+
+int cDbSqliteEngine::exec(const char* statement)
+{
+   return sqlite3_exec(db, statement, 0, 0, 0) == SQLITE_OK ? success : fail;
+}
+
+//***************************************************************************
+// Query
+//   - statement may contain multiple SQL statements (executeSqlFile), the
+//     rows of all of them are kept for getResult()
+//***************************************************************************
+
+int cDbSqliteEngine::query(const char* statement)
+{
+   const char* tail = statement;
+
+   result.clear();
+
+   while (tail && *tail)
+   {
+      sqlite3_stmt* stmt = 0;
+      int res;
+
+      if (sqlite3_prepare_v2(db, tail, -1, &stmt, &tail) != SQLITE_OK)
+         return fail;
+
+      if (!stmt)                 // only white space or comment left
+         break;
+
+      int columns = sqlite3_column_count(stmt);
+
+      while ((res = sqlite3_step(stmt)) == SQLITE_ROW)
+      {
+         std::vector<std::string> row;
+
+         for (int i = 0; i < columns; i++)
+         {
+            const char* value = (const char*)sqlite3_column_text(stmt, i);
+            row.push_back(value ? value : "");
+         }
+
+         result.push_back(row);
+      }
+
+      sqlite3_finalize(stmt);
+
+      if (res != SQLITE_DONE)
+         return fail;
+   }
+
+   return success;
+}
+
+int cDbSqliteEngine::getResult(cDbRows& rows)
+{
+   rows.swap(result);
+   result.clear();
+
+   return success;
+}
+
+std::string cDbSqliteEngine::escape(const char* str)
+{
+   std::string result = "";
+
+   for (const char* p = str; *p; p++)
+   {
+      if (*p == '\'')
+         result += '\'';
+
+      result += *p;
+   }
+
+   return result;
+}
+
+//***************************************************************************
+// Transactions
+//***************************************************************************
+
+int cDbSqliteEngine::startTransaction()
+{
+   flush();
+
+   if (exec("BEGIN IMMEDIATE") != success)
+      return fail;
+
+   inTact = yes;
+
+   return success;
+}
+
+int cDbSqliteEngine::commit()
+{
+   inTact = no;
+
+   return exec("COMMIT");
+}
+
+int cDbSqliteEngine::rollback()
+{
+   inTact = no;
+
+   return exec("ROLLBACK");
+}
+
+//***************************************************************************
+// Batch
+//   - one fsync per batch instead of per row is what makes the SD card
+//     survive, a crash loses at most the open batch
+//***************************************************************************
+
+int cDbSqliteEngine::beforeWrite()
+{
+   if (inTact || inBatch || batchRows <= 1)
+      return done;
+
+   if (exec("BEGIN IMMEDIATE") != success)
+      return fail;
+
+   inBatch = yes;
+   batchCount = 0;
+   batchStart = cTimeMs::Now();
+
+   return success;
+}
+
+int cDbSqliteEngine::afterWrite(int rows)
+{
+   if (!inBatch)
+      return done;
+
+   batchCount += rows;
+
+   if (batchCount >= batchRows || cTimeMs::Now() - batchStart >= (uint64_t)batchTime)
+      return flush();
+
+   return success;
+}
+
+int cDbSqliteEngine::flush()
+{
+   if (!inBatch)
+      return done;
+
+   inBatch = no;
+
+   tell(3, "Committing batch of %d rows", batchCount);
+
+   if (exec("COMMIT") != success)
+   {
+      tell(0, "SQL-Error in 'flush()' - %s", sqlite3_errmsg(db));
+      return fail;
+   }
+
+   return success;
+}
+
+//***************************************************************************
+// Schema
+//***************************************************************************
+
+int cDbSqliteEngine::tableExists(const char* name)
+{
+   sqlite3_stmt* stmt = 0;
+   int found = no;
+
+   if (sqlite3_prepare_v2(db, "select 1 from sqlite_master where type in ('table', 'view') and name = ?",
+                          -1, &stmt, 0) != SQLITE_OK)
+      return no;
+
+   sqlite3_bind_text(stmt, 1, name, -1, SQLITE_STATIC);
+   found = sqlite3_step(stmt) == SQLITE_ROW;
+   sqlite3_finalize(stmt);
+
+   return found ? yes : no;
+}
+
+int cDbSqliteEngine::getColumns(const char* table, cDbColumns& columns)
+{
+   char* statement;
+   cDbRows rows;
+
+   asprintf(&statement, "pragma table_info(%s)", table);
+
+   int status = query(statement);
+   free(statement);
+
+   if (status != success || getResult(rows) != success)
+      return fail;
+
+   // cid, name, type, notnull, dflt_value, pk - sqlite knows no comments
+
+   for (uint i = 0; i < rows.size(); i++)
+      columns[rows[i][1]].columnFormat = rows[i][2];
+
+   return success;
+}
+
+int cDbSqliteEngine::getIndexFieldCount(const char* table, const char* index, int& count)
+{
+   char* statement;
+   cDbRows rows;
+
+   count = 0;
+
+   asprintf(&statement, "pragma index_info(%s)", index);
+
+   int status = query(statement);
+   free(statement);
+
+   if (status != success || getResult(rows) != success)
+      return fail;
+
+   count = rows.size();
+
+   return success;
+}
+
+int cDbSqliteEngine::isConnectionError(int error)
+{
+   return error == SQLITE_CANTOPEN || error == SQLITE_NOTADB || error == SQLITE_IOERR;
+}
+
+//***************************************************************************
+// SQLite Statement
+//***************************************************************************
+
+cDbSqliteStatement::cDbSqliteStatement(cDbSqliteEngine* aEngine)
+{
+   engine = aEngine;
+   stmt = 0;
+   generation = 0;
+   inBind = 0;
+   inCount = 0;
+   outBind = 0;
+   outCount = 0;
+   pending = no;
+   active = no;
+   rows = 0;
+   affected = 0;
+}
+
+cDbSqliteStatement::~cDbSqliteStatement()
+{
+   sqlite3_finalize(stmt);
+}
+
+//***************************************************************************
+// Prepare
+//***************************************************************************
+
+int cDbSqliteStatement::prepare(const char* sql, MYSQL_BIND* aInBind, int aInCount,
+                                MYSQL_BIND* aOutBind, int aOutCount, int streamRows)
+{
+   inBind = aInBind;
+   inCount = aInCount;
+   outBind = aOutBind;
+   outCount = aOutCount;
+   generation = engine->getGeneration();
+
+   // rows are always read one by one, nothing to do for streaming
+
+   return sqlite3_prepare_v2(engine->getDb(), sql, -1, &stmt, 0) == SQLITE_OK ? success : fail;
+}
+
+//***************************************************************************
+// Bind Parameters
+//***************************************************************************
+
+int cDbSqliteStatement::bindParameters()
+{
+   int res = SQLITE_OK;
+
+   sqlite3_reset(stmt);
+   sqlite3_clear_bindings(stmt);
+
+   for (int i = 0; i < inCount && res == SQLITE_OK; i++)
+   {
+      MYSQL_BIND* b = &inBind[i];
+
+      if (b->is_null && *b->is_null)
+      {
+         res = sqlite3_bind_null(stmt, i+1);
+         continue;
+      }
+
+      switch (b->buffer_type)
+      {
+         case MYSQL_TYPE_LONG:
+         {
+            sqlite3_int64 v = b->is_unsigned ? (sqlite3_int64)*(unsigned int*)b->buffer : *(int*)b->buffer;
+            res = sqlite3_bind_int64(stmt, i+1, v);
+            break;
+         }
+         case MYSQL_TYPE_LONGLONG:
+         {
+            res = sqlite3_bind_int64(stmt, i+1, *(sqlite3_int64*)b->buffer);
+            break;
+         }
+         case MYSQL_TYPE_FLOAT:
+         {
+            res = sqlite3_bind_double(stmt, i+1, *(float*)b->buffer);
+            break;
+         }
+         case MYSQL_TYPE_DATETIME:
+         {
+            MYSQL_TIME* t = (MYSQL_TIME*)b->buffer;
+            char buf[100+TB];
+
+            sprintf(buf, "%04u-%02u-%02u %02u:%02u:%02u", t->year, t->month, t->day,
+                    t->hour, t->minute, t->second);
+            res = sqlite3_bind_text(stmt, i+1, buf, -1, SQLITE_TRANSIENT);
+            break;
+         }
+         case MYSQL_TYPE_BLOB:
+         {
+            res = sqlite3_bind_blob(stmt, i+1, b->buffer, b->length ? *b->length : 0, SQLITE_STATIC);
+            break;
+         }
+         default:    // MYSQL_TYPE_STRING
+         {
+            res = sqlite3_bind_text(stmt, i+1, (const char*)b->buffer,
+                                    b->length ? *b->length : -1, SQLITE_STATIC);
+            break;
+         }
+      }
+   }
+
+   return res == SQLITE_OK ? success : fail;
+}
+
+//***************************************************************************
+// Read Row - copy the current row to the out bindings
+//***************************************************************************
+
+void cDbSqliteStatement::readRow()
+{
+   int columns = sqlite3_column_count(stmt);
+
+   for (int i = 0; i < outCount && i < columns; i++)
+   {
+      MYSQL_BIND* b = &outBind[i];
+      int type = sqlite3_column_type(stmt, i);
+
+      if (b->is_null)
+         *b->is_null = type == SQLITE_NULL;
+
+      if (type == SQLITE_NULL)
+         continue;
+
+      switch (b->buffer_type)
+      {
+         case MYSQL_TYPE_LONG:     *(int*)b->buffer = (int)sqlite3_column_int64(stmt, i);       break;
+         case MYSQL_TYPE_LONGLONG: *(int64_t*)b->buffer = sqlite3_column_int64(stmt, i);        break;
+         case MYSQL_TYPE_FLOAT:    *(float*)b->buffer = (float)sqlite3_column_double(stmt, i);  break;
+
+         case MYSQL_TYPE_DATETIME:
+         {
+            MYSQL_TIME* mt = (MYSQL_TIME*)b->buffer;
+            time_t t = type == SQLITE_TEXT ? fromSqlTime((const char*)sqlite3_column_text(stmt, i))
+               : (time_t)sqlite3_column_int64(stmt, i);
+            struct tm tm;
+
+            localtime_r(&t, &tm);
+            memset(mt, 0, sizeof(MYSQL_TIME));
+            mt->year = tm.tm_year + 1900;
+            mt->month = tm.tm_mon + 1;
+            mt->day = tm.tm_mday;
+            mt->hour = tm.tm_hour;
+            mt->minute = tm.tm_min;
+            mt->second = tm.tm_sec;
+
+            break;
+         }
+
+         default:    // MYSQL_TYPE_STRING, MYSQL_TYPE_BLOB
+         {
+            const void* data = b->buffer_type == MYSQL_TYPE_BLOB ? sqlite3_column_blob(stmt, i)
+               : (const void*)sqlite3_column_text(stmt, i);
+            unsigned long size = sqlite3_column_bytes(stmt, i);
+            unsigned long n = std::min(size, b->buffer_length);
+
+            // the value is truncated to the buffer, other than MySQL the
+            //   length is the one copied, users of the size (like the
+            //   export) stay inside the buffer
+
+            memcpy(b->buffer, data, n);
+            ((char*)b->buffer)[n] = 0;     // cDbValue reserves TB
+
+            if (b->length)
+               *b->length = n;
+
+            break;
+         }
+      }
+   }
+}
+
+//***************************************************************************
+// Execute
+//***************************************************************************
+
+int cDbSqliteStatement::execute()
+{
+   int readonly;
+   int res;
+
+   pending = no;
+   active = no;
+   rows = 0;
+   affected = 0;
+
+   if (generation != engine->getGeneration() || !engine->isOpen())
+   {
+      tell(0, "Error: Statement prepared on a closed sqlite connection");
+      return fail;
+   }
+
+   if (bindParameters() != success)
+      return fail;
+
+   readonly = sqlite3_stmt_readonly(stmt);
+
+   if (!readonly)
+      engine->beforeWrite();
+
+   res = sqlite3_step(stmt);
+
+   if (res == SQLITE_ROW)
+   {
+      pending = yes;
+      active = yes;
+      rows = 1;
+      affected = 1;         // without buffering the whole result only 'has rows' is known
+   }
+   else if (res == SQLITE_DONE)
+   {
+      affected = readonly ? 0 : sqlite3_changes(engine->getDb());
+      sqlite3_reset(stmt);
+   }
+   else
+   {
+      sqlite3_reset(stmt);
+      return fail;
+   }
+
+   if (!readonly)
+      engine->afterWrite(affected);
+
+   return success;
+}
+
+//***************************************************************************
+// Fetch
+//***************************************************************************
+
+int cDbSqliteStatement::fetch()
+{
+   if (pending)
+   {
+      pending = no;
+      readRow();
+
+      return yes;
+   }
+
+   int res = sqlite3_step(stmt);
+
+   if (res == SQLITE_ROW)
+   {
+      rows++;
+      readRow();
+
+      return yes;
+   }
+
+   // end of result, release the read snapshot
+
+   active = no;
+   sqlite3_reset(stmt);
+
+   return res == SQLITE_DONE ? no : fail;
+}
+
+int cDbSqliteStatement::freeResult()
+{
+   pending = no;
+   active = no;
+   sqlite3_reset(stmt);
+
+   return success;
+}
+
+long cDbSqliteStatement::resultCount()
+{
+   long count = rows;
+
+   if (active)
+   {
+      while (sqlite3_step(stmt) == SQLITE_ROW)
+         count++;
+   }
+
+   freeResult();
+
+   return count;
+}
+
+int cDbSqliteStatement::paramCount()
+{
+   return stmt ? sqlite3_bind_parameter_count(stmt) : 0;
+}
+
+const char* cDbSqliteStatement::error()
+{
+   return sqlite3_errmsg(engine->getDb());
+}
@@ -0,0 +1,305 @@
+/*
+ * eventloop.c
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/eventfd.h>
+
+#include "eventloop.h"
+
+//***************************************************************************
+// Object
+//***************************************************************************
+
+cEventLoop::cEventLoop()
+{
+   epollFd = na;
+   eventFd = na;
+   wokenUp = no;
+   timerCount = 0;
+   watchCount = 0;
+}
+
+cEventLoop::~cEventLoop()
+{
+   close();
+}
+
+//***************************************************************************
+// Open / Close
+//***************************************************************************
+
+int cEventLoop::open()
+{
+   struct epoll_event ev;
+
+   if (isOpen())
+      return done;
+
+   if ((epollFd = epoll_create1(EPOLL_CLOEXEC)) < 0)
+   {
+      tell(0, "Error: Creating epoll instance failed, %s", strerror(errno));
+      return fail;
+   }
+
+   if ((eventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0)
+   {
+      tell(0, "Error: Creating eventfd failed, %s", strerror(errno));
+      close();
+      return fail;
+   }
+
+   memset(&ev, 0, sizeof(ev));
+   ev.events = EPOLLIN;
+   ev.data.fd = eventFd;
+   epoll_ctl(epollFd, EPOLL_CTL_ADD, eventFd, &ev);
+
+   return success;
+}
+
+int cEventLoop::close()
+{
+   for (int i = 0; i < timerCount; i++)
+      ::close(timers[i].fd);
+
+   if (eventFd >= 0)
+      ::close(eventFd);
+
+   if (epollFd >= 0)
+      ::close(epollFd);
+
+   epollFd = na;
+   eventFd = na;
+   timerCount = 0;
+   watchCount = 0;
+
+   return success;
+}
+
+//***************************************************************************
+// Add Timer
+//***************************************************************************
+
+int cEventLoop::addTimer(int clock)
+{
+   struct epoll_event ev;
+   int fd;
+
+   if (!isOpen() || timerCount >= maxTimers)
+      return fail;
+
+   if ((fd = timerfd_create(clock, TFD_NONBLOCK | TFD_CLOEXEC)) < 0)
+   {
+      tell(0, "Error: Creating timerfd failed, %s", strerror(errno));
+      return fail;
+   }
+
+   memset(&ev, 0, sizeof(ev));
+   ev.events = EPOLLIN;
+   ev.data.fd = fd;
+   epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev);
+
+   timers[timerCount].fd = fd;
+   timers[timerCount].clock = clock;
+   timers[timerCount].fired = no;
+
+   return timerCount++;
+}
+
+//***************************************************************************
+// Set Timer / Interval
+//***************************************************************************
+
+int cEventLoop::setTimer(int timer, time_t at)
+{
+   struct itimerspec spec;
+   int flags = TFD_TIMER_ABSTIME;
+
+   if (timer < 0 || timer >= timerCount)
+      return fail;
+
+   memset(&spec, 0, sizeof(spec));
+   spec.it_value.tv_sec = at;
+
+   // time(0) reads the coarse clock which lags up to one tick, fire after
+   // it reached 'at' too, otherwise the caller sees the deadline not yet passed
+
+   if (at && timers[timer].clock == CLOCK_REALTIME)
+   {
+      struct timespec res;
+
+      if (clock_getres(CLOCK_REALTIME_COARSE, &res) == 0 && !res.tv_sec)
+         spec.it_value.tv_nsec = res.tv_nsec;
+
+      flags |= TFD_TIMER_CANCEL_ON_SET;
+   }
+
+   if (timerfd_settime(timers[timer].fd, flags, &spec, 0) < 0)
+   {
+      tell(0, "Error: Setting timer failed, %s", strerror(errno));
+      return fail;
+   }
+
+   return success;
+}
+
+int cEventLoop::setInterval(int timer, int ms)
+{
+   struct itimerspec spec;
+
+   if (timer < 0 || timer >= timerCount)
+      return fail;
+
+   memset(&spec, 0, sizeof(spec));
+   spec.it_value.tv_sec = ms / 1000;
+   spec.it_value.tv_nsec = (ms % 1000) * 1000000L;
+   spec.it_interval = spec.it_value;
+
+   if (timerfd_settime(timers[timer].fd, 0, &spec, 0) < 0)
+   {
+      tell(0, "Error: Setting timer failed, %s", strerror(errno));
+      return fail;
+   }
+
+   return success;
+}
+
+int cEventLoop::isFired(int timer)
+{
+   if (timer < 0 || timer >= timerCount)
+      return no;
+
+   return timers[timer].fired;
+}
+
+//***************************************************************************
+// Add Fd
+//***************************************************************************
+
+int cEventLoop::addFd(int fd)
+{
+   struct epoll_event ev;
+
+   if (!isOpen() || fd < 0 || watchCount >= maxFds)
+      return fail;
+
+   memset(&ev, 0, sizeof(ev));
+   ev.events = EPOLLIN;
+   ev.data.fd = fd;
+
+   if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev) < 0)
+   {
+      tell(0, "Error: Adding fd %d to the event loop failed, %s", fd, strerror(errno));
+      return fail;
+   }
+
+   watches[watchCount].fd = fd;
+   watches[watchCount].ready = no;
+   watchCount++;
+
+   return success;
+}
+
+int cEventLoop::isReady(int fd)
+{
+   for (int i = 0; i < watchCount; i++)
+   {
+      if (watches[i].fd == fd)
+         return watches[i].ready;
+   }
+
+   return no;
+}
+
+//***************************************************************************
+// Wakeup
+//***************************************************************************
+
+int cEventLoop::wakeup()
+{
+   uint64_t one = 1;
+
+   if (eventFd < 0)
+      return fail;
+
+   return write(eventFd, &one, sizeof(one)) == sizeof(one) ? success : fail;
+}
+
+//***************************************************************************
+// Wait
+//   - blocks until a timer fires, a watched fd gets readable, wakeup()
+//     is called or 'timeoutMs' passed (na -> no timeout), the flags of
+//     the last wait are queried by isFired(), isReady() and isWokenUp()
+//***************************************************************************
+
+int cEventLoop::wait(int timeoutMs)
+{
+   struct epoll_event events[maxTimers + maxFds + 1];
+   uint64_t value;
+   int count;
+
+   wokenUp = no;
+
+   for (int i = 0; i < timerCount; i++)
+      timers[i].fired = no;
+
+   for (int i = 0; i < watchCount; i++)
+      watches[i].ready = no;
+
+   if (!isOpen())
+   {
+      usleep(timeoutMs >= 0 ? timeoutMs * 1000 : 100000);
+      return 0;
+   }
+
+   if ((count = epoll_wait(epollFd, events, maxTimers + maxFds + 1, timeoutMs)) < 0)
+   {
+      if (errno == EINTR)      // signal, the handler may have set a flag
+      {
+         wokenUp = yes;
+         return 0;
+      }
+
+      tell(0, "Error: epoll_wait failed, %s", strerror(errno));
+      return fail;
+   }
+
+   wakeups.inc();
+
+   for (int e = 0; e < count; e++)
+   {
+      int fd = events[e].data.fd;
+
+      if (fd == eventFd)
+      {
+         if (read(eventFd, &value, sizeof(value)) > 0)
+            wokenUp = yes;
+
+         continue;
+      }
+
+      for (int i = 0; i < timerCount; i++)
+      {
+         // a set of the clock cancels the timer with ECANCELED, handled as fired
+
+         if (timers[i].fd == fd)
+         {
+            if (read(fd, &value, sizeof(value)) > 0 || errno == ECANCELED)
+               timers[i].fired = yes;
+         }
+      }
+
+      for (int i = 0; i < watchCount; i++)
+      {
+         if (watches[i].fd == fd)
+            watches[i].ready = yes;
+      }
+   }
+
+   return count;
+}
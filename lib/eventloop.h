@@ -0,0 +1,83 @@
+/*
+ * eventloop.h
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#ifndef __LIB_EVENTLOOP__
+#define __LIB_EVENTLOOP__
+
+#include <time.h>
+
+#include "common.h"
+
+//***************************************************************************
+// Event Loop
+//   - one epoll instance for timers (timerfd), an eventfd to wake up the
+//     loop and further descriptors like the epoll instance of cHttpServer
+//   - timers of CLOCK_REALTIME are set to an absolute time_t like the
+//     deadlines of the daemon, if the clock is set (time sync) they fire
+//     at once so that the deadlines are checked again
+//   - wakeup() is async signal safe, for signal handlers and other threads
+//***************************************************************************
+
+class cEventLoop
+{
+   public:
+
+      enum Misc
+      {
+         maxTimers = 8,
+         maxFds = 8
+      };
+
+      cEventLoop();
+      ~cEventLoop();
+
+      int open();
+      int close();
+      int isOpen()  { return epollFd >= 0; }
+
+      int addTimer(int clock = CLOCK_REALTIME);     // returns the timer or fail
+      int setTimer(int timer, time_t at);           // absolute, 0 disarms
+      int setInterval(int timer, int ms);           // periodic, 0 disarms
+      int isFired(int timer);
+
+      int addFd(int fd);                            // watched for EPOLLIN
+      int isReady(int fd);
+
+      int wakeup();
+      int isWokenUp()  { return wokenUp; }
+
+      int wait(int timeoutMs = na);                 // returns the number of events, 0 on timeout
+
+      cCounter wakeups;
+
+   protected:
+
+      struct Timer
+      {
+         int fd;
+         int clock;
+         int fired;
+      };
+
+      struct Watch
+      {
+         int fd;
+         int ready;
+      };
+
+      int epollFd;
+      int eventFd;
+      int wokenUp;
+
+      Timer timers[maxTimers];
+      int timerCount;
+      Watch watches[maxFds];
+      int watchCount;
+};
+
+//***************************************************************************
+#endif // __LIB_EVENTLOOP__
@@ -0,0 +1,682 @@
+/*
+ * httpd.c
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <unistd.h>
+#include <stdint.h>
+
+#include "httpd.h"
+
+int cHttpServer::maxRequestSize = 8192;
+int cHttpServer::idleTimeout = 30;
+int cHttpServer::maxStreamBuffer = 1024*1024;
+
+//***************************************************************************
+// Request
+//***************************************************************************
+
+const char* cHttpServer::Request::param(const char* name, const char* def)
+{
+   std::map<std::string, std::string>::iterator it = params.find(name);
+
+   return it != params.end() ? it->second.c_str() : def;
+}
+
+const char* cHttpServer::Request::header(const char* name, const char* def)
+{
+   std::map<std::string, std::string>::iterator it = headers.find(name);
+
+   return it != headers.end() ? it->second.c_str() : def;
+}
+
+//***************************************************************************
+// Object
+//***************************************************************************
+
+cHttpServer::cHttpServer(Handler* aHandler)
+{
+   handler = aHandler;
+   listenFd = na;
+   epollFd = na;
+   lastIdleCheck = 0;
+}
+
+cHttpServer::~cHttpServer()
+{
+   close();
+}
+
+//***************************************************************************
+// Open / Close
+//***************************************************************************
+
+int cHttpServer::open(int port, const char* address)
+{
+   struct sockaddr_in addr;
+   struct epoll_event ev;
+   int on = 1;
+
+   if (isOpen())
+      return done;
+
+   memset(&addr, 0, sizeof(addr));
+   addr.sin_family = AF_INET;
+   addr.sin_port = htons(port);
+
+   if (inet_pton(AF_INET, address, &addr.sin_addr) != 1)
+   {
+      tell(0, "Error: Invalid address '%s' for the HTTP server", address);
+      return fail;
+   }
+
+   if ((listenFd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)) < 0)
+   {
+      tell(0, "Error: Creating socket failed, %s", strerror(errno));
+      return fail;
+   }
+
+   setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+   if (bind(listenFd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(listenFd, 16) < 0)
+   {
+      tell(0, "Error: Binding HTTP server to %s:%d failed, %s", address, port, strerror(errno));
+      close();
+      return fail;
+   }
+
+   if ((epollFd = epoll_create1(EPOLL_CLOEXEC)) < 0)
+   {
+      tell(0, "Error: Creating epoll instance failed, %s", strerror(errno));
+      close();
+      return fail;
+   }
+
+   memset(&ev, 0, sizeof(ev));
+   ev.events = EPOLLIN;
+   ev.data.fd = listenFd;
+   epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &ev);
+
+   tell(0, "HTTP server listening on %s:%d", address, port);
+
+   return success;
+}
+
+int cHttpServer::close()
+{
+   while (connections.size())
+      closeConnection(connections.begin()->first);
+
+   if (epollFd >= 0)
+      ::close(epollFd);
+
+   if (listenFd >= 0)
+      ::close(listenFd);
+
+   epollFd = na;
+   listenFd = na;
+
+   return success;
+}
+
+void cHttpServer::closeConnection(int fd)
+{
+   epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, 0);
+   ::close(fd);
+   connections.erase(fd);
+}
+
+//***************************************************************************
+// Poll
+//   - wait up to 'timeoutMs' for socket events and serve them,
+//     sleeps if the server isn't open
+//***************************************************************************
+
+int cHttpServer::poll(int timeoutMs)
+{
+   struct epoll_event events[32];
+   int count;
+
+   if (!isOpen())
+   {
+      usleep(timeoutMs * 1000);
+      return done;
+   }
+
+   if ((count = epoll_wait(epollFd, events, 32, timeoutMs)) < 0)
+   {
+      if (errno != EINTR)
+         tell(0, "Error: epoll_wait failed, %s", strerror(errno));
+
+      return fail;
+   }
+
+   for (int i = 0; i < count; i++)
+   {
+      int fd = events[i].data.fd;
+      std::map<int, Connection>::iterator it;
+
+      if (fd == listenFd)
+      {
+         acceptConnections();
+         continue;
+      }
+
+      if ((it = connections.find(fd)) == connections.end())
+         continue;
+
+      Connection* c = &it->second;
+
+      if (events[i].events & (EPOLLERR | EPOLLHUP))
+         closeConnection(fd);
+      else if (events[i].events & EPOLLIN && receive(fd, c) != success)
+         closeConnection(fd);
+      else if (events[i].events & EPOLLOUT && send(fd, c) != success)
+         closeConnection(fd);
+   }
+
+   checkIdle();
+
+   return success;
+}
+
+//***************************************************************************
+// Poll Timeout
+//   - [ms] until poll() has to check the idle connections, na if there
+//     is none
+//***************************************************************************
+
+int cHttpServer::pollTimeout()
+{
+   return connections.size() ? 1000 : na;
+}
+
+//***************************************************************************
+// Accept Connections
+//***************************************************************************
+
+int cHttpServer::acceptConnections()
+{
+   int fd;
+
+   while ((fd = accept4(listenFd, 0, 0, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0)
+   {
+      struct epoll_event ev;
+      Connection c;
+
+      c.sent = 0;
+      c.keepAlive = no;
+      c.stream = no;
+      c.lastActivity = time(0);
+
+      memset(&ev, 0, sizeof(ev));
+      ev.events = EPOLLIN;
+      ev.data.fd = fd;
+
+      if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev) < 0)
+      {
+         ::close(fd);
+         continue;
+      }
+
+      connections[fd] = c;
+   }
+
+   return success;
+}
+
+//***************************************************************************
+// Receive
+//   - fail -> close the connection
+//***************************************************************************
+
+int cHttpServer::receive(int fd, Connection* c)
+{
+   char buf[4096];
+   int n;
+
+   while ((n = read(fd, buf, sizeof(buf))) > 0)
+      c->in.append(buf, n);
+
+   if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK))
+      return fail;
+
+   c->lastActivity = time(0);
+
+   // nothing expected from the client of a stream
+
+   if (c->stream)
+   {
+      c->in = "";
+      return success;
+   }
+
+   // wait for the complete header, GET requests have no body
+
+   if (c->in.find("\r\n\r\n") == std::string::npos)
+   {
+      if ((int)c->in.length() > maxRequestSize)
+      {
+         c->keepAlive = no;
+         respond(c, 413, "", "text/plain");
+         return send(fd, c);
+      }
+
+      return success;
+   }
+
+   // one request at a time, ignore pipelined ones until the response is sent
+
+   if (c->out.length())
+      return success;
+
+   process(c);
+
+   return send(fd, c);
+}
+
+//***************************************************************************
+// Send
+//***************************************************************************
+
+int cHttpServer::send(int fd, Connection* c)
+{
+   struct epoll_event ev;
+   int n = 0;
+
+   while (c->sent < c->out.length())
+   {
+      // no SIGPIPE if the client is gone
+
+      if ((n = ::send(fd, c->out.c_str() + c->sent, c->out.length() - c->sent, MSG_NOSIGNAL)) < 0)
+         break;
+
+      c->sent += n;
+      c->lastActivity = time(0);
+   }
+
+   memset(&ev, 0, sizeof(ev));
+   ev.data.fd = fd;
+
+   if (c->sent < c->out.length())
+   {
+      if (errno != EAGAIN && errno != EWOULDBLOCK)
+         return fail;
+
+      // wait until the socket is writable again
+
+      ev.events = EPOLLOUT;
+      epoll_ctl(epollFd, EPOLL_CTL_MOD, fd, &ev);
+
+      return success;
+   }
+
+   if (!c->keepAlive)
+      return fail;
+
+   c->out = "";
+   c->sent = 0;
+   ev.events = EPOLLIN;
+   epoll_ctl(epollFd, EPOLL_CTL_MOD, fd, &ev);
+
+   if (c->stream)
+      return success;
+
+   // next request already received?
+
+   if (c->in.find("\r\n\r\n") != std::string::npos)
+   {
+      process(c);
+      return send(fd, c);
+   }
+
+   return success;
+}
+
+//***************************************************************************
+// Process
+//***************************************************************************
+
+int cHttpServer::process(Connection* c)
+{
+   Request request;
+   std::string body;
+   std::string contentType = "application/json";
+   size_t end = c->in.find("\r\n\r\n");
+   int status;
+
+   status = parseRequest(c->in.substr(0, end), &request);
+   c->in.erase(0, end + 4);
+
+   if (status != success)
+   {
+      c->keepAlive = no;
+      respond(c, 400, "", "text/plain");
+      return fail;
+   }
+
+   c->keepAlive = strcasecmp(request.header("connection"), "close") != 0;
+
+   if (request.method != "GET" && request.method != "HEAD")
+   {
+      respond(c, 405, "", "text/plain");
+      return fail;
+   }
+
+   status = handler->onHttpRequest(&request, body, contentType);
+
+   if (status != 200)
+   {
+      respond(c, status, body, contentType.c_str());
+      return done;
+   }
+
+   // event stream, open end without length
+
+   if (contentType == "text/event-stream")
+   {
+      c->stream = yes;
+      c->keepAlive = yes;
+      c->out = "HTTP/1.1 200 OK\r\n"
+         "Content-Type: text/event-stream\r\n"
+         "Cache-Control: no-cache\r\n"
+         "Connection: keep-alive\r\n"
+         "\r\n" + body;
+      c->sent = 0;
+
+      return done;
+   }
+
+   std::string etag = etagOf(body);
+
+   if (etag == request.header("if-none-match"))
+      respond(c, 304, "", 0, etag.c_str());
+   else
+      respond(c, 200, request.method == "HEAD" ? "" : body, contentType.c_str(), etag.c_str());
+
+   return done;
+}
+
+void cHttpServer::respond(Connection* c, int status, const std::string& body,
+                          const char* contentType, const char* etag)
+{
+   char* head;
+
+   asprintf(&head,
+            "HTTP/1.1 %d %s\r\n"
+            "Content-Length: %d\r\n"
+            "%s%s%s"
+            "%s%s%s"
+            "Cache-Control: no-cache\r\n"
+            "Connection: %s\r\n"
+            "\r\n",
+            status, statusText(status), (int)body.length(),
+            contentType ? "Content-Type: " : "", contentType ? contentType : "", contentType ? "\r\n" : "",
+            etag ? "ETag: " : "", etag ? etag : "", etag ? "\r\n" : "",
+            c->keepAlive ? "keep-alive" : "close");
+
+   c->out = head;
+   c->out += body;
+   c->sent = 0;
+
+   free(head);
+}
+
+//***************************************************************************
+// Broadcast
+//   - push an event to all streams
+//***************************************************************************
+
+int cHttpServer::broadcast(const char* event, const std::string& data)
+{
+   std::map<int, Connection>::iterator it;
+   std::vector<int> failed;
+   std::string message = std::string("event: ") + event + "\ndata: " + data + "\n\n";
+   int count = 0;
+
+   for (it = connections.begin(); it != connections.end(); it++)
+   {
+      Connection* c = &it->second;
+
+      if (!c->stream)
+         continue;
+
+      c->out.erase(0, c->sent);
+      c->sent = 0;
+      c->out += message;
+
+      if ((int)c->out.length() > maxStreamBuffer || send(it->first, c) != success)
+         failed.push_back(it->first);
+      else
+         count++;
+   }
+
+   for (unsigned int i = 0; i < failed.size(); i++)
+      closeConnection(failed[i]);
+
+   return count;
+}
+
+int cHttpServer::streamCount()
+{
+   std::map<int, Connection>::iterator it;
+   int count = 0;
+
+   for (it = connections.begin(); it != connections.end(); it++)
+      if (it->second.stream)
+         count++;
+
+   return count;
+}
+
+//***************************************************************************
+// Check Idle
+//   - close idle connections, streams get a comment to keep proxies quiet
+//***************************************************************************
+
+void cHttpServer::checkIdle()
+{
+   std::map<int, Connection>::iterator it;
+   std::vector<int> idle;
+   time_t now = time(0);
+
+   if (lastIdleCheck == now)
+      return;
+
+   lastIdleCheck = now;
+
+   for (it = connections.begin(); it != connections.end(); it++)
+   {
+      Connection* c = &it->second;
+
+      if (!c->stream && c->lastActivity < now - idleTimeout)
+         idle.push_back(it->first);
+
+      else if (c->stream && c->lastActivity < now - idleTimeout / 2)
+      {
+         c->out.erase(0, c->sent);
+         c->sent = 0;
+         c->out += ": keep-alive\n\n";
+
+         if (send(it->first, c) != success)
+            idle.push_back(it->first);
+      }
+   }
+
+   for (unsigned int i = 0; i < idle.size(); i++)
+      closeConnection(idle[i]);
+}
+
+//***************************************************************************
+// Parse Request
+//***************************************************************************
+
+int cHttpServer::parseRequest(const std::string& text, Request* request)
+{
+   size_t eol = text.find("\r\n");
+   std::string line = text.substr(0, eol);
+   size_t p1 = line.find(' ');
+   size_t p2 = line.rfind(' ');
+
+   if (p1 == std::string::npos || p2 == p1 || line.compare(p2+1, 5, "HTTP/") != 0)
+      return fail;
+
+   std::string target = line.substr(p1+1, p2-p1-1);
+   size_t q = target.find('?');
+
+   request->method = line.substr(0, p1);
+   request->path = urlDecode(target.substr(0, q));
+
+   // query parameters
+
+   if (q != std::string::npos)
+   {
+      std::string query = target.substr(q+1);
+      size_t pos = 0;
+
+      while (pos <= query.length())
+      {
+         size_t amp = query.find('&', pos);
+         std::string pair = query.substr(pos, amp == std::string::npos ? std::string::npos : amp-pos);
+         size_t eq = pair.find('=');
+
+         if (pair.length())
+         {
+            if (eq == std::string::npos)
+               request->params[urlDecode(pair)] = "";
+            else
+               request->params[urlDecode(pair.substr(0, eq))] = urlDecode(pair.substr(eq+1));
+         }
+
+         if (amp == std::string::npos)
+            break;
+
+         pos = amp + 1;
+      }
+   }
+
+   // header lines
+
+   while (eol != std::string::npos)
+   {
+      size_t start = eol + 2;
+      size_t colon;
+
+      eol = text.find("\r\n", start);
+      line = text.substr(start, eol == std::string::npos ? std::string::npos : eol-start);
+
+      if ((colon = line.find(':')) == std::string::npos)
+         continue;
+
+      std::string name = line.substr(0, colon);
+      std::string value = line.substr(colon+1);
+
+      for (size_t i = 0; i < name.length(); i++)
+         name[i] = tolower(name[i]);
+
+      value.erase(0, value.find_first_not_of(" \t"));
+      request->headers[name] = value;
+   }
+
+   return success;
+}
+
+std::string cHttpServer::urlDecode(const std::string& s)
+{
+   std::string result = "";
+
+   for (size_t i = 0; i < s.length(); i++)
+   {
+      if (s[i] == '+')
+         result += ' ';
+      else if (s[i] == '%' && i + 2 < s.length() && isxdigit(s[i+1]) && isxdigit(s[i+2]))
+      {
+         result += (char)strtol(s.substr(i+1, 2).c_str(), 0, 16);
+         i += 2;
+      }
+      else
+         result += s[i];
+   }
+
+   return result;
+}
+
+const char* cHttpServer::statusText(int status)
+{
+   switch (status)
+   {
+      case 200: return "OK";
+      case 304: return "Not Modified";
+      case 400: return "Bad Request";
+      case 404: return "Not Found";
+      case 405: return "Method Not Allowed";
+      case 413: return "Request Entity Too Large";
+      case 503: return "Service Unavailable";
+   }
+
+   return "Internal Server Error";
+}
+
+//***************************************************************************
+// JSON Escape
+//***************************************************************************
+
+std::string cHttpServer::jsonEscape(const char* s)
+{
+   std::string result = "\"";
+
+   for (; s && *s; s++)
+   {
+      switch (*s)
+      {
+         case '"':  result += "\\\""; break;
+         case '\\': result += "\\\\"; break;
+         case '\n': result += "\\n";  break;
+         case '\r': result += "\\r";  break;
+         case '\t': result += "\\t";  break;
+
+         default:
+         {
+            if ((unsigned char)*s < 0x20)
+            {
+               char buf[10];
+               sprintf(buf, "\\u%04x", *s);
+               result += buf;
+            }
+            else
+               result += *s;
+         }
+      }
+   }
+
+   return result + "\"";
+}
+
+//***************************************************************************
+// ETag Of
+//   - FNV-1a hash of the body
+//***************************************************************************
+
+std::string cHttpServer::etagOf(const std::string& body)
+{
+   uint64_t h = 0xcbf29ce484222325ULL;
+   char etag[20+TB];
+
+   for (size_t i = 0; i < body.length(); i++)
+   {
+      h ^= (unsigned char)body[i];
+      h *= 0x100000001b3ULL;
+   }
+
+   sprintf(etag, "\"%016llx\"", (unsigned long long)h);
+
+   return etag;
+}
@@ -0,0 +1,110 @@
+/*
+ * httpd.h
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#ifndef __LIB_HTTPD__
+#define __LIB_HTTPD__
+
+#include <time.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "common.h"
+
+//***************************************************************************
+// Http Server
+//   - small single threaded HTTP/1.1 server for GET requests, the sockets
+//     are non-blocking and served by one epoll instance, poll() is called
+//     from the main loop of the daemon instead of sleeping or if the fd of
+//     the epoll instance (getFd()) is readable
+//   - the ETag of each response is a hash of the body, on a matching
+//     'If-None-Match' only '304 Not Modified' is sent
+//   - responses of type 'text/event-stream' keep the connection open as
+//     Server-Sent Events stream, broadcast() pushes an event to all streams
+//***************************************************************************
+
+class cHttpServer
+{
+   public:
+
+      struct Request
+      {
+         std::string method;
+         std::string path;
+         std::map<std::string, std::string> params;     // decoded query parameters
+         std::map<std::string, std::string> headers;    // names in lower case
+
+         const char* param(const char* name, const char* def = "");
+         const char* header(const char* name, const char* def = "");
+      };
+
+      class Handler
+      {
+         public:
+
+            virtual ~Handler() {}
+
+            // returns the HTTP status, 'body' and 'contentType' of the response
+
+            virtual int onHttpRequest(Request* request, std::string& body, std::string& contentType) = 0;
+      };
+
+      cHttpServer(Handler* aHandler);
+      ~cHttpServer();
+
+      int open(int port, const char* address = "127.0.0.1");
+      int close();
+      int isOpen()  { return listenFd >= 0; }
+
+      int poll(int timeoutMs);
+      int getFd()  { return epollFd; }
+      int pollTimeout();
+      int broadcast(const char* event, const std::string& data);
+      int streamCount();
+
+      static std::string jsonEscape(const char* s);
+      static std::string etagOf(const std::string& body);
+
+      static int maxRequestSize;
+      static int idleTimeout;          // [s] of keep-alive connections, streams get a comment after half of it
+      static int maxStreamBuffer;      // [bytes] pending for a stream before it's closed (slow client)
+
+   protected:
+
+      struct Connection
+      {
+         std::string in;
+         std::string out;
+         size_t sent;
+         int keepAlive;
+         int stream;
+         time_t lastActivity;
+      };
+
+      int acceptConnections();
+      int receive(int fd, Connection* c);
+      int send(int fd, Connection* c);
+      int process(Connection* c);
+      void respond(Connection* c, int status, const std::string& body,
+                   const char* contentType, const char* etag = 0);
+      void closeConnection(int fd);
+      void checkIdle();
+
+      static int parseRequest(const std::string& text, Request* request);
+      static std::string urlDecode(const std::string& s);
+      static const char* statusText(int status);
+
+      Handler* handler;
+      int listenFd;
+      int epollFd;
+      time_t lastIdleCheck;
+      std::map<int, Connection> connections;
+};
+
+//***************************************************************************
+#endif // __LIB_HTTPD__
@@ -17,6 +17,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <time.h>
+#include <sys/time.h>
 
 #include "serial.h"
 
@@ -30,6 +31,11 @@ Serial::Serial()
    opened = no;
    readTimeout = 10;
    writeTimeout = 10;
+   recordFp = 0;
+   recordLast = 0;
+   recordLastByte = 0;
+   memset(&recordChunk, 0, sizeof(recordChunk));
+   *deviceName = 0;
 
    bzero(&oldtio, sizeof(oldtio));
 }
@@ -37,6 +43,7 @@ Serial::Serial()
 Serial::~Serial()
 {
    close();
+   stopRecord();
 }
 
 //***************************************************************************
@@ -216,6 +223,11 @@ int Serial::write(void* line, int size)
    if (::write(fdDevice, line, size) != size)
       return fail;
 
+   sent.inc(size);
+
+   if (recordFp)
+      record(rdOut, line, size);
+
    return done;
 }
 
@@ -242,13 +254,365 @@ int Serial::read(void* buf, unsigned int count, int timeout)
 
    if (res > 0)
    {
+      received.inc(res);
+
+      if (recordFp)
+         record(rdIn, buf, res);
+
       for (int i = 0; i < res; i++)
       {
          byte b = ((byte*)buf)[i];
-         tell(eloDebug3, "got %2.2X", b);
+         TELL(eloDebug3, "got %2.2X", b);
       }
    }
 
    return res;
 }
 
+//***************************************************************************
+// Record
+//***************************************************************************
+
+uint64_t Serial::nowUs()
+{
+   timeval tv;
+
+   gettimeofday(&tv, 0);
+
+   return tv.tv_sec * 1000000ULL + tv.tv_usec;
+}
+
+int Serial::startRecord(const char* file)
+{
+   RecordHeader header;
+
+   stopRecord();
+
+   if (isEmpty(file))
+      return done;
+
+   if (!(recordFp = fopen(file, "w")))
+   {
+      tell(eloAlways, "Error: Can't open record file '%s', %s", file, strerror(errno));
+      return fail;
+   }
+
+   recordLast = nowUs();
+   recordChunk.size = 0;
+
+   // flushed at once, a buffered header would be written by each process after a fork
+
+   memcpy(header.magic, "P4SR", 4);
+   header.version = 1;
+   header.start = recordLast;
+
+   if (fwrite(&header, sizeof(header), 1, recordFp) != 1 || fflush(recordFp) != 0)
+   {
+      tell(eloAlways, "Error: Writing record file '%s' failed, %s", file, strerror(errno));
+      fclose(recordFp);
+      recordFp = 0;
+      return fail;
+   }
+
+   tell(eloAlways, "Recording the serial line to '%s'", file);
+
+   return success;
+}
+
+void Serial::stopRecord()
+{
+   flushRecord();
+
+   if (recordFp)
+      fclose(recordFp);
+
+   recordFp = 0;
+}
+
+//***************************************************************************
+// Record
+//   - look() reads byte by byte, the bytes read in a row are collected to
+//     one chunk, the chunk is written when the direction changes, it's
+//     full or after a gap of more than 'recordGapMax'
+//***************************************************************************
+
+void Serial::record(RecordDirection direction, const void* data, int size)
+{
+   const byte* p = (const byte*)data;
+   uint64_t now = nowUs();
+
+   while (size > 0 && recordFp)
+   {
+      int n;
+
+      if (recordChunk.size && (recordChunk.direction != direction
+                               || recordChunk.size >= recordChunkMax
+                               || now - recordLastByte > recordGapMax))
+         flushRecord();
+
+      if (!recordChunk.size)
+      {
+         recordChunk.delta = min(now - recordLast, (uint64_t)UINT32_MAX);
+         recordChunk.direction = direction;
+         recordChunk.reserved = 0;
+         recordLast = now;
+      }
+
+      n = min(size, recordChunkMax - recordChunk.size);
+      memcpy(recordData + recordChunk.size, p, n);
+      recordChunk.size += n;
+      recordLastByte = now;
+      p += n;
+      size -= n;
+   }
+
+   // a request is written at once, the reply follows within ms
+
+   if (direction == rdOut && recordFp)
+   {
+      flushRecord();
+
+      if (recordFp && fflush(recordFp) != 0)
+      {
+         tell(eloAlways, "Error: Writing record file failed, %s; record stopped", strerror(errno));
+         stopRecord();
+      }
+   }
+}
+
+void Serial::flushRecord()
+{
+   int size = recordChunk.size;
+
+   if (!recordFp || !size)
+      return;
+
+   recordChunk.size = 0;                // before stopRecord(), it flushes too
+
+   RecordChunk chunk = recordChunk;
+   chunk.size = size;
+
+   if (fwrite(&chunk, sizeof(chunk), 1, recordFp) != 1
+       || fwrite(recordData, 1, size, recordFp) != (size_t)size)
+   {
+      tell(eloAlways, "Error: Writing record file failed, %s; record stopped", strerror(errno));
+      stopRecord();
+   }
+}
+
+//***************************************************************************
+// Class Serial Replay
+//***************************************************************************
+
+SerialReplay::SerialReplay(int aFast)
+{
+   fp = 0;
+   fast = aFast;
+   data = 0;
+   pos = 0;
+   memset(&chunk, 0, sizeof(chunk));
+   chunkTime = 0;
+   anchorRecord = anchorReal = 0;
+   started = 0;
+   bytesIn = bytesOut = 0;
+   mismatches = 0;
+}
+
+SerialReplay::~SerialReplay()
+{
+   close();
+}
+
+//***************************************************************************
+// Open / Close
+//***************************************************************************
+
+int SerialReplay::open(const char* dev)
+{
+   RecordHeader header;
+
+   if (!dev)
+      dev = deviceName;
+   else
+      sstrcpy(deviceName, dev, sizeof(deviceName));
+
+   if (isReplay(dev))
+      dev += 7;
+
+   close();
+
+   if (!(fp = fopen(dev, "r")))
+   {
+      tell(eloAlways, "Error: Opening record file '%s' failed, %s", dev, strerror(errno));
+      return fail;
+   }
+
+   if (fread(&header, sizeof(header), 1, fp) != 1 || memcmp(header.magic, "P4SR", 4) != 0)
+   {
+      tell(eloAlways, "Error: '%s' isn't a record of the serial line", dev);
+      fclose(fp);
+      fp = 0;
+      return fail;
+   }
+
+   memset(&chunk, 0, sizeof(chunk));
+   pos = 0;
+   chunkTime = anchorRecord = header.start;
+   anchorReal = started = nowUs();
+   bytesIn = bytesOut = 0;
+   mismatches = 0;
+   opened = yes;
+
+   tell(eloDetail, "Replaying '%s'%s", dev, fast ? " as fast as possible" : "");
+
+   return success;
+}
+
+int SerialReplay::close()
+{
+   if (!fp)
+      return done;
+
+   tell(eloAlways, "Replayed %lu bytes received and %lu sent in %lu ms, %d mismatches",
+        bytesIn, bytesOut, (unsigned long)((nowUs() - started) / 1000), mismatches);
+
+   fclose(fp);
+   fp = 0;
+   free(data);
+   data = 0;
+   opened = no;
+
+   return success;
+}
+
+//***************************************************************************
+// Next Chunk
+//***************************************************************************
+
+int SerialReplay::nextChunk()
+{
+   if (fread(&chunk, sizeof(chunk), 1, fp) != 1)
+   {
+      chunk.size = 0;
+      return fail;
+   }
+
+   data = (byte*)realloc(data, chunk.size + TB);
+   pos = 0;
+   chunkTime += chunk.delta;
+
+   if (fread(data, 1, chunk.size, fp) != chunk.size)
+   {
+      tell(eloAlways, "Warning: Record file truncated");
+      chunk.size = 0;
+      return fail;
+   }
+
+   return success;
+}
+
+void SerialReplay::waitTimeout(int timeout)
+{
+   if (!fast)
+      usleep(timeout * 1000);
+}
+
+//***************************************************************************
+// Look
+//***************************************************************************
+
+int SerialReplay::look(byte& b, int timeout)
+{
+   b = 0;
+
+   if (!fp)
+      return fail;
+
+   while (pos >= chunk.size)
+   {
+      if (nextChunk() != success)
+      {
+         waitTimeout(timeout);
+         return wrnTimeout;
+      }
+   }
+
+   // nothing received until the next request
+
+   if (chunk.direction != rdIn)
+   {
+      waitTimeout(timeout);
+      return wrnTimeout;
+   }
+
+   if (!fast)
+   {
+      uint64_t due = anchorReal + (chunkTime - anchorRecord);
+      uint64_t now = nowUs();
+
+      if (due > now)
+         usleep(due - now);
+   }
+
+   b = data[pos++];
+   bytesIn++;
+   received.inc();
+
+   return success;
+}
+
+//***************************************************************************
+// Write
+//***************************************************************************
+
+int SerialReplay::write(void* line, int size)
+{
+   int skipped = 0;
+   int differ = no;
+
+   if (!fp || !line)
+      return done;
+
+   for (int i = 0; i < size; i++)
+   {
+      // skip received bytes not read by the caller
+
+      while (pos >= chunk.size || chunk.direction != rdOut)
+      {
+         if (pos < chunk.size)
+         {
+            skipped += chunk.size - pos;
+            pos = chunk.size;
+         }
+
+         if (nextChunk() != success)
+         {
+            tell(eloAlways, "Warning: End of record reached");
+            return fail;
+         }
+      }
+
+      if (i == 0)
+      {
+         anchorRecord = chunkTime;
+         anchorReal = nowUs();
+      }
+
+      if (data[pos++] != ((byte*)line)[i])
+         differ = yes;
+   }
+
+   if (skipped)
+      tell(eloDetail, "Skipped %d unread bytes of the record", skipped);
+
+   if (differ)
+   {
+      mismatches++;
+      tell(eloAlways, "Warning: Request differs from the recorded one");
+   }
+
+   bytesOut += size;
+   sent.inc(size);
+
+   return done;
+}
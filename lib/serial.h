@@ -14,11 +14,17 @@
 //***************************************************************************
 
 #include <termios.h>
+#include <stdio.h>
+#include <stdint.h>
 
 #include "common.h"
 
 //***************************************************************************
 // IO Interface
+//   - startRecord() writes all bytes sent and received with their time to
+//     a file: a 'RecordHeader' followed by a 'RecordChunk' and its bytes
+//     for each write() and for the bytes read in a row (up to 'recordChunkMax'
+//     bytes, no gap over 'recordGapMax'), SerialReplay plays it back
 //***************************************************************************
 
 class Serial
@@ -28,10 +34,33 @@ class Serial
       enum Misc
       {
          sizeCmdMax = 100,
+         recordChunkMax = 1024,        // [bytes] read in a row to one chunk
+         recordGapMax = 10000,         // [us] max gap between the reads of a chunk
 
          wrnTimeout = -10
       };
 
+      enum RecordDirection
+      {
+         rdOut = '>',
+         rdIn  = '<'
+      };
+
+      struct RecordHeader
+      {
+         char magic[4];                // "P4SR"
+         uint32_t version;
+         uint64_t start;               // [us] since epoch
+      };
+
+      struct RecordChunk
+      {
+         uint32_t delta;               // [us] since the previous chunk
+         uint8_t direction;            // RecordDirection
+         uint8_t reserved;
+         uint16_t size;                // of the bytes following
+      };
+
       // object
 
       Serial();
@@ -52,12 +81,35 @@ class Serial
       virtual int setTimeout(int timeout);
       virtual int setWriteTimeout(int timeout);
 
+      // record
+
+      int startRecord(const char* file);
+      void stopRecord();
+
+      static uint64_t nowUs();
+
+      // statistics
+
+      uint64_t getReceived()           { return received.get(); }
+      uint64_t getSent()               { return sent.get(); }
+
    protected:
 
       virtual int read(void* buf, unsigned int count, int timeout = 0);
+      void record(RecordDirection direction, const void* data, int size);
+      void flushRecord();
 
       // data
 
+      FILE* recordFp;
+      uint64_t recordLast;             // start of the last chunk
+      uint64_t recordLastByte;         // time of the last byte of 'recordChunk'
+      RecordChunk recordChunk;         // pending, until the direction changes
+      byte recordData[recordChunkMax];
+
+      cCounter received;               // bytes
+      cCounter sent;
+
       int opened;
       int readTimeout;
       int writeTimeout;
@@ -67,5 +119,50 @@ class Serial
       struct termios oldtio;
 };
 
+//***************************************************************************
+// Serial Replay
+//   - plays a file of Serial::startRecord() instead of a device, the
+//     received bytes at the recorded time after the preceding write() or
+//     as fast as possible ('fast')
+//   - the written bytes are compared with the recorded ones
+//***************************************************************************
+
+class SerialReplay : public Serial
+{
+   public:
+
+      SerialReplay(int aFast = no);
+      virtual ~SerialReplay();
+
+      static int isReplay(const char* dev)  { return dev && strncmp(dev, "replay:", 7) == 0; }
+
+      virtual int open(const char* dev = 0);      // "replay:<file>"
+      virtual int close();
+      virtual int isOpen()                        { return fp != 0; }
+      virtual int look(byte& b, int timeout = 0);
+      virtual int flush()                         { return done; }
+      virtual int write(void* line, int size = 0);
+
+   protected:
+
+      int nextChunk();
+      void waitTimeout(int timeout);
+
+      FILE* fp;
+      int fast;
+
+      RecordChunk chunk;
+      byte* data;
+      int pos;                         // next byte of the chunk
+      uint64_t chunkTime;              // recorded time of the chunk
+      uint64_t anchorRecord;           // recorded and real time of the last write()
+      uint64_t anchorReal;
+
+      uint64_t started;
+      unsigned long bytesIn;
+      unsigned long bytesOut;
+      int mismatches;
+};
+
 //***************************************************************************
 #endif // _IO_SERIAL_H_
@@ -0,0 +1,109 @@
+/*
+ * spscqueue.h
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#ifndef _SPSCQUEUE_H_
+#define _SPSCQUEUE_H_
+
+#include "common.h"
+
+//***************************************************************************
+// Class SPSC Queue
+//   - bounded ring for exactly one producer and one consumer thread,
+//     without lock, 'head' is only written by the consumer and 'tail'
+//     only by the producer
+//   - the time between push() and pop() is summed up for the metrics
+//***************************************************************************
+
+template <class T> class cSpscQueue
+{
+   public:
+
+      cSpscQueue(const char* aName, unsigned int aCapacity)
+      {
+         name = aName;
+         capacity = 1;
+
+         while (capacity < aCapacity)      // power of 2
+            capacity <<= 1;
+
+         slots = new Slot[capacity];
+         head = tail = 0;
+      }
+
+      ~cSpscQueue()                      { delete[] slots; }
+
+      // producer, fail if full (counted as dropped)
+
+      int push(const T& item)
+      {
+         unsigned int t = tail;
+
+         if (t - head >= capacity)
+         {
+            dropped.inc();
+            return fail;
+         }
+
+         slots[t & (capacity-1)].item = item;
+         slots[t & (capacity-1)].pushedAt = usNow();
+
+         __sync_synchronize();
+         tail = t + 1;
+         pushed.inc();
+
+         return success;
+      }
+
+      // consumer, fail if empty
+
+      int pop(T& item)
+      {
+         unsigned int h = head;
+
+         if (h == tail)
+            return fail;
+
+         __sync_synchronize();
+
+         item = slots[h & (capacity-1)].item;
+         latencyUs.inc((uint64_t)(usNow() - slots[h & (capacity-1)].pushedAt));
+
+         __sync_synchronize();
+         head = h + 1;
+         popped.inc();
+
+         return success;
+      }
+
+      unsigned int size()                { return tail - head; }
+      unsigned int getCapacity()         { return capacity; }
+      const char* getName()              { return name; }
+
+      // statistics
+
+      cCounter pushed;
+      cCounter popped;
+      cCounter dropped;
+      cCounter latencyUs;                // sum of the time in the queue
+
+   private:
+
+      struct Slot
+      {
+         T item;
+         double pushedAt;              // [us]
+      };
+
+      const char* name;
+      unsigned int capacity;
+      Slot* slots;
+      volatile unsigned int head;
+      volatile unsigned int tail;
+};
+
+//***************************************************************************
+#endif // _SPSCQUEUE_H_
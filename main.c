@@ -13,6 +13,7 @@
 #include <string.h>
 
 #include "p4d.h"
+#include "export.h"
 
 char* confDir = (char*)confDirDefault;
 
@@ -27,8 +28,23 @@ char dbPass[100+TB] = "p4";
 char ttyDeviceSvc[100+TB] = "/dev/ttyUSB1";
 int  interval = 120;
 int  stateCheckInterval = 10;
+int  jobCheckInterval = 500;     // [ms] of the check for WEBIF jobs
 int  aggregateInterval = 15;     // aggregate interval in minutes
 int  aggregateHistory = 0;       // history in days
+int  partitionRetention = na;    // retention in months, na -> use dictionary
+int  archiveHistory = 0;         // history in days, 0 -> archive off
+char archivePath[200+TB] = archiveDirDefault;
+char retentionPolicy[200+TB] = "";     // empty -> keep all
+int  httpPort = 8099;
+char w1Path[200+TB] = w1PathDefault;
+char captureFile[200+TB] = "";   // empty -> no capture of the frames
+char recordFile[200+TB] = "";    // empty -> no record of the serial line
+int  cycleStats = 0;             // days, 0 -> don't store the cycle profile
+char metricsFile[200+TB] = "";   // empty -> metrics only by /metrics
+int  validateSchema = no;        // check table structure even if the dictionary is unchanged
+int  logAsync = yes;             // write the log by a thread
+char logFile[200+TB] = "";       // empty -> syslog
+int  logFileSize = 10;           // [MB] rotate the log file at this size
 
 //***************************************************************************
 // Configuration
@@ -43,14 +59,40 @@ int atConfigItem(const char* Name, const char* Value)
    else if (!strcasecmp(Name, "dbName"))      sstrcpy(dbName, Value, sizeof(dbName));
    else if (!strcasecmp(Name, "dbUser"))      sstrcpy(dbUser, Value, sizeof(dbUser));
    else if (!strcasecmp(Name, "dbPass"))      sstrcpy(dbPass, Value, sizeof(dbPass));
+   else if (!strcasecmp(Name, "dbPrefetchRows"))      cDbStatement::prefetchRows = atoi(Value);
+   else if (!strcasecmp(Name, "dbEngine"))            cDbConnection::setEngineType(cDbEngine::toType(Value));
+#ifdef USESQLITE
+   else if (!strcasecmp(Name, "dbBatchRows"))         cDbSqliteEngine::batchRows = atoi(Value);
+   else if (!strcasecmp(Name, "dbBatchTime"))         cDbSqliteEngine::batchTime = atoi(Value);
+#endif
 
    else if (!strcasecmp(Name, "logLevel"))            loglevel = atoi(Value);
+   else if (!strcasecmp(Name, "logAsync"))            logAsync = atoi(Value);
+   else if (!strcasecmp(Name, "logFile"))             sstrcpy(logFile, Value, sizeof(logFile));
+   else if (!strcasecmp(Name, "logFileSize"))         logFileSize = atoi(Value);
    else if (!strcasecmp(Name, "interval"))            interval = atoi(Value);
    else if (!strcasecmp(Name, "stateCheckInterval"))  stateCheckInterval = atoi(Value);
+   else if (!strcasecmp(Name, "jobCheckInterval"))    jobCheckInterval = atoi(Value);
    else if (!strcasecmp(Name, "ttyDeviceSvc"))        sstrcpy(ttyDeviceSvc, Value, sizeof(ttyDeviceSvc));
 
    else if (!strcasecmp(Name, "aggregateInterval"))  aggregateInterval = atoi(Value);
    else if (!strcasecmp(Name, "aggregateHistory"))   aggregateHistory = atoi(Value);
+   else if (!strcasecmp(Name, "partitionRetention")) partitionRetention = atoi(Value);
+   else if (!strcasecmp(Name, "archiveHistory"))     archiveHistory = atoi(Value);
+   else if (!strcasecmp(Name, "archivePath"))        sstrcpy(archivePath, Value, sizeof(archivePath));
+   else if (!strcasecmp(Name, "retention"))          sstrcpy(retentionPolicy, Value, sizeof(retentionPolicy));
+   else if (!strcasecmp(Name, "retentionChunkRows")) cRetention::chunkRows = atoi(Value);
+   else if (!strcasecmp(Name, "retentionPause"))     cRetention::pauseMs = atoi(Value);
+   else if (!strcasecmp(Name, "httpPort"))           httpPort = atoi(Value);
+   else if (!strcasecmp(Name, "w1Path"))             sstrcpy(w1Path, Value, sizeof(w1Path));
+   else if (!strcasecmp(Name, "captureFile"))        sstrcpy(captureFile, Value, sizeof(captureFile));
+   else if (!strcasecmp(Name, "recordFile"))         sstrcpy(recordFile, Value, sizeof(recordFile));
+   else if (!strcasecmp(Name, "cycleStats"))         cycleStats = atoi(Value);
+   else if (!strcasecmp(Name, "metricsFile"))        sstrcpy(metricsFile, Value, sizeof(metricsFile));
+   else if (!strcasecmp(Name, "w1Threads"))          W1::maxThreads = atoi(Value);
+   else if (!strcasecmp(Name, "w1Interval"))         W1::interval = atoi(Value);
+   else if (!strcasecmp(Name, "hookThreads"))        cHookExecutor::maxWorkers = atoi(Value);
+   else if (!strcasecmp(Name, "hookTimeout"))        cHookExecutor::timeout = atoi(Value);
 
    return success;
 }
@@ -130,7 +172,7 @@ int readConfig()
 
 void showUsage(const char* bin)
 {
-   printf("Usage: %s [-n][-c <config-dir>][-l <log-level>][-t]\n", bin);
+   printf("Usage: %s [-n][-c <config-dir>][-l <log-level>][-t][--validate][--export <dir>][--import <dir>]\n", bin);
    printf("    -n              don't daemonize\n");
    printf("    -t              log to stdout\n");
    printf("    -v              show version\n");
@@ -139,6 +181,9 @@ void showUsage(const char* bin)
    printf("    -I              truncate and initialze configuration tables\n");
    printf("    -c <config-dir> use config in <config-dir>\n");
    printf("    -l <log-level>  set log level\n");
+   printf("    --validate      check table structure and indices even if the dictionary is unchanged\n");
+   printf("    --export <dir>  write the rows changed since the last export to <dir> and exit\n");
+   printf("    --import <dir>  load the export files of <dir> into the database and exit\n");
 }
 
 //***************************************************************************
@@ -155,6 +200,8 @@ int main(int argc, char** argv)
    int truncOnInit = no;
    int _stdout = na;
    int _level = na;
+   const char* exportDir = 0;
+   const char* importDir = 0;
 
    logstdout = yes;
 
@@ -170,6 +217,15 @@ int main(int argc, char** argv)
 
    for (int i = 0; argv[i]; i++)
    {
+      if (strcmp(argv[i], "--validate") == 0)
+         validateSchema = yes;
+
+      if (strcmp(argv[i], "--export") == 0 && argv[i+1])
+         exportDir = argv[i+1];
+
+      if (strcmp(argv[i], "--import") == 0 && argv[i+1])
+         importDir = argv[i+1];
+
       if (argv[i][0] != '-' || strlen(argv[i]) != 2)
          continue;
 
@@ -213,6 +269,21 @@ int main(int argc, char** argv)
    if (init)
       return job->initialize(truncOnInit);
 
+   // export / import and exit
+
+   if (exportDir || importDir)
+   {
+      cDbConnectionPool pool(1);
+      cExport* exp = new cExport(exportDir ? exportDir : importDir, &pool);
+      int status = exportDir ? exp->exportTables() : exp->importFiles();
+
+      delete exp;
+      pool.close();
+      delete job;
+
+      return status == success ? 0 : 1;
+   }
+
    // fork daemon
 
    if (!nofork)
@@ -231,8 +302,14 @@ int main(int argc, char** argv)
 
    ::signal(SIGINT, DEAMON::downF);
    ::signal(SIGTERM, DEAMON::downF);
+   ::signal(SIGUSR1, DEAMON::profileF);
    // ::signal(SIGHUP, DEAMON::triggerF);
 
+   // from now tell() only queues the messages
+
+   if (logAsync)
+      asyncLog.start(logFile, logFileSize * 1024L * 1024L);
+
    // do work ...
 
    job->loop();
@@ -243,5 +320,7 @@ int main(int argc, char** argv)
 
    delete job;
 
+   asyncLog.stop();
+
    return 0;
 }
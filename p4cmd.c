@@ -12,6 +12,7 @@
 #include "lib/common.h"
 #include "p4io.h"
 #include "w1.h"
+#include "archive.h"
 
 //***************************************************************************
 // Choice
@@ -35,6 +36,7 @@ enum UserCommand
    ucGetAo,
    ucUser,
    ucShowW1,
+   ucArchive,
    ucUnkonownList
 };
 
@@ -46,8 +48,17 @@ void showUsage(const char* bin)
    printf("     -a <address>    address of parameter or value\n");
    printf("     -v <value>      new value\n");
    printf("     -l <log-level>  set log level\n");
-   printf("     -d <device>     serial device file (defaults to /dev/ttyUSB0)\n");
+   printf("     -d <device>     serial device file (defaults to /dev/ttyUSB0),\n");
+   printf("                     'replay:<file>' to play a record of the line\n");
+   printf("     -F              replay as fast as possible (default at the recorded speed)\n");
+   printf("     -R <file>       record the serial line to <file>\n");
    printf("     -o <offset>     optional offset for time sync in seconds\n");
+   printf("     -t <type>       sensor type of archived samples (defaults to VA)\n");
+   printf("     -g <aggregate>  'S' for the samples, 'A' for the aggregation rows (defaults to S)\n");
+   printf("     -f <from>       start of archive range 'YYYY-MM-DD' (defaults to begin of archive)\n");
+   printf("     -u <until>      end of archive range 'YYYY-MM-DD' (defaults to now)\n");
+   printf("     -A <directory>  archive directory (defaults to %s)\n", archiveDirDefault);
+   printf("     -C <file>       capture the frames to <file>\n");
 
    printf("\n");
    printf("  commands:\n");
@@ -62,7 +73,8 @@ void showUsage(const char* bin)
    printf("     times    get time ranges of <addr>\n");
    printf("     getdo    show digital output at <addr>\n");
    printf("     getao    show analog output at <addr>\n");
-   printf("     w1       show data of all connected one wire sensors\n");
+   printf("     w1       show data of all connected one wire sensors [<w1-path>]\n");
+   printf("     archive  show archived samples of <type>:<addr>\n");
 }
 
 //***************************************************************************
@@ -71,7 +83,7 @@ void showUsage(const char* bin)
 
 int main(int argc, char** argv)
 {
-   Serial serial;
+   Serial* serial;
    int status;
    byte b;
    word addr = Fs::addrUnknown;
@@ -79,6 +91,14 @@ int main(int argc, char** argv)
    word value = Fs::addrUnknown;
    UserCommand cmd = ucUnknown;
    const char* device = "/dev/ttyUSB0";
+   const char* type = "VA";
+   const char* aggregate = "S";
+   const char* archiveDir = archiveDirDefault;
+   const char* captureTo = 0;
+   const char* recordTo = 0;
+   int fast = no;
+   time_t from = 0;
+   time_t until = time(0);
 
 //    {
 //       md5Buf defaultPwd;
@@ -135,6 +155,8 @@ int main(int argc, char** argv)
       cmd = ucUser;
    else if (strcasecmp(argv[1], "list") == 0)
       cmd = ucUnkonownList;
+   else if (strcasecmp(argv[1], "archive") == 0)
+      cmd = ucArchive;
    else
    {
       showUsage(argv[0]);
@@ -143,7 +165,7 @@ int main(int argc, char** argv)
 
    if (cmd == ucShowW1)
    {
-      W1 w1;
+      W1 w1(argc > 2 ? argv[2] : w1PathDefault);
 
       if (w1.scan() == success)
       {
@@ -168,34 +190,83 @@ int main(int argc, char** argv)
          case 'v': if (argv[i+1]) value = strtol(argv[++i], 0, 0);   break;
          case 'l': if (argv[i+1]) loglevel = atoi(argv[++i]);        break;
          case 'd': if (argv[i+1]) device = argv[++i];                break;
+         case 't': if (argv[i+1]) type = argv[++i];                  break;
+         case 'g': if (argv[i+1]) aggregate = argv[++i];             break;
+         case 'A': if (argv[i+1]) archiveDir = argv[++i];            break;
+         case 'C': if (argv[i+1]) captureTo = argv[++i];             break;
+         case 'R': if (argv[i+1]) recordTo = argv[++i];              break;
+         case 'F': fast = yes;                                       break;
+         case 'f':
+         case 'u':
+         {
+            struct tm tm = {0};
+
+            if (!argv[i+1] || !strptime(argv[i+1], "%Y-%m-%d", &tm))
+            {
+               printf("Invalid date, expected 'YYYY-MM-DD'\n");
+               return 1;
+            }
+
+            tm.tm_isdst = -1;
+            (argv[i][1] == 'f' ? from : until) = mktime(&tm);
+            i++;
+
+            break;
+         }
       }
    }
 
    if (cmd == ucUnknown)
       return 1;
 
+   if (cmd == ucArchive)
+   {
+      cArchive archive(archiveDir);
+      std::vector<cArchive::Point> points;
+
+      if (archive.read(type, addr, from, until, points, aggregate) != success)
+         return 1;
+
+      for (uint i = 0; i < points.size(); i++)
+         printf("%s  %.2f\n", l2pTime(points[i].time).c_str(), points[i].value);
+
+      tell(eloAlways, "%d archived samples of %s:0x%x", (int)points.size(), type, addr);
+
+      return 0;
+   }
+
    if (loglevel > 0)
       logstamp = yes;
 
    int debugMode = strcmp(device, "-") == 0;
+   int replay = SerialReplay::isReplay(device);
 
-   P4Request request(&serial);
+   serial = replay ? new SerialReplay(fast) : new Serial;
+
+   P4Request request(serial);
+
+   if (captureTo && P4Request::openCapture(captureTo) != success)
+      return 1;
+
+   if (recordTo && serial->startRecord(recordTo) != success)
+      return 1;
 
    if (!debugMode)
    {
-      sem.p();
+      if (!replay)
+         sem.p();
 
-      if (serial.open(device) != success)
+      if (serial->open(device) != success)
          return 1;
 
-      while (serial.look(b, 100) == success)
+      while (serial->look(b, 100) == success)
          tell(eloDebug, "-> 0x%2.2x", b);
 
       // connection check
 
       if (request.check() != success)
       {
-         serial.close();
+         serial->close();
          return 1;
       }
    }
@@ -414,11 +485,18 @@ int main(int argc, char** argv)
       default: break;
    }
 
+   request.clear();
+   P4Request::closeCapture();
+
    if (!debugMode)
    {
-      serial.close();
-      sem.v();
+      serial->close();
+
+      if (!replay)
+         sem.v();
    }
 
+   delete serial;
+
    return 0;
 }
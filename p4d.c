@@ -18,12 +18,28 @@
 #include "p4d.h"
 
 int P4d::shutdown = no;
+int P4d::profileRequested = no;
+cEventLoop P4d::eventLoop;
+
+const char* P4d::cyclePhaseNames[] =
+{
+   "maintain",
+   "state",
+   "check",
+   "update",
+   "errors",
+   "scripts",
+   "mail",
+
+   0
+};
 
 //***************************************************************************
 // Object
 //***************************************************************************
 
 P4d::P4d()
+   : profiler(cyclePhaseNames, cpCount)
 {
    connection = 0;
    tableSamples = 0;
@@ -37,6 +53,7 @@ P4d::P4d()
    tableErrors = 0;
    tableTimeRanges = 0;
    tableScripts = 0;
+   tableCycleStats = 0;
    selectHmSysVarByAddr = 0;
 
    selectActiveValueFacts = 0;
@@ -46,13 +63,16 @@ P4d::P4d()
    selectSensorAlerts = 0;
    selectSampleInRange = 0;
    selectPendingErrors = 0;
+   selectRecentErrors = 0;
    selectMaxTime = 0;
    selectHmSysVarByAddr = 0;
    selectScriptByName = 0;
    selectScript = 0;
    cleanupJobs = 0;
+   cleanupCycleStats = 0;
 
    nextAt = time(0);           // intervall for 'reading values'
+   nextCycleCleanupAt = 0;
    startedAt = time(0);
    nextAggregateAt = 0;
    nextTimeSyncAt = 0;
@@ -78,9 +98,12 @@ P4d::P4d()
    cDbConnection::setPass(dbPass);
 
    sem = new Sem(0x3da00001);
-   serial = new Serial;
+   serial = SerialReplay::isReplay(ttyDeviceSvc) ? new SerialReplay : new Serial;
    request = new P4Request(serial);
    curl = new cCurl();
+   httpServer = new cHttpServer(this);
+   standbyTimer = na;
+   jobTimer = na;
 }
 
 P4d::~P4d()
@@ -96,6 +119,7 @@ P4d::~P4d()
    delete request;
    delete sem;
    delete curl;
+   delete httpServer;
 
    cDbConnection::exit();
 }
@@ -125,15 +149,35 @@ int P4d::init()
 
    // prepare one wire sensors
 
+   w1.setPath(w1Path);
    w1.scan();
 
+   // retention of the samples
+
+   retention.setPolicies(retentionPolicy);
+   retention.setPartitionRetention(partitionRetention);
+   retention.setArchive(archivePath, archiveHistory);
+   retention.setPool(&dbPool);
+   persister.setPool(&dbPool);
+
    return success;
 }
 
 int P4d::exit()
 {
+   retention.stop();
+   w1.stop();
+   persister.stop();               // writes the queued samples
+   notifier.stop();
+   hooks.stop();
+   dbPool.close();
+   eventLoop.close();
+   httpServer->close();
+   valueCache.close();
    exitDb();
    serial->close();
+   request->clear();               // writes the pending reply to the capture
+   P4Request::closeCapture();
    curl->exit();
 
    return success;
@@ -149,6 +193,9 @@ int P4d::initDb()
 {
    static int initial = yes;
    int status = success;
+   std::string fingerprint = "";
+   std::string storedFingerprint = "";
+   int checked = no;
 
    if (connection)
       exitDb();
@@ -171,11 +218,45 @@ int P4d::initDb()
          return fail;
       }
 
+      // the full check is only needed if the dictionary changed since the last successful one
+
+      cDbTable::checkStructure = yes;
+      fingerprint = dbDict.fingerprint();
+
+      cDbTable* config = new cDbTable(connection, "config");
+
+      if (config->open() == success)
+      {
+         config->clear();
+         config->setValue("OWNER", "p4d");
+         config->setValue("NAME", "dictFingerprint");
+
+         if (config->find())
+            storedFingerprint = config->getStrValue("VALUE");
+
+         config->reset();
+      }
+
+      delete config;
+
       std::map<std::string, cDbTableDef*>::iterator t;
 
-      tell(0, "Checking table structure and indices ...");
+      if (!validateSchema && fingerprint == storedFingerprint)
+      {
+         tell(0, "Dictionary unchanged (%s), skipping check of table structure and indices", fingerprint.c_str());
+
+         // armed until the init succeeded, if the database was modified
+         //   behind our back the next try will check it
+
+         validateSchema = yes;
+      }
+      else
+      {
+         tell(0, "Checking table structure and indices ...");
+         checked = yes;
+      }
 
-      for (t = dbDict.getFirstTableIterator(); t != dbDict.getTableEndIterator(); t++)
+      for (t = dbDict.getFirstTableIterator(); checked && t != dbDict.getTableEndIterator(); t++)
       {
          cDbTable* table = new cDbTable(connection, t->first.c_str());
 
@@ -201,7 +282,10 @@ int P4d::initDb()
       if (status != success)
          return abrt;
 
-      tell(0, "Checking table structure and indices succeeded");
+      if (checked)
+         tell(0, "Checking table structure and indices succeeded");
+
+      cDbTable::checkStructure = no;
    }
 
    // ------------------------
@@ -244,6 +328,9 @@ int P4d::initDb()
    tableScripts = new cDbTable(connection, "scripts");
    if (tableScripts->open() != success) return fail;
 
+   tableCycleStats = new cDbTable(connection, "cyclestats");
+   if (tableCycleStats->open() != success) return fail;
+
    // prepare statements
 
    selectActiveValueFacts = new cDbStatement(tableValueFacts);
@@ -269,6 +356,7 @@ int P4d::initDb()
 
    selectAllMenuItems = new cDbStatement(tableMenu);
 
+   selectAllMenuItems->setStreaming();
    selectAllMenuItems->build("select ");
    selectAllMenuItems->bindAllOut();
    selectAllMenuItems->build(" from %s", tableMenu->TableName());
@@ -339,6 +427,18 @@ int P4d::initDb()
 
    status += selectPendingErrors->prepare();
 
+   // select * from errors order by time1 desc limit 100
+
+   selectRecentErrors = new cDbStatement(tableErrors);
+
+   selectRecentErrors->build("select ");
+   selectRecentErrors->bindAllOut();
+   selectRecentErrors->build(" from %s order by %s desc limit 100",
+                             tableErrors->TableName(),
+                             tableErrors->getField("TIME1")->getDbName());
+
+   status += selectRecentErrors->prepare();
+
    // --------------------
    // select max(time) from samples
 
@@ -395,9 +495,29 @@ int P4d::initDb()
 
    // ------------------
 
+   cleanupCycleStats = new cDbStatement(tableCycleStats);
+
+   cleanupCycleStats->build("delete from %s where ", tableCycleStats->TableName());
+   cleanupCycleStats->bindCmp(0, "TIME", 0, "<");
+
+   status += cleanupCycleStats->prepare();
+
+   // ------------------
+
    if (status == success)
+   {
       tell(eloAlways, "Connection to database established");
 
+      if (checked && fingerprint != storedFingerprint)
+         setConfigItem("dictFingerprint", fingerprint.c_str());
+
+      validateSchema = no;
+
+      // start the retention worker with the first connect
+
+      retention.start();
+   }
+
    readConfiguration();
    updateScripts();
 
@@ -418,6 +538,7 @@ int P4d::exitDb()
    delete tableTimeRanges;         tableTimeRanges = 0;
    delete tableHmSysVars;          tableHmSysVars = 0;
    delete tableScripts;            tableScripts = 0;
+   delete tableCycleStats;         tableCycleStats = 0;
 
    delete selectActiveValueFacts;  selectActiveValueFacts = 0;
    delete selectAllValueFacts;     selectAllValueFacts = 0;
@@ -426,10 +547,12 @@ int P4d::exitDb()
    delete selectSensorAlerts;      selectSensorAlerts = 0;
    delete selectSampleInRange;     selectSampleInRange = 0;
    delete selectPendingErrors;     selectPendingErrors = 0;
+   delete selectRecentErrors;      selectRecentErrors = 0;
    delete selectMaxTime;           selectMaxTime = 0;
    delete selectScriptByName;      selectScriptByName = 0;
    delete selectScript;            selectScript = 0;
    delete cleanupJobs;             cleanupJobs = 0;
+   delete cleanupCycleStats;       cleanupCycleStats = 0;
 
    delete connection;              connection = 0;
 
@@ -790,7 +913,10 @@ int P4d::updateValueFacts()
 
    if (w1.scan() == success)
    {
-      W1::SensorList* list = w1.getList();
+      W1::SensorList sensors;
+      W1::SensorList* list = &sensors;
+
+      w1.getList(sensors);
 
       // yes, we have one-wire sensors
 
@@ -1030,8 +1156,6 @@ int P4d::initMenu()
 int P4d::store(time_t now, const char* type, int address, double value,
                unsigned int factor, const char* text)
 {
-   static time_t lastHmFailAt = 0;
-
    double theValue = value / (double)factor;
 
    tableSamples->clear();
@@ -1045,16 +1169,16 @@ int P4d::store(time_t now, const char* type, int address, double value,
    tableSamples->setValue("TEXT", text);
    tableSamples->setValue("SAMPLES", 1);
 
-   tableSamples->store();
+   // the row is written by the persister, here it's only used for the value cache
 
-   // HomeMatic
+   persister.store(now, type, address, theValue, text);
 
-   if (lastHmFailAt < time(0) - 3*tmeSecondsPerMinute)  // on fail retry not before 3 minutes
+   // HomeMatic, the request is sent by the notifier
+
+   if (!notifier.isUrlBlocked())
    {
       char* hmHost = 0;
       char* hmUrl = 0;
-      MemoryStruct data;
-      int size = 0;
 
       getConfigItem("hmHost", hmHost, "");
 
@@ -1078,15 +1202,7 @@ int P4d::store(time_t now, const char* type, int address, double value,
             asprintf(&hmUrl, "http://%s/config/xmlapi/statechange.cgi?ise_id=%ld&new_value=%f;",
                      hmHost, tableHmSysVars->getIntValue("ID"), theValue);
 
-            if (curl->downloadFile(hmUrl, size, &data) != success)
-            {
-               tell(0, "Error: Requesting sysvar change at homematic %s failed [%s]", hmHost, hmUrl);
-               lastHmFailAt = time(0);
-               free(hmUrl);
-               return fail;
-            }
-
-            tell(1, "Info: Call of [%s] succeeded", hmUrl);
+            notifier.request(cNotifier::ntUrl, hmUrl);
             free(hmUrl);
          }
 
@@ -1095,6 +1211,7 @@ int P4d::store(time_t now, const char* type, int address, double value,
    }
    else
    {
+      counters.hmSkipped.inc();
       tell(1, "Skipping HomeMatic request due to error within the last 3 minutes");
    }
 
@@ -1124,32 +1241,60 @@ void P4d::scheduleTimeSyncIn(int offset)
 
 //***************************************************************************
 // standby
+//   - sleeps in the event loop until 'until', a signal or a request to
+//     the HTTP server, the WEBIF jobs are checked every 'jobCheckInterval'
 //***************************************************************************
 
 int P4d::standby(int t)
 {
-   time_t end = time(0) + t;
-
-   while (time(0) < end && !doShutDown())
-   {
-      meanwhile();
-      usleep(50000);
-   }
-
-   return done;
+   return standbyUntil(time(0) + t);
 }
 
 int P4d::standbyUntil(time_t until)
 {
    while (time(0) < until && !doShutDown())
    {
-      meanwhile();
-      usleep(50000);
+      // set again each time, a set of the clock cancels the timer
+
+      eventLoop.setTimer(standbyTimer, until);
+
+      if (eventLoop.wait(httpServer->pollTimeout()) < 0)
+         usleep(50000);
+
+      if (eventLoop.isFired(jobTimer) || eventLoop.isWokenUp())
+         meanwhile();
+
+      // on timeout too, for the check of the idle connections
+
+      if (httpServer->isOpen())
+         httpServer->poll(0);
    }
 
    return done;
 }
 
+//***************************************************************************
+// Next Work At
+//   - earliest of the deadlines for the state check, the update and the
+//     maintenance, the loop stands by until then
+//***************************************************************************
+
+time_t P4d::nextWorkAt(time_t nextStateAt)
+{
+   time_t now = time(0);
+   time_t at = min(nextStateAt, nextAt);
+
+   // the ones already due wait for the next cycle
+
+   if (aggregateHistory && nextAggregateAt > now)
+      at = min(at, nextAggregateAt);
+
+   if (tSync && nextTimeSyncAt > now)
+      at = min(at, nextTimeSyncAt);
+
+   return at;
+}
+
 //***************************************************************************
 // Meanwhile
 //***************************************************************************
@@ -1158,9 +1303,18 @@ int P4d::meanwhile()
 {
    static time_t lastCleanup = time(0);
 
+   // SIGUSR1
+
+   if (profileRequested)
+   {
+      profileRequested = no;
+      profiler.report();
+   }
+
    if (!connection || !connection->isConnected())
       return fail;
 
+   finishScriptJobs();
    performWebifRequests();
 
    if (lastCleanup < time(0) - 6*tmeSecondsPerHour)
@@ -1190,9 +1344,32 @@ int P4d::loop()
    if (mail && !isEmpty(errorMailTo))
       tell(eloAlways, "Mail at errors to '%s'", errorMailTo);
 
-   // init
+   // init, threads are started and the resources of the daemon opened
+   // here as init() runs before the fork and for setup, init and export too
+
+   valueCache.open();
+
+   if (httpPort > 0)
+      httpServer->open(httpPort);
+
+   P4Request::openCapture(captureFile);
+   serial->startRecord(recordFile);
 
    scheduleAggregate();
+   w1.start();
+   persister.start();
+   notifier.start();
+   hooks.start();
+
+   // the standby wakes up by the timers, signals and the HTTP server
+
+   eventLoop.open();
+   standbyTimer = eventLoop.addTimer();
+   jobTimer = eventLoop.addTimer(CLOCK_MONOTONIC);
+   eventLoop.setInterval(jobTimer, max(jobCheckInterval, 50));
+
+   if (httpServer->isOpen())
+      eventLoop.addFd(httpServer->getFd());
 
    sem->p();
    serial->open(ttyDeviceSvc);
@@ -1220,16 +1397,42 @@ int P4d::loop()
 
       meanwhile();
 
-      standbyUntil(min(nextStateAt, nextAt));
+      // commit the batched rows (sqlite engine) before sleeping
+
+      if (connection)
+         connection->flush();
+
+      // a time sync deadline passed without drift stays in the past, only a coming one counts
+
+      time_t syncAt = tSync && nextTimeSyncAt > time(0) ? nextTimeSyncAt : 0;
+
+      standbyUntil(nextWorkAt(nextStateAt));
+
+      // a cycle is kept by the profiler if it performs the update
+
+      profiler.begin();
+      profiler.start(cpMaintain);
 
       // aggregate
 
       if (aggregateHistory && nextAggregateAt <= time(0))
          aggregate();
 
+      profiler.stop(cpMaintain);
+
+      // woken up for the maintenance only? the state check would cost a request
+      //   on the serial line and move its deadline, the time sync needs it
+
+      time_t now = time(0);
+
+      if (now < nextStateAt && now < nextAt && !(syncAt && syncAt <= now))
+         continue;
+
       // update/check state
 
+      profiler.start(cpState);
       status = updateState(&currentState);
+      profiler.stop(cpState);
 
       if (status != success)
       {
@@ -1256,6 +1459,9 @@ int P4d::loop()
          nextAt = time(0);              // force on state change
 
          tell(eloAlways, "State changed to '%s'", currentState.stateinfo);
+
+         if (httpServer->streamCount())
+            httpServer->broadcast("state", jsonOfState());
       }
 
       nextStateAt = stateCheckInterval ? time(0) + stateCheckInterval : nextAt;
@@ -1267,9 +1473,11 @@ int P4d::loop()
 
       // check serial connection
 
+      profiler.start(cpCheck);
       sem->p();
       status = request->check();
       sem->v();
+      profiler.stop(cpCheck);
 
       if (status != success)
       {
@@ -1288,20 +1496,38 @@ int P4d::loop()
       mailBodyHtml = "";
 
       sem->p();
+
+      profiler.start(cpUpdate);
       update();
+      profiler.stop(cpUpdate);
 
+      profiler.start(cpErrors);
       updateErrors();
+      profiler.stop(cpErrors);
+
+      profiler.start(cpScripts);
       afterUpdate();
+      profiler.stop(cpScripts);
 
       // mail
 
+      profiler.start(cpMail);
+
       if (mail && stateChanged)
          sendStateMail();
 
       if (errorsPending)
          sendErrorMail();
 
+      profiler.stop(cpMail);
+
       sem->v();
+
+      profiler.end();
+      storeCycleStats();
+
+      if (!isEmpty(metricsFile))
+         writeMetrics(metricsFile);
    }
 
    serial->close();
@@ -1309,6 +1535,40 @@ int P4d::loop()
    return success;
 }
 
+//***************************************************************************
+// Store Cycle Stats
+//   - one row per phase of the last cycle, kept for 'cycleStats' days
+//***************************************************************************
+
+int P4d::storeCycleStats()
+{
+   const cCycleProfiler::Cycle* cycle = profiler.getLast();
+
+   if (!cycleStats || !cycle || !tableCycleStats)
+      return done;
+
+   for (int p = 0; p < cpCount; p++)
+   {
+      tableCycleStats->clear();
+      tableCycleStats->setValue("TIME", cycle->time);
+      tableCycleStats->setValue("PHASE", cyclePhaseNames[p]);
+      tableCycleStats->setValue("WALL", (long)cycle->wall[p]);
+      tableCycleStats->setValue("CPU", (long)cycle->cpu[p]);
+      tableCycleStats->store();
+   }
+
+   if (nextCycleCleanupAt <= time(0))
+   {
+      tableCycleStats->clear();
+      tableCycleStats->setValue("TIME", time(0) - cycleStats * tmeSecondsPerDay);
+      cleanupCycleStats->execute();
+
+      nextCycleCleanupAt = time(0) + tmeSecondsPerDay;
+   }
+
+   return success;
+}
+
 //***************************************************************************
 // Update State
 //***************************************************************************
@@ -1386,12 +1646,13 @@ int P4d::update()
    time_t now = time(0);
    char num[100];
 
-   w1.update();
+   // the one wire sensors are read by the thread of w1
 
    tell(eloDetail, "Reading values ...");
 
    tableValueFacts->clear();
    tableValueFacts->setValue("STATE", "A");
+   valueCache.clear();
 
    for (int f = selectActiveValueFacts->find(); f; f = selectActiveValueFacts->fetch())
    {
@@ -1473,7 +1734,13 @@ int P4d::update()
 
       else if (tableValueFacts->hasValue("TYPE", "W1"))
       {
-         double value = w1.valueOf(name);
+         double value;
+
+         if (w1.valueOf(addr, value) != success)
+         {
+            tell(eloDetail, "No value of one wire sensor '%s' available", name);
+            continue;
+         }
 
          store(now, type, addr, value, factor);
          sprintf(num, "%.2f", value / factor);
@@ -1520,12 +1787,31 @@ int P4d::update()
          }
       }
 
+      // stored sample -> value cache
+
+      valueCache.add(type, tableSamples->getIntValue("ADDRESS"), tableSamples->getFloatValue("VALUE"),
+                     tableSamples->getStrValue("TEXT"), unit,
+                     tableValueFacts->getStrValue("TITLE"), tableValueFacts->getStrValue("USRTITLE"));
+
       count++;
    }
 
    selectActiveValueFacts->freeResult();
+
+   // publish, the changed values are pushed to the event streams
+
+   std::vector<cValueCache::Value> changed;
+
+   valueCache.publish(now, &changed);
+
+   if (changed.size() && httpServer->streamCount())
+      httpServer->broadcast("values", jsonOfValues(changed, now));
+
    tell(eloAlways, "Processed %d samples, state is '%s'", count, currentState.stateinfo);
 
+   // the values of this cycle are taken from the value cache, the
+   //   persister may not have written them yet
+
    sensorAlertCheck(now);
 
    return success;
@@ -1533,6 +1819,9 @@ int P4d::update()
 
 //***************************************************************************
 // After Update
+//   - after-update.sh is called by the hook executor with the values of
+//     this update, one variable per value (P4D_<type>_<address>) and on
+//     stdin one line per value: type, address, value, unit, title (tab separated)
 //***************************************************************************
 
 void P4d::afterUpdate()
@@ -1543,8 +1832,51 @@ void P4d::afterUpdate()
 
    if (fileExists(path))
    {
+      cHookExecutor::Hook hook;
+      std::vector<cValueCache::Value> values;
+      time_t time;
+      char* buf = 0;
+
+      valueCache.snapshot(values, time);
+
+      hook.kind = cHookExecutor::hkAfterUpdate;
+      hook.path = path;
+      hook.jobId = 0;
+
+      asprintf(&buf, "P4D_TIME=%ld", time);
+      hook.env.push_back(buf);
+      free(buf);
+
+      asprintf(&buf, "P4D_STATE=%d", currentState.state);
+      hook.env.push_back(buf);
+      free(buf);
+
+      asprintf(&buf, "P4D_STATE_TEXT=%s", currentState.stateinfo ? currentState.stateinfo : "");
+      hook.env.push_back(buf);
+      free(buf);
+
+      for (unsigned int i = 0; i < values.size(); i++)
+      {
+         cValueCache::Value* v = &values[i];
+         char value[100+TB];
+
+         if (!isEmpty(v->text))
+            sstrcpy(value, v->text, sizeof(value));
+         else
+            snprintf(value, sizeof(value), "%.2f", v->value);
+
+         asprintf(&buf, "P4D_%s_%d=%s", v->type, v->address, value);
+         hook.env.push_back(buf);
+         free(buf);
+
+         asprintf(&buf, "%s\t%d\t%s\t%s\t%s\n", v->type, v->address, value, v->unit,
+                  !isEmpty(v->usrtitle) ? v->usrtitle : v->title);
+         hook.input += buf;
+         free(buf);
+      }
+
       tell(0, "Calling '%s'", path);
-      system(path);
+      hooks.submit(hook);
    }
 
    free(path);
@@ -1587,6 +1919,8 @@ int P4d::performAlertCheck(cDbRow* alertRow, time_t now, int recurse, int force)
 
    int id = alertRow->getIntValue("ID");
    int lgop = alertRow->getIntValue("LGOP");
+
+   counters.alertChecks.inc();
    time_t lastAlert = alertRow->getIntValue("LASTALERT");
    int maxRepeat = alertRow->getIntValue("MAXREPEAT");
 
@@ -1604,23 +1938,39 @@ int P4d::performAlertCheck(cDbRow* alertRow, time_t now, int recurse, int force)
    tableValueFacts->setValue("ADDRESS", addr);
    tableValueFacts->setValue("TYPE", type);
 
-   // lookup samples
+   // lookup the value, of the current cycle in the value cache, older ones in the samples
 
-   tableSamples->clear();
-   tableSamples->setValue("ADDRESS", addr);
-   tableSamples->setValue("TYPE", type);
-   tableSamples->setValue("AGGREGATE", "S");
-   tableSamples->setValue("TIME", now);
+   cValueCache::Value cached;
+   double value;
 
-   if (!tableSamples->find() || !tableValueFacts->find())
+   if (valueCache.lookup(type, addr, now, &cached) == success)
+   {
+      value = cached.value;
+   }
+   else
+   {
+      tableSamples->clear();
+      tableSamples->setValue("ADDRESS", addr);
+      tableSamples->setValue("TYPE", type);
+      tableSamples->setValue("AGGREGATE", "S");
+      tableSamples->setValue("TIME", now);
+
+      if (!tableSamples->find())
+      {
+         tell(eloAlways, "Info: Can't perform sensor check for %s/%d '%s'", type, addr, l2pTime(now).c_str());
+         return 0;
+      }
+
+      value = tableSamples->getFloatValue("VALUE");
+   }
+
+   if (!tableValueFacts->find())
    {
       tell(eloAlways, "Info: Can't perform sensor check for %s/%d '%s'", type, addr, l2pTime(now).c_str());
       return 0;
    }
 
-   // data from samples and value facts
-
-   double value = tableSamples->getFloatValue("VALUE");
+   // data from value facts
 
    const char* title = tableValueFacts->getStrValue("TITLE");
    const char* unit = tableValueFacts->getStrValue("UNIT");
@@ -1719,6 +2069,8 @@ int P4d::performAlertCheck(cDbRow* alertRow, time_t now, int recurse, int force)
 
    if (alert && !recurse)
    {
+      counters.alerts.inc();
+
       tableSensorAlert->clear();
       tableSensorAlert->setValue("ID", id);
 
@@ -1797,6 +2149,16 @@ int P4d::aggregate()
    time_t history = time(0) - (aggregateHistory * tmeSecondsPerDay);
    int aggCount = 0;
 
+   // the aggregation statement uses MySQL date arithmetic
+
+   if (cDbConnection::getEngineType() != cDbEngine::etMySql)
+   {
+      tell(eloAlways, "Aggregation not supported by the %s engine, skipping",
+           cDbEngine::toName(cDbConnection::getEngineType()));
+      scheduleAggregate();
+      return done;
+   }
+
    asprintf(&stmt,
             "replace into samples "
             "  select address, type, 'A' as aggregate, "
@@ -1818,21 +2180,14 @@ int P4d::aggregate()
 
    if (connection->query(aggCount, "%s", stmt) == success)
    {
-      int delCount = 0;
-
       tell(eloDebug, "Aggregation: [%s]", stmt);
-      free(stmt);
 
-      // Einzelmesspunkte löschen ...
+      tell(eloAlways, "Aggregation with interval of %d minutes done; "
+           "Created %d aggregation rows", aggregateInterval, aggCount);
 
-      asprintf(&stmt, "aggregate != 'A' and time <= from_unixtime(%ld)", history);
+      // Einzelmesspunkte löschen, in Häppchen durch den Retention Thread
 
-      if (tableSamples->deleteWhere(stmt, delCount) == success)
-      {
-         tell(eloAlways, "Aggregation with interval of %d minutes done; "
-              "Created %d aggregation rows, deleted %d sample rows",
-              aggregateInterval, aggCount, delCount);
-      }
+      retention.setAggregatedUntil(history);
    }
 
    free(stmt);
@@ -2198,7 +2553,7 @@ int P4d::sendMail(const char* receiver, const char* subject, const char* body, c
    asprintf(&command, "%s '%s' '%s' '%s' %s", mailScript,
             subject, body, mimeType, receiver);
 
-   system(command);
+   notifier.request(cNotifier::ntCommand, command);
    free(command);
 
    tell(eloAlways, "Send mail '%s' with [%s] to '%s'",
@@ -19,6 +19,13 @@
 #include "p4io.h"
 #include "w1.h"
 #include "lib/curl.h"
+#include "lib/httpd.h"
+#include "lib/eventloop.h"
+#include "retention.h"
+#include "valuecache.h"
+#include "profiler.h"
+#include "pipeline.h"
+#include "hooks.h"
 #include "HISTORY.h"
 
 #define confDirDefault "/etc/p4d"
@@ -32,15 +39,27 @@ extern char dbPass[];
 extern char ttyDeviceSvc[];
 extern int interval;
 extern int stateCheckInterval;
+extern int jobCheckInterval;         // [ms] check for pending WEBIF jobs
 extern int aggregateInterval;        // aggregate interval in minutes
 extern int aggregateHistory;         // history in days
+extern int partitionRetention;       // retention of partitioned tables in months (na -> dictionary)
+extern int archiveHistory;           // move samples older than n days to the archive (0 -> off)
+extern char archivePath[];
+extern char retentionPolicy[];       // per type retention in days, "VA:730, DI:90, *:0"
+extern int validateSchema;           // force the check of table structure and indices
+extern char w1Path[];                // sysfs directory of the one wire devices
+extern int httpPort;                 // port of the HTTP/JSON API (0 -> off)
+extern char captureFile[];           // binary capture of the frames on the line (empty -> off)
+extern char recordFile[];            // record of the serial line for SerialReplay (empty -> off)
+extern int cycleStats;               // days to keep the cycle profile in 'cyclestats' (0 -> off)
+extern char metricsFile[];           // metrics for the textfile collector of prometheus (empty -> off)
 extern char* confDir;
 
 //***************************************************************************
 // Class P4d
 //***************************************************************************
 
-class P4d : public FroelingService
+class P4d : public FroelingService, public cHttpServer::Handler
 {
    public:
 
@@ -54,10 +73,26 @@ class P4d : public FroelingService
 	   int setup();
 	   int initialize(int truncate = no);
 
-      static void downF(int aSignal) { shutdown = yes; }
+      static void downF(int aSignal) { shutdown = yes; eventLoop.wakeup(); }
+      static void profileF(int aSignal) { profileRequested = yes; eventLoop.wakeup(); }
 
    protected:
 
+      enum CyclePhase
+      {
+         cpMaintain,
+         cpState,
+         cpCheck,
+         cpUpdate,
+         cpErrors,
+         cpScripts,
+         cpMail,
+
+         cpCount
+      };
+
+      static const char* cyclePhaseNames[];
+
       int exit();
       int initDb();
       int exitDb();
@@ -65,6 +100,7 @@ class P4d : public FroelingService
 
       int standby(int t);
       int standbyUntil(time_t until);
+      time_t nextWorkAt(time_t nextStateAt);
       int meanwhile();
 
       int update();
@@ -72,14 +108,30 @@ class P4d : public FroelingService
       void scheduleTimeSyncIn(int offset = 0);
       int scheduleAggregate();
       int aggregate();
+      int storeCycleStats();
 
       int updateErrors();
       int performWebifRequests();
       int cleanupWebifRequests();
+      int finishScriptJobs();
 
       int store(time_t now, const char* type, int address, double value,
                 unsigned int factor, const char* text = 0);
 
+      // HTTP/JSON API
+
+      int onHttpRequest(cHttpServer::Request* request, std::string& body, std::string& contentType);
+      int apiValues(cHttpServer::Request* request, std::string& body);
+      int apiW1(cHttpServer::Request* request, std::string& body);
+      int apiFacts(cHttpServer::Request* request, std::string& body);
+      int apiErrors(cHttpServer::Request* request, std::string& body);
+      int apiSeries(cHttpServer::Request* request, std::string& body);
+      std::string metrics();
+      int writeMetrics(const char* file);
+      std::string jsonOfRow(cDbTable* table);
+      std::string jsonOfValues(std::vector<cValueCache::Value>& values, time_t time);
+      std::string jsonOfState();
+
       void addParameter2Mail(const char* name, const char* value);
 
       void afterUpdate();
@@ -97,7 +149,7 @@ class P4d : public FroelingService
       int updateTimeRangeData();
       int initMenu();
       int updateScripts();
-      int callScript(const char* scriptName, const char*& result);
+      int callScript(const char* scriptName, long jobId, const char*& result);
       int hmUpdateSysVars();
       int hmSyncSysVars();
 
@@ -127,6 +179,7 @@ class P4d : public FroelingService
       cDbTable* tableTimeRanges;
       cDbTable* tableHmSysVars;
       cDbTable* tableScripts;
+      cDbTable* tableCycleStats;
 
       cDbStatement* selectActiveValueFacts;
       cDbStatement* selectAllValueFacts;
@@ -135,11 +188,13 @@ class P4d : public FroelingService
       cDbStatement* selectSensorAlerts;
       cDbStatement* selectSampleInRange;
       cDbStatement* selectPendingErrors;
+      cDbStatement* selectRecentErrors;
       cDbStatement* selectMaxTime;
       cDbStatement* selectHmSysVarByAddr;
       cDbStatement* selectScriptByName;
       cDbStatement* selectScript;
       cDbStatement* cleanupJobs;
+      cDbStatement* cleanupCycleStats;
 
       cDbValue rangeEnd;
 
@@ -151,7 +206,27 @@ class P4d : public FroelingService
       Serial* serial;
 
       W1 w1;                       // for one wire sensors
+      cDbConnectionPool dbPool;    // connections of the background threads
+      cRetention retention;        // deletes expired samples in background
+      cValueCache valueCache;      // latest values for the WEBIF
+      cPersister persister;        // writes the samples in background
+      cNotifier notifier;          // HomeMatic requests and mails in background
+      cHookExecutor hooks;         // after-update.sh and the WEBIF scripts
+      cHttpServer* httpServer;
       cCurl* curl;
+      cCycleProfiler profiler;     // time of the phases of the last cycles
+      int standbyTimer;            // timers of 'eventLoop'
+      int jobTimer;
+
+      struct Counters              // for the metrics, lock free
+      {
+         cCounter alertChecks;     // rules evaluated
+         cCounter alerts;          // mails triggered
+         cCounter hmSkipped;       // HomeMatic requests after a failure within 3 minutes
+      };
+
+      Counters counters;
+      time_t nextCycleCleanupAt;
 
       Status currentState;
       string mailBody;
@@ -179,6 +254,8 @@ class P4d : public FroelingService
       //
 
       static int shutdown;
+      static int profileRequested;
+      static cEventLoop eventLoop;   // static for the signal handlers
 };
 
 //***************************************************************************
@@ -10,6 +10,7 @@
 #include <string.h>
 #include <unistd.h>
 #include <stdlib.h>
+#include <errno.h>
 
 #include "p4io.h"
 
@@ -296,6 +297,123 @@ int P4Packet::read()
 //***************************************************************************
 // Class P4 Request
 //***************************************************************************
+
+FILE* P4Request::captureFp = 0;
+
+//***************************************************************************
+// Dump
+//   - hex and printable characters, formatted in one pass into a buffer
+//     sized for the frame
+//***************************************************************************
+
+void P4Request::dump(const char* prefix, const byte* data, int size, int elo)
+{
+   static const char* hex = "0123456789ABCDEF";
+   int len = strlen(prefix);
+   char* tmp = (char*)malloc(len + size*4 + 3 + TB);
+   char* p = tmp;
+
+   memcpy(p, prefix, len);
+   p += len;
+
+   for (int i = 0; i < size; i++)
+   {
+      *p++ = hex[data[i] >> 4];
+      *p++ = hex[data[i] & 0x0f];
+      *p++ = ' ';
+   }
+
+   memcpy(p, "   ", 3);
+   p += 3;
+
+   for (int i = 0; i < size; i++)
+      *p++ = isprint(data[i]) ? data[i] : '.';
+
+   *p = 0;
+
+   tell(elo, "%s", tmp);
+   free(tmp);
+}
+
+//***************************************************************************
+// Capture
+//***************************************************************************
+
+int P4Request::openCapture(const char* file)
+{
+   CaptureHeader header;
+   long size;
+
+   closeCapture();
+
+   if (isEmpty(file))
+      return done;
+
+   if (!(captureFp = fopen(file, "a")))
+   {
+      tell(eloAlways, "Error: Can't open capture file '%s', %s", file, strerror(errno));
+      return fail;
+   }
+
+   fseek(captureFp, 0, SEEK_END);
+
+   // flushed at once, a buffered header would be written by each process after a fork
+
+   if ((size = ftell(captureFp)) == 0)
+   {
+      memcpy(header.magic, "P4CF", 4);
+      header.version = 1;
+
+      if (fwrite(&header, sizeof(header), 1, captureFp) != 1 || fflush(captureFp) != 0)
+      {
+         tell(eloAlways, "Error: Writing capture file '%s' failed, %s", file, strerror(errno));
+         closeCapture();
+         return fail;
+      }
+   }
+
+   tell(eloAlways, "Capturing the frames to '%s'", file);
+
+   return success;
+}
+
+void P4Request::closeCapture()
+{
+   if (captureFp)
+      fclose(captureFp);
+
+   captureFp = 0;
+}
+
+void P4Request::capture(CaptureDirection direction, const timeval* time)
+{
+   CaptureRecord record;
+   timeval now;
+
+   if (!sizeBufferContent)
+      return;
+
+   if (!time)
+   {
+      gettimeofday(&now, 0);
+      time = &now;
+   }
+
+   record.sec = time->tv_sec;
+   record.usec = time->tv_usec;
+   record.direction = direction;
+   record.reserved = 0;
+   record.size = sizeBufferContent;
+
+   if (fwrite(&record, sizeof(record), 1, captureFp) != 1
+       || fwrite(buffer, 1, sizeBufferContent, captureFp) != (size_t)sizeBufferContent
+       || fflush(captureFp) != 0)
+   {
+      tell(eloAlways, "Error: Writing capture file failed, %s; capture stopped", strerror(errno));
+      closeCapture();
+   }
+}
+
 //***************************************************************************
 // Prepare Request
 //***************************************************************************
@@ -388,7 +506,15 @@ int P4Request::readByte(byte& v, int decode, int tms)
    int status;
 
    if ((status = s->look(b, tms)) != success)
+   {
+      if (status == Serial::wrnTimeout && !draining)
+      {
+         stats[lastCommand].timeouts.inc();
+         replyTimeout = yes;
+      }
+
       return status == Serial::wrnTimeout ? (int)wrnTimeout : fail;
+   }
 
    buffer[sizeBufferContent++] = b;
 
@@ -10,6 +10,7 @@
 #define _IO_P4_H_
 
 #include <arpa/inet.h>
+#include <sys/time.h>
 
 #include <time.h>
 #include <string.h>
@@ -77,13 +78,46 @@ class P4Packet : public FroelingService, public Serial
 
 //***************************************************************************
 // Request
+//   - show() formats the frame only if the log level wants it
+//   - openCapture() writes all frames as they are on the line to a binary
+//     file, a 'CaptureHeader' followed by a 'CaptureRecord' and the
+//     bytes for each frame
 //***************************************************************************
 
 class P4Request : public FroelingService
 {
    public:
 
-      P4Request(Serial* aSerial)    { s = aSerial; text = 0; clear(); }
+      enum CaptureDirection
+      {
+         cdRequest = '>',
+         cdReply   = '<'
+      };
+
+      struct CaptureHeader
+      {
+         char magic[4];                // "P4CF"
+         uint32_t version;
+      };
+
+      struct CaptureRecord
+      {
+         uint32_t sec;
+         uint32_t usec;
+         uint8_t direction;            // CaptureDirection
+         uint8_t reserved;
+         uint16_t size;                // of the frame
+      };
+
+      struct CommandStats
+      {
+         cCounter requests;
+         cCounter timeouts;            // while reading the reply
+         cCounter crcErrors;
+      };
+
+      P4Request(Serial* aSerial)    { s = aSerial; text = 0; replyStarted = no; sizeBufferContent = 0;
+                                      lastCommand = 0; replyTimeout = no; draining = no; clear(); }
       virtual ~P4Request()          { clear(); }
 
       class RequestClean
@@ -100,9 +134,13 @@ class P4Request : public FroelingService
                int count = 0;
                byte b;
 
+               req->draining = yes;
+
                while (req->readByte(b, yes, 10) == success)
                   count++;
 
+               req->draining = no;
+
                if (count)
                {
                   tell(eloAlways, "Got %d unexpected bytes", count);
@@ -117,6 +155,17 @@ class P4Request : public FroelingService
 
       int clear()
       {
+         // the reply is complete with the next request
+
+         if (replyStarted && !replyTimeout && sizeDecodedContent > sizeId + sizeSize + sizeCommand
+             && crc(decoded, sizeDecodedContent-1) != decoded[sizeDecodedContent-1])
+            stats[lastCommand].crcErrors.inc();
+
+         if (replyStarted && captureFp)
+            capture(cdReply, &replyTime);
+
+         replyStarted = no;
+         replyTimeout = no;
          free(text);
          text = 0;
          sizeBufferContent = 0;
@@ -170,9 +219,14 @@ class P4Request : public FroelingService
       {
          header.id = htons(commId);
          header.command = command;
+         lastCommand = command;
+         stats[command].requests.inc();
 
          prepareRequest();
 
+         if (captureFp)
+            capture(cdRequest);
+
          show("-> ");
 
          if (!s || !s->isOpen())
@@ -183,39 +237,20 @@ class P4Request : public FroelingService
 
       void show(const char* prefix = "", int elo = eloDebug)
       {
-         char tmp[1000];
-         *tmp = 0;
-
-         sprintf(tmp+strlen(tmp), "%s", prefix);
-
-         for (int i = 0; i < sizeBufferContent; i++)
-            sprintf(tmp+strlen(tmp), "%2.2X ", buffer[i]);
-
-         sprintf(tmp+strlen(tmp), "   ");
-
-         for (int i = 0; i < sizeBufferContent; i++)
-            sprintf(tmp+strlen(tmp), "%c", isprint(buffer[i]) ? buffer[i] : '.');
-
-         tell(elo, "%s", tmp);
+         if (elo <= MAX_ELOQUENCE && elo <= loglevel)
+            dump(prefix, buffer, sizeBufferContent, elo);
       }
 
       void showDecoded(const char* prefix = "")
       {
-         char tmp[1000];
-         *tmp = 0;
-
-         sprintf(tmp+strlen(tmp), "%s", prefix);
-
-         for (int i = 0; i < sizeDecodedContent; i++)
-            sprintf(tmp+strlen(tmp), "%2.2X ", decoded[i]);
-
-         sprintf(tmp+strlen(tmp), "   ");
+         if (eloDebug2 <= MAX_ELOQUENCE && eloDebug2 <= loglevel)
+            dump(prefix, decoded, sizeDecodedContent, eloDebug2);
+      }
 
-         for (int i = 0; i < sizeDecodedContent; i++)
-            sprintf(tmp+strlen(tmp), "%c", isprint(decoded[i]) ? decoded[i] : '.');
+      static int openCapture(const char* file);
+      static void closeCapture();
 
-         tell(eloDebug2, "%s", tmp);
-      }
+      CommandStats* getStats(byte command)  { return &stats[command]; }
 
       Header* getHeader() { return &header; }
 
@@ -225,6 +260,9 @@ class P4Request : public FroelingService
 
          clear();
 
+         replyStarted = yes;
+         gettimeofday(&replyTime, 0);
+
          if (!s || !s->isOpen())
          {
             tell(eloAlways, "Line not open, aborting read");
@@ -308,6 +346,9 @@ class P4Request : public FroelingService
       int readTimeDateExt(time_t& t);  // 7 byte
       int readText(char*& s, int size);
 
+      static void dump(const char* prefix, const byte* data, int size, int elo);
+      void capture(CaptureDirection direction, const timeval* time = 0);
+
       // data
 
       Header header;
@@ -323,7 +364,16 @@ class P4Request : public FroelingService
       byte decoded[sizeMaxRequest*2+TB];  // for debug
       int sizeDecodedContent;
 
+      int replyStarted;                 // buffer holds a reply, not captured yet
+      timeval replyTime;
+      int replyTimeout;
+      int draining;                     // reading unexpected bytes, a timeout is fine
+      byte lastCommand;
+      CommandStats stats[256];
+
       Serial* s;
+
+      static FILE* captureFp;
 };
 
 //***************************************************************************
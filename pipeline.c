@@ -0,0 +1,343 @@
+//***************************************************************************
+// p4d / Linux - Heizungs Manager
+// File pipeline.c
+// This code is distributed under the terms and conditions of the
+// GNU GENERAL PUBLIC LICENSE. See the file LICENSE for details.
+// Date 19.10.2026  Jörg Wendel
+//***************************************************************************
+
+#include "pipeline.h"
+
+//***************************************************************************
+// Class Stage
+//***************************************************************************
+
+cStage::cStage(const char* aName)
+{
+   name = aName;
+   running = no;
+   stopRequested = no;
+   busy = no;
+}
+
+cStage::~cStage()
+{
+}
+
+//***************************************************************************
+// Start / Stop
+//***************************************************************************
+
+int cStage::start()
+{
+   if (running)
+      return done;
+
+   stopRequested = no;
+
+   if (pthread_create(&thread, 0, threadFct, this) != 0)
+   {
+      tell(eloAlways, "Error: Starting %s thread failed, %s", name, strerror(errno));
+      return fail;
+   }
+
+   running = yes;
+
+   return success;
+}
+
+void cStage::stop()
+{
+   if (!running)
+      return;
+
+   mutex.Lock();
+   stopRequested = yes;
+   waitCond.Broadcast();
+   mutex.Unlock();
+
+   pthread_join(thread, 0);
+   running = no;
+}
+
+void cStage::wakeup()
+{
+   mutex.Lock();
+   waitCond.Broadcast();
+   mutex.Unlock();
+}
+
+//***************************************************************************
+// Wait Idle
+//***************************************************************************
+
+int cStage::waitIdle(int timeoutMs)
+{
+   uint64_t end = cTimeMs::Now() + timeoutMs;
+   int status = success;
+
+   if (!running)
+      return fail;
+
+   mutex.Lock();
+   waitCond.Broadcast();
+
+   while (queued() || busy)
+   {
+      uint64_t now = cTimeMs::Now();
+
+      if (now >= end)
+      {
+         status = fail;
+         break;
+      }
+
+      idleCond.TimedWait(mutex, end - now);
+   }
+
+   mutex.Unlock();
+
+   return status;
+}
+
+//***************************************************************************
+// Thread
+//***************************************************************************
+
+void* cStage::threadFct(void* arg)
+{
+   ((cStage*)arg)->action();
+   return 0;
+}
+
+void cStage::action()
+{
+   tell(eloAlways, "%s thread started", name);
+
+   while (true)
+   {
+      int count;
+
+      busy = yes;
+      count = processQueue();
+
+      mutex.Lock();
+      busy = no;
+
+      if (!queued())
+         idleCond.Broadcast();
+
+      // at stop the queue is emptied as long as there is progress
+
+      if (stopRequested && (!queued() || !count))
+      {
+         mutex.Unlock();
+
+         if (queued())
+            tell(eloAlways, "Warning: %s stopped with %u pending items", name, queued());
+
+         break;
+      }
+
+      if (!queued() || !count)
+         waitCond.TimedWait(mutex, 1000);
+
+      mutex.Unlock();
+   }
+
+   exitThread();
+
+   tell(eloAlways, "%s thread stopped", name);
+}
+
+//***************************************************************************
+// Class Persister
+//***************************************************************************
+
+cPersister::cPersister()
+   : cStage("Persister"),
+     queue("samples", 1024)
+{
+   pool = 0;
+}
+
+cPersister::~cPersister()
+{
+   stop();
+}
+
+//***************************************************************************
+// Store
+//   - called by the producer thread only
+//***************************************************************************
+
+int cPersister::store(time_t time, const char* type, int address, double value, const char* text)
+{
+   Sample s;
+
+   s.time = time;
+   sstrcpy(s.type, type, sizeof(s.type));
+   s.address = address;
+   s.value = value;
+   sstrcpy(s.text, text ? text : "", sizeof(s.text));
+
+   if (queue.push(s) != success)
+   {
+      tell(eloAlways, "Warning: Sample queue full, sample %s:0x%x dropped", type, address);
+      return fail;
+   }
+
+   if (queue.size() == 1)
+      wakeup();
+
+   return success;
+}
+
+//***************************************************************************
+// Process Queue
+//***************************************************************************
+
+int cPersister::processQueue()
+{
+   cDbConnectionPool::cPooled* pooled;
+   cDbTable* tableSamples;
+   Sample s;
+   int count = 0;
+
+   if (!queue.size() || !pool)
+      return 0;
+
+   // a lost connection is reconnected by the pool, retry with the next sample
+
+   if (!(pooled = pool->acquire(1000, createStatements, this)))
+      return 0;
+
+   tableSamples = ((cStatements*)pooled->getSet(createStatements))->tableSamples;
+
+   while (queue.pop(s) == success)
+   {
+      tableSamples->clear();
+      tableSamples->setValue("TIME", s.time);
+      tableSamples->setValue("ADDRESS", s.address);
+      tableSamples->setValue("TYPE", s.type);
+      tableSamples->setValue("AGGREGATE", "S");
+      tableSamples->setValue("VALUE", s.value);
+      tableSamples->setValue("TEXT", *s.text ? s.text : 0);
+      tableSamples->setValue("SAMPLES", 1);
+
+      if (tableSamples->store() != success)
+         tell(eloAlways, "Error: Storing sample %s:0x%x failed", s.type, s.address);
+
+      processed.inc();
+      count++;
+   }
+
+   // visible for the other connections (batch of the sqlite engine)
+
+   pooled->getConnection()->flush();
+   pool->release(pooled);
+
+   return count;
+}
+
+//***************************************************************************
+// Statements
+//***************************************************************************
+
+int cPersister::cStatements::init(cDbConnection* connection)
+{
+   tableSamples = new cDbTable(connection, "samples");
+
+   return tableSamples->open();
+}
+
+int cPersister::cStatements::exit()
+{
+   delete tableSamples;    tableSamples = 0;
+
+   return done;
+}
+
+//***************************************************************************
+// Class Notifier
+//***************************************************************************
+
+cNotifier::cNotifier()
+   : cStage("Notifier"),
+     queue("notifications", 256)
+{
+   urlFailedAt = 0;
+}
+
+cNotifier::~cNotifier()
+{
+   stop();
+}
+
+//***************************************************************************
+// Request
+//   - called by the producer thread only
+//***************************************************************************
+
+int cNotifier::request(Type type, const char* target)
+{
+   Notification n;
+
+   n.type = type;
+   n.target = target;
+
+   if (queue.push(n) != success)
+   {
+      tell(eloAlways, "Warning: Notification queue full, '%s' dropped", target);
+      return fail;
+   }
+
+   wakeup();
+
+   return success;
+}
+
+//***************************************************************************
+// Process Queue
+//***************************************************************************
+
+int cNotifier::processQueue()
+{
+   Notification n;
+   int count = 0;
+
+   while (queue.pop(n) == success)
+   {
+      if (n.type == ntUrl)
+      {
+         MemoryStruct data;
+         int size = 0;
+
+         if (isUrlBlocked())
+         {
+            tell(eloDetail, "Skipping request of [%s] due to error within the last 3 minutes", n.target.c_str());
+         }
+         else if (curl.init() != success || curl.downloadFile(n.target.c_str(), size, &data) != success)
+         {
+            tell(eloAlways, "Error: Request of [%s] failed", n.target.c_str());
+            urlFailedAt = time(0);
+            urlsFailed.inc();
+         }
+         else
+         {
+            tell(eloDetail, "Info: Call of [%s] succeeded", n.target.c_str());
+            urlsOk.inc();
+         }
+      }
+      else
+      {
+         system(n.target.c_str());
+         commands.inc();
+      }
+
+      processed.inc();
+      count++;
+   }
+
+   return count;
+}
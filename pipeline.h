@@ -0,0 +1,160 @@
+//***************************************************************************
+// p4d / Linux - Heizungs Manager
+// File pipeline.h
+// This code is distributed under the terms and conditions of the
+// GNU GENERAL PUBLIC LICENSE. See the file LICENSE for details.
+// Date 19.10.2026  Jörg Wendel
+//***************************************************************************
+
+#ifndef _PIPELINE_H_
+#define _PIPELINE_H_
+
+#include <pthread.h>
+
+#include <string>
+
+#include "lib/db.h"
+#include "lib/curl.h"
+#include "lib/spscqueue.h"
+
+//***************************************************************************
+// Class Stage
+//   - thread of the p4d pipeline consuming one SPSC queue, the producer
+//     is the thread of P4d::loop() which owns the serial line
+//   - stop() lets the thread empty its queue before it ends
+//***************************************************************************
+
+class cStage
+{
+   public:
+
+      cStage(const char* aName);
+      virtual ~cStage();
+
+      int start();
+      void stop();
+      void wakeup();
+
+      int waitIdle(int timeoutMs);    // until all queued items are processed
+
+      const char* getName()           { return name; }
+      virtual unsigned int queued() = 0;
+
+      cCounter processed;
+
+   protected:
+
+      static void* threadFct(void* arg);
+      void action();
+
+      virtual int processQueue() = 0;  // count of processed items
+      virtual void idle() {}
+      virtual void exitThread() {}
+
+      const char* name;
+      pthread_t thread;
+      int running;
+      int stopRequested;
+      volatile int busy;              // processing popped items
+      cMyMutex mutex;
+      cCondVar waitCond;
+      cCondVar idleCond;              // broadcast when the queue is processed
+};
+
+//***************************************************************************
+// Class Persister
+//   - writes the samples by a connection of the pool, acquired per batch
+//***************************************************************************
+
+class cPersister : public cStage
+{
+   public:
+
+      struct Sample
+      {
+         time_t time;
+         char type[2+TB];
+         int address;
+         double value;
+         char text[50+TB];
+      };
+
+      cPersister();
+      virtual ~cPersister();
+
+      int store(time_t time, const char* type, int address, double value, const char* text);
+      void setPool(cDbConnectionPool* aPool)  { pool = aPool; }
+
+      virtual unsigned int queued()   { return queue.size(); }
+
+      cSpscQueue<Sample> queue;
+
+   protected:
+
+      class cStatements : public cDbStatementSet
+      {
+         public:
+
+            cStatements()                       { tableSamples = 0; }
+            virtual ~cStatements()              { exit(); }
+
+            virtual int init(cDbConnection* connection);
+            virtual int exit();
+
+            cDbTable* tableSamples;
+      };
+
+      static cDbStatementSet* createStatements(void* arg)  { return new cStatements(); }
+
+      virtual int processQueue();
+
+      cDbConnectionPool* pool;
+};
+
+//***************************************************************************
+// Class Notifier
+//   - HomeMatic requests and mail commands, slow network and script calls
+//     which shouldn't delay the reading of the heating
+//***************************************************************************
+
+class cNotifier : public cStage
+{
+   public:
+
+      enum Type
+      {
+         ntUrl,                        // HTTP GET, e.g. a HomeMatic sysvar change
+         ntCommand                     // shell command, e.g. the mail script
+      };
+
+      struct Notification
+      {
+         int type;
+         std::string target;
+      };
+
+      cNotifier();
+      virtual ~cNotifier();
+
+      int request(Type type, const char* target);
+
+      int isUrlBlocked()              { return urlFailedAt > time(0) - 3*tmeSecondsPerMinute; }
+      virtual unsigned int queued()   { return queue.size(); }
+
+      cSpscQueue<Notification> queue;
+
+      cCounter urlsOk;
+      cCounter urlsFailed;
+      cCounter commands;
+
+   protected:
+
+      virtual int processQueue();
+      virtual void exitThread()       { curl.exit(); }
+
+      cCurl curl;
+      volatile time_t urlFailedAt;    // on fail retry not before 3 minutes
+};
+
+//***************************************************************************
+#endif // _PIPELINE_H_
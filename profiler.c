@@ -0,0 +1,187 @@
+//***************************************************************************
+// p4d / Linux - Heizungs Manager
+// File profiler.c
+// This code is distributed under the terms and conditions of the
+// GNU GENERAL PUBLIC LICENSE. See the file LICENSE for details.
+// Date 19.10.2026  Jörg Wendel
+//***************************************************************************
+
+#include <algorithm>
+#include <vector>
+
+#include "profiler.h"
+
+//***************************************************************************
+// Object
+//***************************************************************************
+
+cCycleProfiler::cCycleProfiler(const char* const* aNames, int aCount)
+{
+   names = aNames;
+   phaseCount = min(aCount, (int)maxPhases);
+   running = no;
+   next = 0;
+   cycleCount = 0;
+   totalCycles = 0;
+
+   memset(&current, 0, sizeof(current));
+   memset(totalWall, 0, sizeof(totalWall));
+}
+
+//***************************************************************************
+// Clocks
+//***************************************************************************
+
+uint64_t cCycleProfiler::wallUs()
+{
+   timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+
+   return ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+uint64_t cCycleProfiler::cpuUs()
+{
+   timespec ts;
+
+   clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+
+   return ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+//***************************************************************************
+// Begin / End of a Cycle
+//***************************************************************************
+
+void cCycleProfiler::begin()
+{
+   memset(&current, 0, sizeof(current));
+   current.time = time(0);
+   running = yes;
+}
+
+int cCycleProfiler::end()
+{
+   if (!running)
+      return fail;
+
+   ring[next] = current;
+   next = (next + 1) % maxCycles;
+   cycleCount = min(cycleCount + 1, (int)maxCycles);
+   running = no;
+
+   totalCycles++;
+
+   for (int p = 0; p < phaseCount; p++)
+      totalWall[p] += current.wall[p];
+
+   return success;
+}
+
+//***************************************************************************
+// Start / Stop of a Phase
+//***************************************************************************
+
+void cCycleProfiler::start(int phase)
+{
+   if (phase < 0 || phase >= phaseCount)
+      return;
+
+   wallStart[phase] = wallUs();
+   cpuStart[phase] = cpuUs();
+}
+
+void cCycleProfiler::stop(int phase)
+{
+   if (!running || phase < 0 || phase >= phaseCount)
+      return;
+
+   current.wall[phase] += wallUs() - wallStart[phase];
+   current.cpu[phase] += cpuUs() - cpuStart[phase];
+}
+
+//***************************************************************************
+// Percentile
+//   - nearest rank of the kept cycles, 'phase' == phaseCount for the
+//     sum of all phases
+//***************************************************************************
+
+uint32_t cCycleProfiler::percentile(int phase, int percent, int cpu)
+{
+   std::vector<uint32_t> values;
+
+   if (!cycleCount)
+      return 0;
+
+   for (int c = 0; c < cycleCount; c++)
+   {
+      const uint32_t* v = cpu ? ring[c].cpu : ring[c].wall;
+      uint32_t sum = 0;
+
+      if (phase < phaseCount)
+         sum = v[phase];
+      else
+         for (int p = 0; p < phaseCount; p++)
+            sum += v[p];
+
+      values.push_back(sum);
+   }
+
+   size_t rank = max(1, (percent * cycleCount + 99) / 100) - 1;
+
+   std::nth_element(values.begin(), values.begin() + rank, values.end());
+
+   return values[rank];
+}
+
+//***************************************************************************
+// Total Wall
+//   - 'phase' == phaseCount for the sum of all phases
+//***************************************************************************
+
+uint64_t cCycleProfiler::getTotalWall(int phase)
+{
+   uint64_t sum = 0;
+
+   if (phase < phaseCount)
+      return totalWall[phase];
+
+   for (int p = 0; p < phaseCount; p++)
+      sum += totalWall[p];
+
+   return sum;
+}
+
+//***************************************************************************
+// Report
+//***************************************************************************
+
+void cCycleProfiler::report()
+{
+   const Cycle* last = getLast();
+
+   tell(eloAlways, "Cycle profile of the last %d cycles [ms]", cycleCount);
+
+   if (!last)
+      return;
+
+   tell(eloAlways, "%-12s %9s %9s %9s %9s %9s %9s", "phase", "last", "p50", "p90", "p99", "max", "cpu p50");
+
+   for (int p = 0; p <= phaseCount; p++)
+   {
+      uint32_t l = 0;
+
+      if (p < phaseCount)
+         l = last->wall[p];
+      else
+         for (int i = 0; i < phaseCount; i++)
+            l += last->wall[i];
+
+      tell(eloAlways, "%-12s %9.1f %9.1f %9.1f %9.1f %9.1f %9.1f",
+           p < phaseCount ? names[p] : "total", l / 1000.0,
+           percentile(p, 50) / 1000.0, percentile(p, 90) / 1000.0,
+           percentile(p, 99) / 1000.0, percentile(p, 100) / 1000.0,
+           percentile(p, 50, yes) / 1000.0);
+   }
+}
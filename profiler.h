@@ -0,0 +1,80 @@
+//***************************************************************************
+// p4d / Linux - Heizungs Manager
+// File profiler.h
+// This code is distributed under the terms and conditions of the
+// GNU GENERAL PUBLIC LICENSE. See the file LICENSE for details.
+// Date 19.10.2026  Jörg Wendel
+//***************************************************************************
+
+#ifndef _PROFILER_H_
+#define _PROFILER_H_
+
+#include <stdint.h>
+#include <time.h>
+
+#include "lib/common.h"
+
+//***************************************************************************
+// Class Cycle Profiler
+//   - wall and cpu time (of the calling thread) of each phase of a cycle,
+//     a phase may be entered several times per cycle
+//   - the last 'maxCycles' cycles are kept in a ring for the percentiles
+//***************************************************************************
+
+class cCycleProfiler
+{
+   public:
+
+      enum Misc
+      {
+         maxPhases = 10,
+         maxCycles = 256
+      };
+
+      struct Cycle
+      {
+         time_t time;                  // begin of the cycle
+         uint32_t wall[maxPhases];     // [us]
+         uint32_t cpu[maxPhases];      // [us]
+      };
+
+      cCycleProfiler(const char* const* aNames, int aCount);
+
+      void begin();
+      void start(int phase);
+      void stop(int phase);
+      int end();
+
+      int getPhaseCount()               { return phaseCount; }
+      const char* getName(int phase)    { return names[phase]; }
+      int getCycleCount()               { return cycleCount; }
+      const Cycle* getLast()            { return cycleCount ? &ring[(next+maxCycles-1) % maxCycles] : 0; }
+      uint64_t getTotalCycles()         { return totalCycles; }
+      uint64_t getTotalWall(int phase);
+
+      uint32_t percentile(int phase, int percent, int cpu = no);
+      void report();
+
+   protected:
+
+      static uint64_t wallUs();
+      static uint64_t cpuUs();
+
+      const char* const* names;
+      int phaseCount;
+
+      Cycle current;
+      int running;
+      uint64_t wallStart[maxPhases];
+      uint64_t cpuStart[maxPhases];
+
+      Cycle ring[maxCycles];
+      int next;
+      int cycleCount;
+
+      uint64_t totalCycles;             // since the start
+      uint64_t totalWall[maxPhases];    // [us]
+};
+
+//***************************************************************************
+#endif // _PROFILER_H_
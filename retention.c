@@ -0,0 +1,787 @@
+//***************************************************************************
+// p4d / Linux - Heizungs Manager
+// File retention.c
+// This code is distributed under the terms and conditions of the
+// GNU GENERAL PUBLIC LICENSE. See the file LICENSE for details.
+// Date 19.10.2026  Jörg Wendel
+//***************************************************************************
+
+#include <errno.h>
+
+#include <vector>
+
+#include "retention.h"
+
+int cRetention::chunkRows = 1000;
+int cRetention::pauseMs = 250;
+int cRetention::checkInterval = tmeSecondsPerHour;
+
+cDbFieldDef horizonDef("time", "time", cDBS::ffDateTime, 0, cDBS::ftData);
+
+//***************************************************************************
+// Object
+//***************************************************************************
+
+cRetention::cRetention()
+{
+   running = no;
+   stopRequested = no;
+   triggered = no;
+   aggregatedUntil = 0;
+   partitionRetention = na;
+   nextPartitionCheckAt = 0;
+   archiveDays = 0;
+   nextArchiveAt = 0;
+
+   pool = 0;
+   connection = 0;
+   db = 0;
+}
+
+cRetention::~cRetention()
+{
+   stop();
+}
+
+//***************************************************************************
+// Set Policies
+//***************************************************************************
+
+int cRetention::setPolicies(const char* config)
+{
+   char* buf = strdup(config);
+   char* p = buf;
+   int status = success;
+
+   mutex.Lock();
+   policies.clear();
+
+   while (p && *p)
+   {
+      char* next = strchr(p, ',');
+      char* days;
+
+      if (next)
+         *next++ = 0;
+
+      allTrim(p);
+
+      if (*p)
+      {
+         if (!(days = strchr(p, ':')))
+         {
+            tell(eloAlways, "Error: Invalid retention policy '%s', expected <type>:<days>", p);
+            status = fail;
+         }
+         else
+         {
+            *days++ = 0;
+            allTrim(p);
+            policies[p] = atoi(days);
+         }
+      }
+
+      p = next;
+   }
+
+   mutex.Unlock();
+   free(buf);
+
+   return status;
+}
+
+void cRetention::setArchive(const char* path, int days)
+{
+   mutex.Lock();
+   archivePath = path;
+   archiveDays = days;
+   mutex.Unlock();
+}
+
+void cRetention::setAggregatedUntil(time_t until)
+{
+   mutex.Lock();
+   aggregatedUntil = until;
+   mutex.Unlock();
+
+   trigger();
+}
+
+int cRetention::isActive()
+{
+   std::map<std::string, int>::iterator it;
+   int active;
+
+   mutex.Lock();
+
+   active = aggregatedUntil > 0;
+
+   for (it = policies.begin(); it != policies.end(); it++)
+      if (it->second > 0)
+         active = yes;
+
+   mutex.Unlock();
+
+   return active;
+}
+
+//***************************************************************************
+// Horizon Of
+//   - samples of the type up to the horizon are expired,
+//     0 if the type is kept
+//***************************************************************************
+
+time_t cRetention::horizonOf(const char* type, const char* aggregate)
+{
+   std::map<std::string, int>::iterator it;
+   time_t horizon = 0;
+
+   mutex.Lock();
+
+   if ((it = policies.find(type)) == policies.end())
+      it = policies.find("*");
+
+   if (it != policies.end() && it->second > 0)
+      horizon = time(0) - it->second * tmeSecondsPerDay;
+
+   // raw samples are replaced by the aggregated ones
+
+   if (strcmp(aggregate, "A") != 0 && aggregatedUntil > horizon)
+      horizon = aggregatedUntil;
+
+   mutex.Unlock();
+
+   return horizon;
+}
+
+//***************************************************************************
+// Start / Stop
+//***************************************************************************
+
+int cRetention::start()
+{
+   if (running)
+      return done;
+
+   stopRequested = no;
+
+   if (pthread_create(&thread, 0, threadFct, this) != 0)
+   {
+      tell(eloAlways, "Error: Starting retention thread failed, %s", strerror(errno));
+      return fail;
+   }
+
+   running = yes;
+
+   return success;
+}
+
+void cRetention::stop()
+{
+   if (!running)
+      return;
+
+   mutex.Lock();
+   stopRequested = yes;
+   waitCond.Broadcast();
+   mutex.Unlock();
+
+   pthread_join(thread, 0);
+   running = no;
+}
+
+void cRetention::trigger()
+{
+   mutex.Lock();
+   triggered = yes;
+   waitCond.Broadcast();
+   mutex.Unlock();
+}
+
+//***************************************************************************
+// Pause
+//   - no if stop is requested
+//***************************************************************************
+
+int cRetention::pause(int ms)
+{
+   mutex.Lock();
+
+   if (!stopRequested && ms > 0)
+      waitCond.TimedWait(mutex, ms);
+
+   int stopped = stopRequested;
+   mutex.Unlock();
+
+   return !stopped;
+}
+
+//***************************************************************************
+// Thread
+//***************************************************************************
+
+void* cRetention::threadFct(void* arg)
+{
+   ((cRetention*)arg)->action();
+   return 0;
+}
+
+void cRetention::action()
+{
+   tell(eloAlways, "Retention thread started");
+
+   while (!stopRequested)
+   {
+      int partitionsDue = time(0) >= nextPartitionCheckAt && hasPartitions();
+
+      mutex.Lock();
+      int archiveDue = archiveDays > 0 && time(0) >= nextArchiveAt;
+      mutex.Unlock();
+
+      if (pool && (isActive() || partitionsDue || archiveDue))
+      {
+         cDbConnectionPool::cPooled* pooled = pool->acquire(10000, createStatements, this);
+
+         // a lost connection is reconnected by the pool at the next run
+
+         if (pooled)
+         {
+            connection = pooled->getConnection();
+            db = (cStatements*)pooled->getSet(createStatements);
+
+            if (partitionsDue)
+               maintainPartitions();
+
+            if (archiveDue && archive() != success)
+               nextArchiveAt = 0;     // retry with the next run
+
+            if (isActive())
+               run();
+
+            connection = 0;
+            db = 0;
+            pool->release(pooled);
+         }
+      }
+
+      mutex.Lock();
+
+      if (!stopRequested && !triggered)
+         waitCond.TimedWait(mutex, checkInterval * 1000);
+
+      triggered = no;
+      mutex.Unlock();
+   }
+
+   tell(eloAlways, "Retention thread stopped");
+}
+
+//***************************************************************************
+// Statements
+//***************************************************************************
+
+cRetention::cStatements::cStatements()
+{
+   tableSamples = 0;
+   selectSensors = 0;
+   selectChunkEnd = 0;
+   deleteChunk = 0;
+   selectArchiveSensors = 0;
+   selectArchiveSamples = 0;
+   selectArchiveChunkEnd = 0;
+   deleteArchived = 0;
+
+   horizonValue.setField(&horizonDef);
+   fromValue.setField(&horizonDef);
+}
+
+int cRetention::cStatements::init(cDbConnection* connection)
+{
+   int status = success;
+
+   tableSamples = new cDbTable(connection, "samples");
+
+   if (tableSamples->open() != success)
+      return fail;
+
+   // select address, type, aggregate from samples
+   //    where time <= ?
+   //    group by address, type, aggregate
+
+   selectSensors = new cDbStatement(tableSamples);
+
+   selectSensors->build("select ");
+   selectSensors->bind("ADDRESS", cDBS::bndOut);
+   selectSensors->bind("TYPE", cDBS::bndOut, ", ");
+   selectSensors->bind("AGGREGATE", cDBS::bndOut, ", ");
+   selectSensors->build(" from %s where ", tableSamples->TableName());
+   selectSensors->bindCmp(0, &horizonValue, "<=");
+   selectSensors->build(" group by %s, %s, %s",
+                        tableSamples->getField("ADDRESS")->getDbName(),
+                        tableSamples->getField("TYPE")->getDbName(),
+                        tableSamples->getField("AGGREGATE")->getDbName());
+
+   status += selectSensors->prepare();
+
+   // last row of the next chunk along the primary key
+   //   select time from samples
+   //     where address = ? and type = ? and aggregate = ? and time <= ?
+   //     order by time limit 1 offset <chunkRows-1>
+
+   selectChunkEnd = new cDbStatement(tableSamples);
+
+   selectChunkEnd->build("select ");
+   selectChunkEnd->bind("TIME", cDBS::bndOut);
+   selectChunkEnd->build(" from %s where ", tableSamples->TableName());
+   selectChunkEnd->bind("ADDRESS", cDBS::bndIn | cDBS::bndSet);
+   selectChunkEnd->bind("TYPE", cDBS::bndIn | cDBS::bndSet, " and ");
+   selectChunkEnd->bind("AGGREGATE", cDBS::bndIn | cDBS::bndSet, " and ");
+   selectChunkEnd->bindCmp(0, &horizonValue, "<=", " and ");
+   selectChunkEnd->build(" order by %s limit 1 offset %d",
+                         tableSamples->getField("TIME")->getDbName(), (int)max(chunkRows, 1) - 1);
+
+   status += selectChunkEnd->prepare();
+
+   //   delete from samples
+   //     where address = ? and type = ? and aggregate = ? and time <= ?
+
+   deleteChunk = new cDbStatement(tableSamples);
+
+   deleteChunk->build("delete from %s where ", tableSamples->TableName());
+   deleteChunk->bind("ADDRESS", cDBS::bndIn | cDBS::bndSet);
+   deleteChunk->bind("TYPE", cDBS::bndIn | cDBS::bndSet, " and ");
+   deleteChunk->bind("AGGREGATE", cDBS::bndIn | cDBS::bndSet, " and ");
+   deleteChunk->bindCmp(0, "TIME", 0, "<=", " and ");
+
+   status += deleteChunk->prepare();
+
+   // the archive holds values only, rows with a text stay in the table
+
+   const char* text = tableSamples->getField("TEXT")->getDbName();
+
+   // select address, type, aggregate, min(time) from samples
+   //    where time < ? and type <> 'UD' and (text is null or text = '')
+   //    group by address, type, aggregate
+
+   selectArchiveSensors = new cDbStatement(tableSamples);
+
+   selectArchiveSensors->build("select ");
+   selectArchiveSensors->bind("ADDRESS", cDBS::bndOut);
+   selectArchiveSensors->bind("TYPE", cDBS::bndOut, ", ");
+   selectArchiveSensors->bind("AGGREGATE", cDBS::bndOut, ", ");
+   selectArchiveSensors->bind("TIME", cDBS::bndOut, ", min(");
+   selectArchiveSensors->build(") from %s where ", tableSamples->TableName());
+   selectArchiveSensors->bindCmp(0, &horizonValue, "<");
+   selectArchiveSensors->build(" and %s <> 'UD'", tableSamples->getField("TYPE")->getDbName());
+   selectArchiveSensors->build(" and (%s is null or %s = '')", text, text);
+   selectArchiveSensors->build(" group by %s, %s, %s",
+                               tableSamples->getField("ADDRESS")->getDbName(),
+                               tableSamples->getField("TYPE")->getDbName(),
+                               tableSamples->getField("AGGREGATE")->getDbName());
+
+   status += selectArchiveSensors->prepare();
+
+   // select time, value from samples
+   //   where address = ? and type = ? and aggregate = ? and time >= ? and time < ?
+   //     and (text is null or text = '')
+   //   order by time
+
+   selectArchiveSamples = new cDbStatement(tableSamples);
+
+   selectArchiveSamples->build("select ");
+   selectArchiveSamples->bind("TIME", cDBS::bndOut);
+   selectArchiveSamples->bind("VALUE", cDBS::bndOut, ", ");
+   selectArchiveSamples->build(" from %s where ", tableSamples->TableName());
+   selectArchiveSamples->bind("ADDRESS", cDBS::bndIn | cDBS::bndSet);
+   selectArchiveSamples->bind("TYPE", cDBS::bndIn | cDBS::bndSet, " and ");
+   selectArchiveSamples->bind("AGGREGATE", cDBS::bndIn | cDBS::bndSet, " and ");
+   selectArchiveSamples->bindCmp(0, &fromValue, ">=", " and ");
+   selectArchiveSamples->bindCmp(0, &horizonValue, "<", " and ");
+   selectArchiveSamples->build(" and (%s is null or %s = '')", text, text);
+   selectArchiveSamples->build(" order by %s", tableSamples->getField("TIME")->getDbName());
+
+   status += selectArchiveSamples->prepare();
+
+   // last archived row of the next chunk
+   //   select time from samples
+   //     where address = ? and type = ? and aggregate = ? and time >= ? and time < ?
+   //       and (text is null or text = '')
+   //     order by time limit 1 offset <chunkRows-1>
+
+   selectArchiveChunkEnd = new cDbStatement(tableSamples);
+
+   selectArchiveChunkEnd->build("select ");
+   selectArchiveChunkEnd->bind("TIME", cDBS::bndOut);
+   selectArchiveChunkEnd->build(" from %s where ", tableSamples->TableName());
+   selectArchiveChunkEnd->bind("ADDRESS", cDBS::bndIn | cDBS::bndSet);
+   selectArchiveChunkEnd->bind("TYPE", cDBS::bndIn | cDBS::bndSet, " and ");
+   selectArchiveChunkEnd->bind("AGGREGATE", cDBS::bndIn | cDBS::bndSet, " and ");
+   selectArchiveChunkEnd->bindCmp(0, &fromValue, ">=", " and ");
+   selectArchiveChunkEnd->bindCmp(0, &horizonValue, "<", " and ");
+   selectArchiveChunkEnd->build(" and (%s is null or %s = '')", text, text);
+   selectArchiveChunkEnd->build(" order by %s limit 1 offset %d",
+                                tableSamples->getField("TIME")->getDbName(), (int)max(chunkRows, 1) - 1);
+
+   status += selectArchiveChunkEnd->prepare();
+
+   //   delete from samples
+   //     where address = ? and type = ? and aggregate = ? and time >= ? and time <= ?
+   //       and (text is null or text = '')
+
+   deleteArchived = new cDbStatement(tableSamples);
+
+   deleteArchived->build("delete from %s where ", tableSamples->TableName());
+   deleteArchived->bind("ADDRESS", cDBS::bndIn | cDBS::bndSet);
+   deleteArchived->bind("TYPE", cDBS::bndIn | cDBS::bndSet, " and ");
+   deleteArchived->bind("AGGREGATE", cDBS::bndIn | cDBS::bndSet, " and ");
+   deleteArchived->bindCmp(0, &fromValue, ">=", " and ");
+   deleteArchived->bindCmp(0, "TIME", 0, "<=", " and ");
+   deleteArchived->build(" and (%s is null or %s = '')", text, text);
+
+   status += deleteArchived->prepare();
+
+   return status;
+}
+
+int cRetention::cStatements::exit()
+{
+   delete selectSensors;   selectSensors = 0;
+   delete selectChunkEnd;  selectChunkEnd = 0;
+   delete deleteChunk;     deleteChunk = 0;
+   delete selectArchiveSensors;   selectArchiveSensors = 0;
+   delete selectArchiveSamples;   selectArchiveSamples = 0;
+   delete selectArchiveChunkEnd;  selectArchiveChunkEnd = 0;
+   delete deleteArchived;         deleteArchived = 0;
+   delete tableSamples;    tableSamples = 0;
+
+   return done;
+}
+
+//***************************************************************************
+// Run
+//***************************************************************************
+
+int cRetention::run()
+{
+   std::map<std::string, int>::iterator it;
+   std::map<std::string, long> deletedOfType;
+   std::vector<Sensor> sensors;
+   time_t latest = aggregatedUntil;
+   double start = usNow();
+   long total = 0;
+
+   // the sensors with samples behind the latest horizon
+
+   mutex.Lock();
+
+   for (it = policies.begin(); it != policies.end(); it++)
+      if (it->second > 0)
+         latest = max(latest, time(0) - it->second * tmeSecondsPerDay);
+
+   mutex.Unlock();
+
+   db->tableSamples->clear();
+   db->horizonValue.setValue(latest);
+
+   for (int f = db->selectSensors->find(); f; f = db->selectSensors->fetch())
+   {
+      Sensor s = { (int)db->tableSamples->getIntValue("ADDRESS"),
+                   db->tableSamples->getStrValue("TYPE"), db->tableSamples->getStrValue("AGGREGATE") };
+      sensors.push_back(s);
+   }
+
+   db->selectSensors->freeResult();
+
+   if (!connection->isConnected())
+      return fail;
+
+   for (uint i = 0; i < sensors.size() && !stopRequested; i++)
+   {
+      time_t horizon = horizonOf(sensors[i].type.c_str(), sensors[i].aggregate.c_str());
+      long deleted = 0;
+
+      if (!horizon)
+         continue;
+
+      if (purge(&sensors[i], horizon, deleted) != success)
+         return fail;
+
+      deletedOfType[sensors[i].type] += deleted;
+      total += deleted;
+   }
+
+   if (total)
+   {
+      double seconds = (usNow() - start) / 1000000;
+      std::map<std::string, long>::iterator d;
+      std::string details = "";
+
+      for (d = deletedOfType.begin(); d != deletedOfType.end(); d++)
+      {
+         char* s;
+         asprintf(&s, "%s%s: %ld", details.length() ? ", " : "", d->first.c_str(), d->second);
+         details += s;
+         free(s);
+      }
+
+      tell(eloAlways, "Retention: Deleted %ld expired samples (%s) in %.2f seconds, %.0f rows/s",
+           total, details.c_str(), seconds, seconds > 0 ? total / seconds : 0);
+   }
+
+   return success;
+}
+
+//***************************************************************************
+// Maintain Partitions
+//   - daily, creates the upcoming monthly partitions and drops the expired
+//***************************************************************************
+
+int cRetention::hasPartitions()
+{
+   std::map<std::string, cDbTableDef*>::iterator t;
+
+   for (t = dbDict.getFirstTableIterator(); t != dbDict.getTableEndIterator(); t++)
+      if (t->second->getPartition())
+         return yes;
+
+   return no;
+}
+
+int cRetention::maintainPartitions()
+{
+   std::map<std::string, cDbTableDef*>::iterator t;
+   int status = success;
+
+   nextPartitionCheckAt = time(0) + tmeSecondsPerDay;
+
+   for (t = dbDict.getFirstTableIterator(); t != dbDict.getTableEndIterator() && !stopRequested; t++)
+   {
+      if (!t->second->getPartition())
+         continue;
+
+      cDbTable* table = new cDbTable(connection, t->first.c_str());
+
+      tell(eloDetail, "Checking partitions of '%s'", t->first.c_str());
+      status += table->maintainPartitions(partitionRetention);
+
+      delete table;
+   }
+
+   if (status != success)
+      tell(eloAlways, "Warning: Maintaining the partitions failed, retrying in one day");
+
+   return connection->isConnected() ? success : fail;
+}
+
+//***************************************************************************
+// Purge
+//   - delete the samples of the sensor up to 'horizon', chunk by chunk
+//***************************************************************************
+
+int cRetention::purge(Sensor* sensor, time_t horizon, long& deleted)
+{
+   int last = no;
+
+   deleted = 0;
+
+   while (!last)
+   {
+      db->tableSamples->clear();
+      db->tableSamples->setValue("ADDRESS", sensor->address);
+      db->tableSamples->setValue("TYPE", sensor->type.c_str());
+      db->tableSamples->setValue("AGGREGATE", sensor->aggregate.c_str());
+      db->horizonValue.setValue(horizon);
+
+      // less than 'chunkRows' left -> delete the rest
+
+      int found = db->selectChunkEnd->find();
+
+      db->selectChunkEnd->freeResult();
+
+      if (found == fail)
+         return fail;
+
+      if (!found)
+      {
+         db->tableSamples->setValue("TIME", horizon);
+         last = yes;
+      }
+
+      if (db->deleteChunk->execute() != success)
+         return fail;
+
+      connection->flush();
+      deleted += db->deleteChunk->getAffected();
+
+      if (!last && !pause(pauseMs))
+         break;
+   }
+
+   if (deleted)
+      tell(eloDetail, "Retention: Deleted %ld samples of %s:0x%x (%s) up to %s",
+           deleted, sensor->type.c_str(), sensor->address, sensor->aggregate.c_str(),
+           l2pTime(horizon).c_str());
+
+   return success;
+}
+
+//***************************************************************************
+// Archive
+//   - move the samples older than 'archiveDays' days to the compressed
+//     archive files, sensor by sensor and aggregate, month by month like
+//     the files, samples with a text aren't archived
+//***************************************************************************
+
+int cRetention::archive()
+{
+   struct Series
+   {
+      Sensor sensor;
+      time_t oldest;
+   };
+
+   std::vector<Series> series;
+   double start = usNow();
+   long total = 0;
+
+   mutex.Lock();
+   cArchive arc(archivePath.c_str());
+   time_t horizon = time(0) - archiveDays * tmeSecondsPerDay;
+   mutex.Unlock();
+
+   nextArchiveAt = time(0) + tmeSecondsPerDay;
+
+   tell(eloAlways, "Archive: Moving the samples older than %s to '%s' ...",
+        l2pTime(horizon).c_str(), arc.getPath());
+
+   db->tableSamples->clear();
+   db->horizonValue.setValue(horizon);
+
+   for (int f = db->selectArchiveSensors->find(); f; f = db->selectArchiveSensors->fetch())
+   {
+      Series s = { { (int)db->tableSamples->getIntValue("ADDRESS"),
+                     db->tableSamples->getStrValue("TYPE"), db->tableSamples->getStrValue("AGGREGATE") },
+                   db->tableSamples->getTimeValue("TIME") };
+      series.push_back(s);
+   }
+
+   db->selectArchiveSensors->freeResult();
+
+   if (!connection->isConnected())
+      return fail;
+
+   for (uint i = 0; i < series.size() && !stopRequested; i++)
+   {
+      struct tm tm;
+
+      localtime_r(&series[i].oldest, &tm);
+      tm.tm_mday = 1;
+      tm.tm_hour = tm.tm_min = tm.tm_sec = 0;
+      tm.tm_isdst = -1;
+
+      for (time_t from = mktime(&tm); from < horizon && !stopRequested; )
+      {
+         long archived = 0;
+
+         tm.tm_mon++;                     // mktime() normalizes the year
+         tm.tm_isdst = -1;
+         time_t next = mktime(&tm);
+
+         if (archiveMonth(&arc, &series[i].sensor, from, min(next, horizon), archived) != success)
+            return fail;
+
+         total += archived;
+         from = next;
+      }
+   }
+
+   tell(eloAlways, "Archive: Moved %ld samples of %d series in %.2f seconds",
+        total, (int)series.size(), (usNow() - start) / 1000000);
+
+   return success;
+}
+
+//***************************************************************************
+// Archive Month
+//   - archive the samples of the sensor in [from, to) and delete them
+//     chunk by chunk, a failed write keeps them in the table
+//***************************************************************************
+
+int cRetention::archiveMonth(cArchive* arc, Sensor* sensor, time_t from, time_t to, long& archived)
+{
+   std::vector<cArchive::Point> points;
+   int last = no;
+
+   archived = 0;
+
+   db->tableSamples->clear();
+   db->tableSamples->setValue("ADDRESS", sensor->address);
+   db->tableSamples->setValue("TYPE", sensor->type.c_str());
+   db->tableSamples->setValue("AGGREGATE", sensor->aggregate.c_str());
+   db->fromValue.setValue(from);
+   db->horizonValue.setValue(to);
+
+   for (int f = db->selectArchiveSamples->find(); f; f = db->selectArchiveSamples->fetch())
+   {
+      cArchive::Point p = { db->tableSamples->getTimeValue("TIME"), db->tableSamples->getFloatValue("VALUE") };
+      points.push_back(p);
+   }
+
+   db->selectArchiveSamples->freeResult();
+
+   if (!connection->isConnected())
+      return fail;
+
+   if (!points.size())
+      return success;
+
+   // delete only what is safely written
+
+   if (arc->store(sensor->type.c_str(), sensor->address, points, sensor->aggregate.c_str()) != success)
+   {
+      tell(eloAlways, "Error: Archiving the samples of %s:0x%x (%s) of %s failed, keeping them in database",
+           sensor->type.c_str(), sensor->address, sensor->aggregate.c_str(), l2pTime(from).c_str());
+      return done;
+   }
+
+   while (!last)
+   {
+      db->tableSamples->clear();
+      db->tableSamples->setValue("ADDRESS", sensor->address);
+      db->tableSamples->setValue("TYPE", sensor->type.c_str());
+      db->tableSamples->setValue("AGGREGATE", sensor->aggregate.c_str());
+      db->fromValue.setValue(from);
+      db->horizonValue.setValue(to);
+
+      // less than 'chunkRows' left -> delete the rest of the month
+
+      int found = db->selectArchiveChunkEnd->find();
+
+      db->selectArchiveChunkEnd->freeResult();
+
+      if (found == fail)
+         return fail;
+
+      if (!found)
+      {
+         db->tableSamples->setValue("TIME", to - 1);
+         last = yes;
+      }
+
+      if (db->deleteArchived->execute() != success)
+         return fail;
+
+      connection->flush();
+      archived += db->deleteArchived->getAffected();
+
+      // a stop leaves the rest in the table, the next run merges it again
+
+      if (!last && !pause(pauseMs))
+         break;
+   }
+
+   tell(eloDetail, "Archive: Moved %ld samples of %s:0x%x (%s) of %s",
+        archived, sensor->type.c_str(), sensor->address, sensor->aggregate.c_str(), l2pTime(from).c_str());
+
+   return success;
+}
@@ -0,0 +1,122 @@
+//***************************************************************************
+// p4d / Linux - Heizungs Manager
+// File retention.h
+// This code is distributed under the terms and conditions of the
+// GNU GENERAL PUBLIC LICENSE. See the file LICENSE for details.
+// Date 19.10.2026  Jörg Wendel
+//***************************************************************************
+
+#ifndef _RETENTION_H_
+#define _RETENTION_H_
+
+#include <pthread.h>
+
+#include <map>
+#include <string>
+
+#include "lib/db.h"
+
+#include "archive.h"
+
+//***************************************************************************
+// Class Retention
+//   - background thread, by a connection of the pool it deletes the
+//     expired samples of each sensor in chunks of 'chunkRows' rows along
+//     the primary key with a pause of 'pauseMs' between the chunks,
+//     one short transaction per chunk instead of one huge delete
+//   - daily it creates the upcoming monthly partitions of the partitioned
+//     tables and drops the expired ones, DDL which shouldn't block p4d's loop
+//   - daily it moves the samples older than 'archiveDays' to the archive,
+//     month by month and deleted in the same chunks
+//***************************************************************************
+
+class cRetention
+{
+   public:
+
+      cRetention();
+      ~cRetention();
+
+      int setPolicies(const char* policies);     // "VA:730, DI:90, DO:90, W1:365, *:0" (days, 0 -> keep)
+      void setAggregatedUntil(time_t until);     // raw samples up to 'until' are aggregated
+      void setPartitionRetention(int months)     { partitionRetention = months; }   // na -> dictionary
+      void setPool(cDbConnectionPool* aPool)     { pool = aPool; }
+      void setArchive(const char* path, int days);   // days 0 -> off
+      int isActive();
+
+      int start();
+      void stop();
+      void trigger();                             // start a run now
+
+      static int chunkRows;
+      static int pauseMs;
+      static int checkInterval;                   // [s] between two runs
+
+   protected:
+
+      struct Sensor
+      {
+         int address;
+         std::string type;
+         std::string aggregate;
+      };
+
+      // tables and statements, prepared once per pooled connection
+
+      class cStatements : public cDbStatementSet
+      {
+         public:
+
+            cStatements();
+            virtual ~cStatements()   { exit(); }
+
+            virtual int init(cDbConnection* connection);
+            virtual int exit();
+
+            cDbTable* tableSamples;
+            cDbStatement* selectSensors;
+            cDbStatement* selectChunkEnd;
+            cDbStatement* deleteChunk;
+            cDbStatement* selectArchiveSensors;
+            cDbStatement* selectArchiveSamples;
+            cDbStatement* selectArchiveChunkEnd;
+            cDbStatement* deleteArchived;
+            cDbValue horizonValue;
+            cDbValue fromValue;
+      };
+
+      static void* threadFct(void* arg);
+      static cDbStatementSet* createStatements(void* arg)  { return new cStatements(); }
+
+      void action();
+      int run();
+      int purge(Sensor* sensor, time_t horizon, long& deleted);
+      int hasPartitions();
+      int maintainPartitions();
+      int archive();
+      int archiveMonth(cArchive* arc, Sensor* sensor, time_t from, time_t to, long& archived);
+      time_t horizonOf(const char* type, const char* aggregate);
+      int pause(int ms);
+
+      pthread_t thread;
+      int running;
+      int stopRequested;
+      int triggered;
+      cMyMutex mutex;
+      cCondVar waitCond;
+
+      std::map<std::string, int> policies;         // type -> days, '*' for all others
+      time_t aggregatedUntil;
+      int partitionRetention;                      // [months]
+      time_t nextPartitionCheckAt;
+      std::string archivePath;
+      int archiveDays;
+      time_t nextArchiveAt;
+
+      cDbConnectionPool* pool;
+      cDbConnection* connection;                   // acquired from the pool while working
+      cStatements* db;
+};
+
+//***************************************************************************
+#endif // _RETENTION_H_
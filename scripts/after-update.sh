@@ -6,6 +6,11 @@ source ~/.bashrc
 # example for Home-Matic
 # -----------------------
 
+# p4d passes the values of the update as variables, e.g. $P4D_VA_1 for the
+# value of type VA at address 1, and on stdin one line per value:
+#   <type> <address> <value> <unit> <title>   (tab separated)
+# this example still reads the last two measures from the database
+
 # ---------------------
 # User settings
 
@@ -0,0 +1,236 @@
+//***************************************************************************
+// p4d / Linux - Heizungs Manager
+// File valuecache.c
+// This code is distributed under the terms and conditions of the
+// GNU GENERAL PUBLIC LICENSE. See the file LICENSE for details.
+// Date 19.10.2026  Jörg Wendel
+//***************************************************************************
+
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <errno.h>
+
+#include <map>
+
+#include "valuecache.h"
+
+int cValueCache::capacity = 1024;
+
+//***************************************************************************
+// Object
+//***************************************************************************
+
+cValueCache::cValueCache()
+{
+   shmId = na;
+   header = 0;
+   data = 0;
+}
+
+cValueCache::~cValueCache()
+{
+   close();
+}
+
+//***************************************************************************
+// Open / Close
+//***************************************************************************
+
+int cValueCache::open()
+{
+   int size = sizeof(Header) + capacity * sizeof(Value);
+   void* p;
+
+   if (isOpen())
+      return done;
+
+   // a segment of an older version (other size) is replaced
+
+   if ((shmId = shmget(shmKey, size, IPC_CREAT | 0644)) < 0 && errno == EINVAL)
+   {
+      int oldId = shmget(shmKey, 0, 0);
+
+      if (oldId >= 0)
+         shmctl(oldId, IPC_RMID, 0);
+
+      shmId = shmget(shmKey, size, IPC_CREAT | 0644);
+   }
+
+   if (shmId < 0)
+   {
+      tell(eloAlways, "Error: Creating shared memory for the value cache failed, %s", strerror(errno));
+      return fail;
+   }
+
+   if ((p = shmat(shmId, 0, 0)) == (void*)-1)
+   {
+      tell(eloAlways, "Error: Attaching shared memory of the value cache failed, %s", strerror(errno));
+      shmId = na;
+      return fail;
+   }
+
+   header = (Header*)p;
+   data = (Value*)((char*)p + sizeof(Header));
+
+   // a valid segment keeps its values for the readers, the sequence
+   // gets even in case the last writer died while publishing
+
+   if (memcmp(header->magic, "P4VC", 4) != 0 || header->layout != layout
+       || header->capacity != (uint32_t)capacity || header->recordSize != sizeof(Value))
+   {
+      memset(header, 0, sizeof(Header));
+      memcpy(header->magic, "P4VC", 4);
+      header->layout = layout;
+      header->capacity = capacity;
+      header->recordSize = sizeof(Value);
+   }
+   else if (header->sequence & 1)
+   {
+      header->sequence++;
+   }
+
+   tell(eloDetail, "Value cache attached at shared memory key 0x%x (%d bytes)", shmKey, size);
+
+   return success;
+}
+
+int cValueCache::close()
+{
+   if (!isOpen())
+      return done;
+
+   // mark as empty, the segment stays for the next start
+
+   header->sequence++;
+   __sync_synchronize();
+   header->count = 0;
+   __sync_synchronize();
+   header->sequence++;
+
+   shmdt(header);
+
+   header = 0;
+   data = 0;
+   shmId = na;
+
+   return success;
+}
+
+//***************************************************************************
+// Add
+//***************************************************************************
+
+void cValueCache::add(const char* type, int address, double value, const char* text,
+                      const char* unit, const char* title, const char* usrtitle)
+{
+   Value v;
+
+   memset(&v, 0, sizeof(Value));
+
+   v.address = address;
+   v.value = value;
+   sstrcpy(v.type, type, sizeof(v.type));
+   sstrcpy(v.unit, unit, sizeof(v.unit));
+   sstrcpy(v.text, text, sizeof(v.text));
+   sstrcpy(v.title, title, sizeof(v.title));
+   sstrcpy(v.usrtitle, usrtitle, sizeof(v.usrtitle));
+
+   values.push_back(v);
+}
+
+//***************************************************************************
+// Publish
+//   - write the collected values, readers retry while the sequence is odd
+//     or changed during their read
+//***************************************************************************
+
+int cValueCache::publish(time_t time, std::vector<Value>* changed)
+{
+   uint32_t count = min((int)values.size(), capacity);
+
+   if (!isOpen())
+      return fail;
+
+   if (count < values.size())
+      tell(eloAlways, "Warning: Value cache holds only %d of %d values", capacity, (int)values.size());
+
+   // compare with the values of the last cycle, still in the segment
+
+   if (changed)
+   {
+      std::map<std::pair<std::string, int>, Value*> last;
+
+      changed->clear();
+
+      for (uint32_t i = 0; i < header->count; i++)
+         last[std::make_pair(std::string(data[i].type), (int)data[i].address)] = &data[i];
+
+      for (uint32_t i = 0; i < count; i++)
+      {
+         std::map<std::pair<std::string, int>, Value*>::iterator it;
+         Value* v = &values[i];
+
+         it = last.find(std::make_pair(std::string(v->type), (int)v->address));
+
+         if (it == last.end() || it->second->value != v->value || strcmp(it->second->text, v->text) != 0)
+            changed->push_back(*v);
+      }
+   }
+
+   header->sequence++;
+   __sync_synchronize();
+
+   if (count)
+      memcpy(data, &values[0], count * sizeof(Value));
+
+   header->count = count;
+   header->time = time;
+
+   __sync_synchronize();
+   header->sequence++;
+
+   values.clear();
+
+   return success;
+}
+
+//***************************************************************************
+// Snapshot
+//   - copy of the published values, for readers in the writing process
+//***************************************************************************
+
+int cValueCache::snapshot(std::vector<Value>& out, time_t& time)
+{
+   out.clear();
+   time = 0;
+
+   if (!isOpen())
+      return fail;
+
+   out.assign(data, data + header->count);
+   time = header->time;
+
+   return success;
+}
+
+//***************************************************************************
+// Lookup
+//   - published value of the sensor, fail if not of the cycle at 'time'
+//***************************************************************************
+
+int cValueCache::lookup(const char* type, int address, time_t time, Value* value)
+{
+   if (!isOpen() || header->time != time)
+      return fail;
+
+   for (uint32_t i = 0; i < header->count; i++)
+   {
+      if (data[i].address == address && strcmp(data[i].type, type) == 0)
+      {
+         *value = data[i];
+         return success;
+      }
+   }
+
+   return fail;
+}
@@ -0,0 +1,89 @@
+//***************************************************************************
+// p4d / Linux - Heizungs Manager
+// File valuecache.h
+// This code is distributed under the terms and conditions of the
+// GNU GENERAL PUBLIC LICENSE. See the file LICENSE for details.
+// Date 19.10.2026  Jörg Wendel
+//***************************************************************************
+
+#ifndef _VALUECACHE_H_
+#define _VALUECACHE_H_
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "lib/common.h"
+
+//***************************************************************************
+// Class Value Cache
+//   - latest value of all active sensors in a SysV shared memory segment
+//     (key 'shmKey'), the WEBIF reads it instead of joining samples
+//     and valuefacts on each page load
+//   - one writer (p4d), the readers check the sequence of the header
+//     (seqlock): odd while publishing, read again if it changed
+//
+//     Header    64 bytes
+//     Value     'recordSize' bytes, 'count' times
+//***************************************************************************
+
+class cValueCache
+{
+   public:
+
+      enum Misc
+      {
+         shmKey = 0x50344456,        // 'P4DV'
+         layout = 1                  // increase on changes of the structures below
+      };
+
+      struct Header
+      {
+         char magic[4];              // "P4VC"
+         uint32_t layout;
+         uint32_t sequence;          // odd -> write in progress
+         uint32_t count;             // number of values
+         int64_t time;               // time of the samples
+         uint32_t capacity;
+         uint32_t recordSize;
+         char reserved[32];
+      };
+
+      struct Value
+      {
+         int32_t address;
+         char type[4];
+         double value;
+         char unit[16];
+         char text[104];
+         char title[104];
+         char usrtitle[104];
+      };
+
+      cValueCache();
+      ~cValueCache();
+
+      int open();
+      int close();
+      int isOpen()  { return header != 0; }
+
+      void clear()  { values.clear(); }
+      void add(const char* type, int address, double value, const char* text,
+               const char* unit, const char* title, const char* usrtitle);
+      int publish(time_t time, std::vector<Value>* changed = 0);    // 'changed' -> differ from the last cycle
+      int snapshot(std::vector<Value>& out, time_t& time);
+      int lookup(const char* type, int address, time_t time, Value* value);
+
+      static int capacity;            // max number of values
+
+   protected:
+
+      int shmId;
+      Header* header;
+      Value* data;
+
+      std::vector<Value> values;      // collected during the cycle
+};
+
+//***************************************************************************
+#endif // _VALUECACHE_H_
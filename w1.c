@@ -7,64 +7,393 @@
 //***************************************************************************
 
 #include <dirent.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/inotify.h>
 
 #include "w1.h"
 
+int W1::maxThreads = 8;
+int W1::bulkTimeout = 1000;
+int W1::interval = 15;
+
+//***************************************************************************
+// Object
+//***************************************************************************
+
+W1::W1(const char* path)
+{
+   w1Path = strdup(path);
+   memset(slots, 0, sizeof(slots));
+
+   running = no;
+   stopRequested = no;
+   wakeupPipe[0] = wakeupPipe[1] = na;
+   inotifyFd = na;
+}
+
+W1::~W1()
+{
+   stop();
+   free(w1Path);
+}
+
 //***************************************************************************
 // Show W1 Sensors
 //***************************************************************************
 
 int W1::show()
 {
-   for (SensorList::iterator it = sensors.begin(); it != sensors.end(); ++it)
-      tell(0, "%s: %2.3f", it->first.c_str(), it->second);
+   std::vector<Sensor> list;
+
+   getSensors(list);
+
+   for (uint i = 0; i < list.size(); i++)
+      tell(0, "%s: %2.3f%s (%u reads, %u failed, %u crc errors)", list[i].id, list[i].value,
+           list[i].present ? "" : " [removed]", list[i].reads, list[i].failures, list[i].crcErrors);
 
    return done;
 }
 
-int W1::update()
+//***************************************************************************
+// Slots
+//   - open addressing by the address, slots are never freed, a removed
+//     sensor is only marked as not present
+//***************************************************************************
+
+W1::Slot* W1::slotOf(unsigned int address, int create)
 {
-   for (SensorList::iterator it = sensors.begin(); it != sensors.end(); ++it)
+   unsigned int first = address & (maxSlots-1);
+
+   if (!address)
+      return 0;
+
+   for (unsigned int i = first; ; )
    {
-      char line[100+TB];
-      FILE* in;
-      char* path;
+      unsigned int a = slots[i].sensor.address;
 
-      asprintf(&path, "%s/%s/w1_slave", w1Path, it->first.c_str());
+      if (a == address)
+         return &slots[i];
 
-      if (!(in = fopen(path, "r")))
+      if (!a)
       {
-         tell(eloAlways, "Error: Opening '%s' failed, %s", path, strerror(errno));
-         free(path);
-         continue;
+         if (!create)
+            return 0;
+
+         beginWrite(&slots[i]);
+         slots[i].sensor.address = address;
+         endWrite(&slots[i]);
+
+         return &slots[i];
       }
 
-      while (fgets(line, 100, in))
+      if ((i = (i + 1) & (maxSlots-1)) == first)
+         return 0;
+   }
+}
+
+void W1::beginWrite(Slot* slot)
+{
+   slot->sequence++;
+   __sync_synchronize();
+}
+
+void W1::endWrite(Slot* slot)
+{
+   __sync_synchronize();
+   slot->sequence++;
+}
+
+int W1::readSlot(Slot* slot, Sensor* sensor)
+{
+   uint32_t sequence;
+
+   do
+   {
+      while ((sequence = slot->sequence) & 1)
+         ;
+
+      __sync_synchronize();
+      *sensor = slot->sensor;
+      __sync_synchronize();
+
+   } while (slot->sequence != sequence);
+
+   return success;
+}
+
+//***************************************************************************
+// Value Of
+//   - lock free, for the cycle of p4d
+//***************************************************************************
+
+int W1::valueOf(unsigned int address, double& value)
+{
+   Slot* slot = slotOf(address);
+   Sensor sensor;
+
+   if (!slot || readSlot(slot, &sensor) != success || !sensor.valid || !sensor.present)
+      return fail;
+
+   value = sensor.value;
+
+   return success;
+}
+
+//***************************************************************************
+// Get List / Sensors
+//***************************************************************************
+
+int W1::getList(SensorList& list)
+{
+   mutex.Lock();
+   list = sensors;
+   mutex.Unlock();
+
+   return done;
+}
+
+int W1::getSensors(std::vector<Sensor>& list)
+{
+   list.clear();
+
+   for (int i = 0; i < maxSlots; i++)
+   {
+      Sensor sensor;
+
+      if (slots[i].sensor.address && readSlot(&slots[i], &sensor) == success)
+         list.push_back(sensor);
+   }
+
+   return done;
+}
+
+//***************************************************************************
+// Update
+//***************************************************************************
+
+int W1::update()
+{
+   std::vector<std::string> ids;
+   std::vector<Read> reads;
+   std::vector<pthread_t> tids;
+   ReadQueue queue;
+   int threads;
+
+   mutex.Lock();
+
+   for (SensorList::iterator it = sensors.begin(); it != sensors.end(); ++it)
+      ids.push_back(it->first);
+
+   mutex.Unlock();
+
+   if (ids.empty())
+      return done;
+
+   triggerBulkRead();
+
+   for (uint i = 0; i < ids.size(); i++)
+   {
+      Read read;
+
+      asprintf(&read.path, "%s/%s/w1_slave", w1Path, ids[i].c_str());
+      read.valid = no;
+      read.crcError = no;
+      read.value = 0;
+      reads.push_back(read);
+   }
+
+   // one thread per sensor, up to maxThreads
+
+   queue.reads = &reads;
+   queue.next = 0;
+
+   threads = min((int)reads.size(), max(maxThreads, 1));
+
+   for (int i = 0; i < threads - 1; i++)
+   {
+      pthread_t tid;
+
+      if (pthread_create(&tid, 0, readThread, &queue) == 0)
+         tids.push_back(tid);
+   }
+
+   readThread(&queue);
+
+   for (uint i = 0; i < tids.size(); i++)
+      pthread_join(tids[i], 0);
+
+   // publish the results, keep the last value of failed reads
+
+   mutex.Lock();
+
+   for (uint i = 0; i < ids.size(); i++)
+   {
+      Slot* slot = slotOf(toId(ids[i].c_str()));
+
+      if (reads[i].valid && sensors.find(ids[i]) != sensors.end())
+         sensors[ids[i]] = reads[i].value;
+
+      if (slot)
       {
-         char* p;
+         beginWrite(slot);
 
-         line[strlen(line)-1] = 0;
+         slot->sensor.reads++;
 
-         if ((p = strstr(line, " t=")))
+         if (reads[i].valid)
          {
-            double temp = atoi(p+3) / 1000.0;
-            sensors[it->first] = temp;
+            slot->sensor.valid = yes;
+            slot->sensor.value = reads[i].value;
+            slot->sensor.time = time(0);
          }
+         else if (reads[i].crcError)
+            slot->sensor.crcErrors++;
+         else
+            slot->sensor.failures++;
+
+         endWrite(slot);
       }
 
-      fclose(in);
-      free(path);
+      free(reads[i].path);
    }
 
+   mutex.Unlock();
+
    return done;
 }
 
+void* W1::readThread(void* arg)
+{
+   ReadQueue* queue = (ReadQueue*)arg;
+   size_t i;
+
+   while ((i = __sync_fetch_and_add(&queue->next, 1)) < queue->reads->size())
+      readSensor(&(*queue->reads)[i]);
+
+   return 0;
+}
+
+//***************************************************************************
+// Read Sensor
+//   - w1_slave of a DS18B20:
+//       72 01 4b 46 7f ff 0e 10 57 : crc=57 YES
+//       72 01 4b 46 7f ff 0e 10 57 t=23125
+//***************************************************************************
+
+int W1::readSensor(Read* read)
+{
+   char line[100+TB];
+   int crcOk = no;
+   FILE* in;
+
+   if (!(in = fopen(read->path, "r")))
+   {
+      tell(eloAlways, "Error: Opening '%s' failed, %s", read->path, strerror(errno));
+      return fail;
+   }
+
+   while (fgets(line, 100, in))
+   {
+      char* p;
+
+      line[strlen(line)-1] = 0;
+
+      if (strstr(line, "crc="))
+      {
+         crcOk = strstr(line, " YES") != 0;
+         read->crcError = !crcOk;
+      }
+
+      if ((p = strstr(line, " t=")) && crcOk)
+      {
+         read->value = atoi(p+3) / 1000.0;
+         read->valid = yes;
+      }
+   }
+
+   fclose(in);
+
+   if (!read->valid)
+      tell(eloDetail, "Warning: Reading '%s' failed (crc %s)", read->path, crcOk ? "ok" : "error");
+
+   return read->valid ? success : fail;
+}
+
+//***************************************************************************
+// Trigger Bulk Read
+//   - 'trigger' to therm_bulk_read of each bus master starts the conversion
+//     on all its sensors, reading it gives -1 as long as one is converting,
+//     the w1_slave reads afterwards return without waiting again
+//***************************************************************************
+
+int W1::triggerBulkRead()
+{
+   std::vector<std::string> masters;
+   DIR* dir;
+   dirent* dp;
+
+   if (!(dir = opendir(w1Path)))
+      return fail;
+
+   while ((dp = readdir(dir)))
+   {
+      char* path;
+
+      if (strncmp(dp->d_name, "w1_bus_master", 13) != 0)
+         continue;
+
+      asprintf(&path, "%s/%s/therm_bulk_read", w1Path, dp->d_name);
+
+      if (FILE* fp = fopen(path, "w"))
+      {
+         if (fputs("trigger\n", fp) >= 0 && fclose(fp) == 0)
+            masters.push_back(path);
+      }
+
+      free(path);
+   }
+
+   closedir(dir);
+
+   // wait for the conversions
+
+   cTimeMs timeout(bulkTimeout);
+
+   for (uint i = 0; i < masters.size(); i++)
+   {
+      while (!timeout.TimedOut())
+      {
+         char state[20+TB] = "";
+
+         if (FILE* fp = fopen(masters[i].c_str(), "r"))
+         {
+            if (!fgets(state, 20, fp))
+               *state = 0;
+
+            fclose(fp);
+         }
+
+         if (atoi(state) != -1)
+            break;
+
+         usleep(10000);
+      }
+   }
+
+   if (masters.size())
+      tell(eloDebug, "Bulk conversion on %d bus master(s) done", (int)masters.size());
+
+   return masters.size() ? success : done;
+}
+
 //***************************************************************************
 // Scan
 //***************************************************************************
 
 int W1::scan()
 {
+   std::map<std::string, int> found;
    DIR* dir;
    dirent* dp;
 
@@ -77,14 +406,190 @@ int W1::scan()
    while ((dp = readdir(dir)))
    {
       if (strncmp(dp->d_name, "28-", 3) == 0)
-         sensors[dp->d_name] = 0;
+         found[dp->d_name] = yes;
    }
 
    closedir(dir);
 
+   mutex.Lock();
+
+   for (std::map<std::string, int>::iterator it = found.begin(); it != found.end(); ++it)
+   {
+      Slot* slot;
+
+      if (sensors.find(it->first) != sensors.end())
+         continue;
+
+      sensors[it->first] = 0;
+
+      if (!(slot = slotOf(toId(it->first.c_str()), yes)))
+      {
+         tell(eloAlways, "Warning: More than %d one wire sensors, ignoring '%s'", maxSlots, it->first.c_str());
+         continue;
+      }
+
+      beginWrite(slot);
+      sstrcpy(slot->sensor.id, it->first.c_str(), sizeof(slot->sensor.id));
+      slot->sensor.present = yes;
+      endWrite(slot);
+
+      tell(eloDetail, "One wire sensor '%s' found", it->first.c_str());
+   }
+
+   for (SensorList::iterator it = sensors.begin(); it != sensors.end(); )
+   {
+      if (found.find(it->first) != found.end())
+      {
+         ++it;
+         continue;
+      }
+
+      if (Slot* slot = slotOf(toId(it->first.c_str())))
+      {
+         beginWrite(slot);
+         slot->sensor.present = no;
+         endWrite(slot);
+      }
+
+      tell(eloAlways, "One wire sensor '%s' removed", it->first.c_str());
+      sensors.erase(it++);
+   }
+
+   mutex.Unlock();
+
    return done;
 }
 
+//***************************************************************************
+// Start / Stop
+//***************************************************************************
+
+int W1::start()
+{
+   if (running)
+      return done;
+
+   if (pipe(wakeupPipe) != 0)
+   {
+      tell(eloAlways, "Error: Creating pipe failed, %s", strerror(errno));
+      return fail;
+   }
+
+   stopRequested = no;
+
+   if (pthread_create(&thread, 0, threadFct, this) != 0)
+   {
+      tell(eloAlways, "Error: Starting one wire thread failed, %s", strerror(errno));
+      ::close(wakeupPipe[0]);
+      ::close(wakeupPipe[1]);
+      wakeupPipe[0] = wakeupPipe[1] = na;
+      return fail;
+   }
+
+   running = yes;
+
+   return success;
+}
+
+void W1::stop()
+{
+   if (!running)
+      return;
+
+   stopRequested = yes;
+
+   if (write(wakeupPipe[1], "x", 1) != 1)
+      tell(eloAlways, "Error: Waking up the one wire thread failed, %s", strerror(errno));
+
+   pthread_join(thread, 0);
+   running = no;
+
+   ::close(wakeupPipe[0]);
+   ::close(wakeupPipe[1]);
+   wakeupPipe[0] = wakeupPipe[1] = na;
+}
+
+//***************************************************************************
+// Thread
+//***************************************************************************
+
+void* W1::threadFct(void* arg)
+{
+   ((W1*)arg)->action();
+   return 0;
+}
+
+void W1::action()
+{
+   tell(eloAlways, "One wire thread started, reading the sensors every %d seconds", interval);
+
+   if ((inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) < 0
+       || inotify_add_watch(inotifyFd, w1Path, IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO) < 0)
+      tell(eloDetail, "Info: Can't watch '%s' (%s), new sensors are found by the next scan", w1Path, strerror(errno));
+
+   while (!stopRequested)
+   {
+      scan();
+      update();
+
+      // wait for the next round, a change of the directory starts it at once
+
+      uint64_t next = cTimeMs::Now() + interval * 1000;
+
+      while (!stopRequested && cTimeMs::Now() < next)
+      {
+         if (waitEvent((int)(next - cTimeMs::Now())) == yes)
+            break;
+      }
+   }
+
+   if (inotifyFd >= 0)
+      ::close(inotifyFd);
+
+   inotifyFd = na;
+
+   tell(eloAlways, "One wire thread stopped");
+}
+
+//***************************************************************************
+// Wait Event
+//   - yes on a change of the devices directory
+//***************************************************************************
+
+int W1::waitEvent(int ms)
+{
+   struct pollfd fds[2];
+   int count = 1;
+   char buf[4096];
+
+   fds[0].fd = wakeupPipe[0];
+   fds[0].events = POLLIN;
+
+   if (inotifyFd >= 0)
+   {
+      fds[1].fd = inotifyFd;
+      fds[1].events = POLLIN;
+      count++;
+   }
+
+   if (poll(fds, count, max(ms, 0)) <= 0)
+      return no;
+
+   if (count > 1 && (fds[1].revents & POLLIN))
+   {
+      while (read(inotifyFd, buf, sizeof(buf)) > 0)
+         ;
+
+      // give the driver a moment to create the files of the device
+
+      usleep(500000);
+
+      return yes;
+   }
+
+   return no;
+}
+
 //***************************************************************************
 // To ID
 //***************************************************************************
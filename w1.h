@@ -7,35 +7,119 @@
 //***************************************************************************
 
 #include <stdio.h>
+#include <stdint.h>
+#include <pthread.h>
 #include <map>
+#include <vector>
 
 #include "lib/common.h"
 
+#define w1PathDefault "/sys/bus/w1/devices"
+
 //***************************************************************************
 // Class W1
+//   - update() starts the conversion of all sensors of a bus master at
+//     once (therm_bulk_read) if the driver supports it and reads the
+//     sensors by up to 'maxThreads' threads in parallel, a DS18B20
+//     needs up to 750 ms for its conversion
+//   - start() runs scan() and update() every 'interval' seconds in a
+//     thread, new or removed sensors are noticed by inotify (or the
+//     next scan, sysfs doesn't report all changes)
+//   - the values are kept in 'slots', addressed by the hash of the
+//     address, written under 'mutex' and read without lock (seqlock)
 //***************************************************************************
 
 class W1
 {
    public:
-      
+
       typedef std::map<std::string, double> SensorList;
 
-      W1()  { w1Path = strdup("/sys/bus/w1/devices"); }
-      ~W1() { free(w1Path); }
+      enum Misc
+      {
+         maxSlots = 128              // power of 2
+      };
+
+      struct Sensor
+      {
+         unsigned int address;       // toId() of the id, 0 -> free slot
+         char id[32+TB];
+         int present;                // found by the last scan
+         int valid;                  // read at least once
+         double value;
+         time_t time;                // of the last good read
+         uint32_t reads;
+         uint32_t failures;          // w1_slave not readable
+         uint32_t crcErrors;
+      };
+
+      W1(const char* path = w1PathDefault);
+      ~W1();
+
+      void setPath(const char* path)   { free(w1Path); w1Path = strdup(path); }
+      const char* getPath()            { return w1Path; }
 
       int scan();
       int show();
       int update();
 
-      SensorList* getList() { return &sensors; }
+      int start();
+      void stop();
+      int isRunning()                  { return running; }
 
-      double valueOf(const char* id) { return sensors[id]; }
+      int getList(SensorList& list);
+      int getSensors(std::vector<Sensor>& list);
+      int valueOf(unsigned int address, double& value);
 
       static unsigned int toId(const char* name);
 
+      static int maxThreads;
+      static int bulkTimeout;          // [ms] max wait for the bulk conversion
+      static int interval;             // [s] of the sampler thread
+
    protected:
-      
+
+      struct Read
+      {
+         char* path;
+         int valid;
+         int crcError;
+         double value;
+      };
+
+      struct ReadQueue
+      {
+         std::vector<Read>* reads;
+         size_t next;
+      };
+
+      struct Slot
+      {
+         volatile uint32_t sequence;   // odd while written
+         Sensor sensor;
+      };
+
+      int triggerBulkRead();
+      static int readSensor(Read* read);
+      static void* readThread(void* arg);
+
+      Slot* slotOf(unsigned int address, int create = no);
+      int readSlot(Slot* slot, Sensor* sensor);
+      void beginWrite(Slot* slot);
+      void endWrite(Slot* slot);
+
+      static void* threadFct(void* arg);
+      void action();
+      int waitEvent(int ms);
+
       char* w1Path;
       SensorList sensors;
+      cMyMutex mutex;                  // writers of 'sensors' and 'slots'
+      Slot slots[maxSlots];
+
+      pthread_t thread;
+      int running;
+      int stopRequested;
+      int wakeupPipe[2];
+      int inotifyFd;
 };
@@ -127,7 +127,7 @@ int P4d::performWebifRequests()
       {
          const char* result;
 
-         if (callScript(data, result) != success)
+         if (callScript(data, jobId, result) != success)
          {
             char* responce;
             asprintf(&responce, "fail:%s", result);
@@ -136,7 +136,9 @@ int P4d::performWebifRequests()
          }
          else
          {
-            tableJobs->setValue("RESULT", "success:done");
+            // running, finished by finishScriptJobs()
+
+            tableJobs->setValue("STATE", "R");
          }
       }
 
@@ -682,13 +684,58 @@ int P4d::cleanupWebifRequests()
    return status;
 }
 
+//***************************************************************************
+// Finish Script Jobs
+//   - store the output of the scripts called by the hook executor as
+//     result of their job
+//***************************************************************************
+
+int P4d::finishScriptJobs()
+{
+   std::vector<cHookExecutor::Result> results;
+
+   if (!hooks.getResults(results))
+      return done;
+
+   for (unsigned int i = 0; i < results.size(); i++)
+   {
+      cHookExecutor::Result* r = &results[i];
+      char* buf = 0;
+
+      tableJobs->clear();
+      tableJobs->setValue("ID", r->jobId);
+
+      if (!tableJobs->find())
+         continue;
+
+      if (r->timedOut)
+         asprintf(&buf, "fail:timeout after %d seconds", cHookExecutor::timeout);
+      else if (r->status != 0)
+         asprintf(&buf, "fail:exit status (%d) %.70s", r->status, r->output.c_str());
+      else
+         asprintf(&buf, "success:%.90s", r->output.length() ? r->output.c_str() : "done");
+
+      tableJobs->setValue("DONEAT", time(0));
+      tableJobs->setValue("STATE", "D");
+      tableJobs->setValue("RESULT", buf);
+      tableJobs->store();
+      tableJobs->reset();
+
+      tell(eloAlways, "WEBIF job %ld done with '%s'", r->jobId, buf);
+      free(buf);
+   }
+
+   return success;
+}
+
 //***************************************************************************
 // Call Script
+//   - queued to the hook executor, the job gets the result later
 //***************************************************************************
 
-int P4d::callScript(const char* scriptName, const char*& result)
+int P4d::callScript(const char* scriptName, long jobId, const char*& result)
 {
-   int status;
+   cHookExecutor::Hook hook;
    const char* path;
 
    result = "";
@@ -714,13 +761,17 @@ int P4d::callScript(const char* scriptName, const char*& result)
       return fail;
    }
 
-   if ((status = system(path)) == -1)
+   hook.kind = cHookExecutor::hkScript;
+   hook.path = path;
+   hook.jobId = jobId;
+
+   if (hooks.submit(hook) != success)
    {
-      tell(eloAlways, "Called script '%s' failed", path);
+      result = "too many queued scripts";
       return fail;
    }
 
-   tell(eloAlways, "Called script '%s' at path '%s', exit status was (%d)", scriptName, path, status);
+   tell(eloAlways, "Calling script '%s' at path '%s'", scriptName, path);
 
    return success;
 }